@@ -139,7 +139,10 @@ int main_fn(std::string_view program_name, const std::vector<std::string>& argv)
         return *result;
     }
     bpt::log::current_log_level = opts.log_level;
-    return bpt::cli::dispatch_main(opts);
+    auto rc                     = bpt::cli::dispatch_main(opts);
+    // Don't exit while messages from worker threads are still waiting to be written
+    bpt::log::flush();
+    return rc;
 }
 
 #if NEO_OS_IS_WINDOWS
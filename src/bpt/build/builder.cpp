@@ -5,11 +5,17 @@
 #include <bpt/compdb.hpp>
 #include <bpt/error/doc_ref.hpp>
 #include <bpt/error/errors.hpp>
+#include <bpt/error/exit.hpp>
+#include <bpt/error/try_catch.hpp>
+#include <bpt/sdist/root.hpp>
 #include <bpt/usage_reqs.hpp>
+#include <bpt/util/fs/dirscan.hpp>
 #include <bpt/util/fs/io.hpp>
 #include <bpt/util/fs/path.hpp>
 #include <bpt/util/log.hpp>
 #include <bpt/util/output.hpp>
+#include <bpt/util/parallel.hpp>
+#include <bpt/util/signal.hpp>
 #include <bpt/util/time.hpp>
 
 #include <boost/leaf/exception.hpp>
@@ -18,6 +24,7 @@
 
 #include <array>
 #include <fstream>
+#include <optional>
 #include <set>
 
 using namespace bpt;
@@ -41,7 +48,21 @@ void log_failure(const test_failure& fail) {
     }
 }
 
-library_plan prepare_library(const sdist_target&      sdt,
+library_sources collect_library_sources(file_collector& fcoll, path_ref lib_root) {
+    library_sources ret;
+    auto            src_dir = source_root{lib_root / "src"};
+    if (src_dir.exists()) {
+        ret.src = src_dir.collect_sources(fcoll);
+    }
+    auto include_dir = source_root{lib_root / "include"};
+    if (include_dir.exists()) {
+        ret.include = include_dir.collect_sources(fcoll);
+    }
+    return ret;
+}
+
+library_plan prepare_library(file_collector&          fcoll,
+                             const sdist_target&      sdt,
                              const crs::library_info& lib,
                              const crs::package_info& pkg_man) {
     library_build_params lp;
@@ -49,22 +70,65 @@ library_plan prepare_library(const sdist_target&      sdt,
     lp.build_apps      = sdt.params.build_apps;
     lp.build_tests     = sdt.params.build_tests;
     lp.enable_warnings = sdt.params.enable_warnings;
-    return library_plan::create(sdt.sd.path, pkg_man, lib, std::move(lp));
+
+    auto sources = collect_library_sources(fcoll, sdt.sd.path / lib.path);
+    return library_plan::create(sdt.sd.path, pkg_man, lib, std::move(lp), sources);
 }
 
-package_plan prepare_one(const sdist_target& sd) {
-    auto&        man = sd.sd.pkg;
-    package_plan pkg{man.id.name.str};
-    for (auto& lib : man.libraries) {
-        pkg.add_library(prepare_library(sd, lib, man));
+build_plan
+prepare_build_plan(file_collector& fcoll, const std::vector<sdist_target>& sdists, int njobs) {
+    // Most of the time spent preparing a library is spent reading its directories, and each
+    // library is independent of the others, so the libraries of every package are prepared
+    // concurrently. The plan is then assembled in the order in which they were given.
+    struct pending_library {
+        const sdist_target&         sdt;
+        const crs::library_info&    lib;
+        std::optional<library_plan> plan{};
+    };
+    std::vector<pending_library> pending;
+    for (const auto& sd_target : sdists) {
+        for (const auto& lib : sd_target.sd.pkg.libraries) {
+            pending.push_back(pending_library{sd_target, lib});
+        }
+    }
+
+    auto all_prepared = parallel_run(pending, njobs, [&](pending_library& item) {
+        // The error information of a failure is only available on the thread that raised it, so
+        // it is reported here. Rethrowing lets parallel_run stop handing out more libraries.
+        auto qual_name = fmt::format("{}/{}", item.sdt.sd.pkg.id.name.str, item.lib.name.str);
+        bpt_leaf_try {
+            item.plan.emplace(prepare_library(fcoll, item.sdt, item.lib, item.sdt.sd.pkg));
+        }
+        bpt_leaf_catch(bpt::user_cancelled) { throw; }
+        bpt_leaf_catch(const std::system_error& e, fs::path dirpath) {
+            bpt_log(error,
+                    "Failed to collect the sources of library .br.yellow[{}] in [.bold.red[{}]]: {}"_styled,
+                    qual_name,
+                    dirpath.string(),
+                    e.code().message());
+            throw;
+        }
+        bpt_leaf_catch_all {
+            bpt_log(error,
+                    "Failed to prepare the build plan of library .br.yellow[{}]: {}"_styled,
+                    qual_name,
+                    diagnostic_info);
+            throw;
+        };
+    });
+    cancellation_point();
+    if (!all_prepared) {
+        throw_system_exit(1);
     }
-    return pkg;
-}
 
-build_plan prepare_build_plan(const std::vector<sdist_target>& sdists) {
     build_plan plan;
+    auto       next = pending.begin();
     for (const auto& sd_target : sdists) {
-        plan.add_package(prepare_one(sd_target));
+        package_plan pkg{sd_target.sd.pkg.id.name.str};
+        for (auto n = sd_target.sd.pkg.libraries.size(); n != 0; --n, ++next) {
+            pkg.add_library(std::move(*next->plan));
+        }
+        plan.add_package(std::move(pkg));
     }
     return plan;
 }
@@ -224,8 +288,14 @@ void with_build_plan(const build_params&              params,
                      Func&&                           fn) {
     fs::create_directories(params.out_root);
     auto db = database::open(params.out_root / ".bpt.db");
+    // Directory listings of the source trees are cached separately from the build database
+    auto scan_db = unique_database::open((params.out_root / ".bpt-dirscan.db").string()).value();
+    auto fcoll   = file_collector::create(scan_db);
+
+    bpt::stopwatch sw;
+    auto           plan = prepare_build_plan(fcoll, sdists, params.parallel_jobs);
+    bpt_log(debug, "Prepared the build plan in {:L}ms", sw.elapsed_ms().count());
 
-    auto      plan  = prepare_build_plan(sdists);
     auto      ureqs = prepare_ureqs(plan, params.toolchain, params.out_root);
     build_env env{
         params.toolchain,
@@ -236,6 +306,11 @@ void with_build_plan(const build_params&              params,
             .tweaks_dir = params.tweaks_dir,
         },
         ureqs,
+        progress_options{
+            // The status line would only garble output that is not going to a terminal
+            .live      = params.progress.live && stdout_is_a_tty(),
+            .json_path = params.progress.json_path,
+        },
     };
 
     if (env.knobs.tweaks_dir) {
@@ -247,7 +322,7 @@ void with_build_plan(const build_params&              params,
     }
 
     if (params.generate_compdb) {
-        generate_compdb(plan, env);
+        generate_compdb(plan, env, params.parallel_jobs);
     }
 
     fn(std::move(env), std::move(plan));
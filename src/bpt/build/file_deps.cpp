@@ -3,11 +3,14 @@
 #include <bpt/util/fs/io.hpp>
 #include <bpt/util/log.hpp>
 #include <bpt/util/proc.hpp>
-#include <bpt/util/shlex.hpp>
+#include <bpt/util/siphash.hpp>
 #include <bpt/util/string.hpp>
 
 #include <neo/ranges.hpp>
 
+#include <array>
+#include <cassert>
+
 using namespace bpt;
 
 file_deps_info bpt::parse_mkfile_deps_file(path_ref where) {
@@ -15,23 +18,120 @@ file_deps_info bpt::parse_mkfile_deps_file(path_ref where) {
     return parse_mkfile_deps_str(content);
 }
 
+namespace {
+
+/// Classification of characters that are significant when scanning a Makefile deps listing
+enum class mk_char : unsigned char {
+    regular,
+    blank,
+    newline,
+    backslash,
+    dollar,
+};
+
+constexpr auto mk_char_table = [] {
+    std::array<mk_char, 256> table{};
+    table[static_cast<unsigned char>(' ')]  = mk_char::blank;
+    table[static_cast<unsigned char>('\t')] = mk_char::blank;
+    table[static_cast<unsigned char>('\r')] = mk_char::blank;
+    table[static_cast<unsigned char>('\n')] = mk_char::newline;
+    table[static_cast<unsigned char>('\\')] = mk_char::backslash;
+    table[static_cast<unsigned char>('$')]  = mk_char::dollar;
+    return table;
+}();
+
+constexpr mk_char classify(char c) noexcept { return mk_char_table[static_cast<unsigned char>(c)]; }
+
+/// If `s` begins with an escaped newline, returns the length thereof. Otherwise, returns zero.
+constexpr std::size_t escaped_newline_length(std::string_view s) noexcept {
+    if (s.starts_with("\\\n")) {
+        return 2;
+    } else if (s.starts_with("\\\r\n")) {
+        return 3;
+    }
+    return 0;
+}
+
+}  // namespace
+
+std::optional<std::string_view> mkfile_deps_scanner::next() {
+    // Skip the whitespace preceding the word
+    while (!_rest.empty()) {
+        const auto kind = classify(_rest.front());
+        if (kind == mk_char::blank) {
+            _rest.remove_prefix(1);
+        } else if (auto n = escaped_newline_length(_rest)) {
+            _rest.remove_prefix(n);
+        } else if (kind == mk_char::newline) {
+            // An unescaped newline ends the rule. Any further rules (e.g. the phony targets
+            // generated by -MP) do not concern us.
+            _rest = {};
+        } else {
+            break;
+        }
+    }
+    if (_rest.empty()) {
+        return std::nullopt;
+    }
+
+    // Fast path: Most words are plain paths that contain nothing needing decoding
+    std::size_t len = 0;
+    while (len < _rest.size() && classify(_rest[len]) == mk_char::regular) {
+        ++len;
+    }
+    if (len == _rest.size() || classify(_rest[len]) == mk_char::blank
+        || classify(_rest[len]) == mk_char::newline) {
+        auto word = _rest.substr(0, len);
+        _rest.remove_prefix(len);
+        return word;
+    }
+
+    // Slow path: Decode the escape sequences within the word into our own buffer
+    _decoded.assign(_rest.data(), len);
+    while (len < _rest.size()) {
+        const char c    = _rest[len];
+        const auto kind = classify(c);
+        if (kind == mk_char::regular) {
+            _decoded.push_back(c);
+            ++len;
+        } else if (kind == mk_char::blank || kind == mk_char::newline) {
+            break;
+        } else if (kind == mk_char::backslash) {
+            if (escaped_newline_length(_rest.substr(len))) {
+                // A line continuation also ends the word
+                break;
+            }
+            const char escaped = len + 1 < _rest.size() ? _rest[len + 1] : '\\';
+            if (escaped == ' ' || escaped == '\t' || escaped == '#') {
+                _decoded.push_back(escaped);
+                len += 2;
+            } else {
+                // Not an escape sequence. Keep the backslash.
+                _decoded.push_back(c);
+                ++len;
+            }
+        } else {
+            assert(kind == mk_char::dollar);
+            // Make writes a literal dollar sign as "$$"
+            _decoded.push_back(c);
+            len += (len + 1 < _rest.size() && _rest[len + 1] == '$') ? 2 : 1;
+        }
+    }
+    _rest.remove_prefix(len);
+    return std::string_view(_decoded);
+}
+
 file_deps_info bpt::parse_mkfile_deps_str(std::string_view str) {
     file_deps_info ret;
 
-    // Remove escaped newlines
-    auto no_newlines = replace(str, "\\\n", " ");
-
-    auto split = split_shell_string(str);
-    auto iter  = split.begin();
-    auto stop  = split.end();
-    if (iter == stop) {
+    mkfile_deps_scanner scan{str};
+    auto                head = scan.next();
+    if (!head) {
         bpt_log(critical,
-                "Invalid deps listing. Shell split was empty. This is almost certainly a bug.");
+                "Invalid deps listing. The listing was empty. This is almost certainly a bug.");
         return ret;
     }
-    auto& head = *iter;
-    ++iter;
-    if (!ends_with(head, ":")) {
+    if (!ends_with(*head, ":")) {
         bpt_log(
             critical,
             "Invalid deps listing. Leader item is not colon-terminated. This is probably a bug. "
@@ -39,8 +139,11 @@ file_deps_info bpt::parse_mkfile_deps_str(std::string_view str) {
             "`None` in your toolchain file.)");
         return ret;
     }
-    ret.output = head.substr(0, head.length() - 1);
-    ret.inputs.insert(ret.inputs.end(), iter, stop);
+    head->remove_suffix(1);
+    ret.output = *head;
+    while (auto input = scan.next()) {
+        ret.inputs.emplace_back(*input);
+    }
     return ret;
 }
 
@@ -68,6 +171,9 @@ msvc_deps_info bpt::parse_msvc_output_for_deps(std::string_view output, std::str
 void bpt::update_deps_info(neo::output<database> db_, const file_deps_info& deps) {
     database& db = db_;
     db.record_compilation(deps.output, deps.command);
+    if (deps.output_digest) {
+        db.record_output_digest(deps.output, *deps.output_digest);
+    }
     db.forget_inputs_of(deps.output);
     for (auto&& inp : deps.inputs) {
         auto mtime = fs::last_write_time(inp);
@@ -113,3 +219,33 @@ std::optional<prior_compilation> bpt::get_prior_compilation(const database& db,
     ret.previous_command = cmd;
     return ret;
 }
+
+std::uint64_t bpt::get_output_digest(database& db, path_ref file) {
+    auto digest = db.output_digest_of(file);
+    if (!digest) {
+        bpt_log(trace, "No recorded digest for [{}], hashing its content", file.string());
+        digest = bpt::digest_file(file);
+        db.record_output_digest(file, *digest);
+    }
+    return *digest;
+}
+
+std::uint64_t bpt::compute_step_fingerprint(database&                       db,
+                                            const std::vector<std::string>& command,
+                                            const std::vector<fs::path>&    inputs) {
+    std::string fp_str = quote_command(command);
+    for (auto&& inp : inputs) {
+        fp_str += fmt::format("\n{}:{:x}", inp.generic_string(), get_output_digest(db, inp));
+    }
+    return bpt::siphash64(42, 1729, neo::const_buffer(fp_str)).digest();
+}
+
+bool bpt::step_is_up_to_date(const database&  db,
+                             path_ref         output,
+                             std::string_view step,
+                             std::uint64_t    fingerprint) {
+    if (!fs::exists(output)) {
+        return false;
+    }
+    return db.step_fingerprint_of(output, step) == fingerprint;
+}
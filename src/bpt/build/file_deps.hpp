@@ -32,6 +32,7 @@
 
 #include <neo/out.hpp>
 
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -70,10 +71,42 @@ struct file_deps_info {
      * The time at which compilation started.
      */
     fs::file_time_type compile_start_time;
+    /**
+     * The digest of the content of the output, if one was generated.
+     */
+    std::optional<std::uint64_t> output_digest;
 };
 
 class database;
 
+/**
+ * A forward-only tokenizer over a compiler-generated Makefile-syntax dependency listing.
+ *
+ * Each call to `next()` yields the next word of the first rule in the listing, and returns `nullopt`
+ * once that rule has ended. Escaped newlines are treated as whitespace, and the escapes that GCC and
+ * Clang emit in paths (`\ `, `\#`, and `$$`) are decoded. A backslash before any other character is
+ * taken literally, so Windows-style paths are preserved.
+ *
+ * The scanner does not copy the listing: Words that contain no escapes are returned as views into
+ * the scanned string. Words that need decoding are decoded into a buffer that is reused between
+ * calls, so a returned view is only valid until the next call to `next()`.
+ */
+class mkfile_deps_scanner {
+    /// The remainder of the listing that has not been scanned
+    std::string_view _rest;
+    /// Storage for the most recent word, if it required decoding
+    std::string _decoded;
+
+public:
+    explicit mkfile_deps_scanner(std::string_view str) noexcept
+        : _rest(str) {}
+
+    /**
+     * Obtain the next word in the rule, or `nullopt` if the end of the rule has been reached.
+     */
+    std::optional<std::string_view> next();
+};
+
 /**
  * Parse a compiler-generated Makefile that contains dependency information.
  * @see `parse_mkfile_deps_str`
@@ -141,4 +174,32 @@ struct prior_compilation {
  */
 std::optional<prior_compilation> get_prior_compilation(const database& db, path_ref output_path);
 
+/**
+ * Obtain the content digest of a build output. If the build database has no digest recorded for the
+ * file, the file is hashed and the result is recorded for later reference.
+ */
+std::uint64_t get_output_digest(database& db, path_ref file);
+
+/**
+ * Compute a fingerprint of a build step from the command that executes it and the content digests of
+ * each of its inputs (as obtained with `get_output_digest`).
+ *
+ * This is used to implement "early cutoff" for steps that consume other build outputs: If an input
+ * was regenerated but its content did not change, the fingerprint will remain the same, and the step
+ * does not need to be executed again.
+ */
+std::uint64_t compute_step_fingerprint(database&                       db,
+                                       const std::vector<std::string>& command,
+                                       const std::vector<fs::path>&    inputs);
+
+/**
+ * Determine whether the build step `step` that generated `output` is up-to-date: The output must
+ * exist, and the last successful execution of the step must have recorded the same fingerprint via
+ * `database::record_step_fingerprint`.
+ */
+bool step_is_up_to_date(const database&  db,
+                        path_ref         output,
+                        std::string_view step,
+                        std::uint64_t    fingerprint);
+
 }  // namespace bpt
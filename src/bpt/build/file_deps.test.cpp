@@ -1,6 +1,11 @@
 #include <bpt/build/file_deps.hpp>
 
+#include <bpt/util/shlex.hpp>
+#include <bpt/util/string.hpp>
+#include <bpt/util/time.hpp>
+
 #include <catch2/catch.hpp>
+#include <fmt/core.h>
 
 auto path_vec = [](auto... args) { return std::vector<bpt::fs::path>{args...}; };
 
@@ -21,6 +26,24 @@ TEST_CASE("Parse Makefile deps") {
     CHECK(deps.inputs == path_vec("/foo.main.cpp", "/stdc-predef.h"));
 }
 
+TEST_CASE("Parse Makefile deps with escapes") {
+    // Escaped spaces, hashes, and dollars are decoded. Other backslashes are kept.
+    auto deps = bpt::parse_mkfile_deps_str(
+        "C:\\build\\foo.o: C:\\src\\foo.cpp \\\r\n"
+        "  /inc/has\\ space.h /inc/\\#hash.h /inc/$$dollar.h\r\n");
+    CHECK(deps.output == "C:\\build\\foo.o");
+    CHECK(deps.inputs
+          == path_vec("C:\\src\\foo.cpp",
+                      "/inc/has space.h",
+                      "/inc/#hash.h",
+                      "/inc/$dollar.h"));
+
+    // Only the first rule is considered. Those that follow are phony targets from -MP
+    deps = bpt::parse_mkfile_deps_str("foo.o: foo.c bar.h \\\n baz.h\n\nbar.h:\n\nbaz.h:\n");
+    CHECK(deps.output == "foo.o");
+    CHECK(deps.inputs == path_vec("foo.c", "bar.h", "baz.h"));
+}
+
 TEST_CASE("Invalid deps") {
     // Invalid deps does not terminate. This will generate an error message in
     // the logs, but it is a non-fatal error that we can recover from.
@@ -54,4 +77,52 @@ Something else
               "C:\\foo\\bar\\filepath/quux.h",
               "C:\\foo\\bar\\filepath/cats/quux.h",
           }));
-}
\ No newline at end of file
+}
+
+namespace {
+
+/// The prior shell-splitting deps parser, kept as a reference point for the benchmark below
+bpt::file_deps_info parse_mkfile_deps_str_shlex(std::string_view str) {
+    bpt::file_deps_info ret;
+    auto                split = bpt::split_shell_string(str);
+    auto                iter  = split.begin();
+    if (iter == split.end() || !bpt::ends_with(*iter, ":")) {
+        return ret;
+    }
+    ret.output = iter->substr(0, iter->length() - 1);
+    ret.inputs.insert(ret.inputs.end(), std::next(iter), split.end());
+    return ret;
+}
+
+}  // namespace
+
+TEST_CASE("Benchmark Makefile deps parsing", "[.][benchmark]") {
+    // Generate a listing the size of one for a TU that includes a large number of headers
+    std::string listing = "/home/user/project/_build/obj/src/some/file.cpp.o: \\\n";
+    for (auto i = 0; i < 3000; ++i) {
+        listing += fmt::format("  /home/user/project/_deps/pkg-{}/include/pkg/header_{}.hpp \\\n",
+                               i % 300,
+                               i);
+    }
+    listing += "  /home/user/project/src/some/file.cpp\n";
+
+    // Both parsers must agree before we compare them
+    REQUIRE(bpt::parse_mkfile_deps_str(listing).inputs
+            == parse_mkfile_deps_str_shlex(listing).inputs);
+
+    constexpr auto n_iterations = 200;
+    auto           measure      = [&](auto&& parse) {
+        bpt::stopwatch sw;
+        for (auto i = 0; i < n_iterations; ++i) {
+            auto deps = parse(listing);
+            CHECK(deps.inputs.size() == 3001);
+        }
+        return sw.elapsed_us().count() / n_iterations;
+    };
+    auto shlex_us   = measure(parse_mkfile_deps_str_shlex);
+    auto scanner_us = measure(bpt::parse_mkfile_deps_str);
+    WARN(fmt::format("Parse {} bytes of deps: shell-split {}μs, scanner {}μs",
+                     listing.size(),
+                     shlex_us,
+                     scanner_us));
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <bpt/build/progress.hpp>
 #include <bpt/sdist/dist.hpp>
 #include <bpt/toolchain/toolchain.hpp>
 #include <bpt/util/fs/path.hpp>
@@ -17,6 +18,7 @@ struct build_params {
     bpt::toolchain          toolchain;
     bool                    generate_compdb = true;
     int                     parallel_jobs   = 0;
+    progress_options        progress{};
 };
 
 }  // namespace bpt
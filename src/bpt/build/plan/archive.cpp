@@ -1,7 +1,9 @@
 #include "./archive.hpp"
 
+#include <bpt/build/file_deps.hpp>
 #include <bpt/error/doc_ref.hpp>
 #include <bpt/error/errors.hpp>
+#include <bpt/util/fs/io.hpp>
 #include <bpt/util/log.hpp>
 #include <bpt/util/proc.hpp>
 #include <bpt/util/time.hpp>
@@ -37,6 +39,14 @@ void create_archive_plan::archive(const build_env& env) const {
     // in the logs
     auto out_relpath = fs::relative(ar.out_path, env.output_root).string();
 
+    // If every member is byte-identical to the ones that were used to create the existing archive,
+    // leave it untouched so that it keeps its identity and nothing downstream is redone.
+    const auto fingerprint = compute_step_fingerprint(env.db, ar_cmd, ar.input_files);
+    if (step_is_up_to_date(env.db, ar.out_path, "archive", fingerprint)) {
+        bpt_log(debug, "Skip archive of {} (Members are unchanged)", out_relpath);
+        return;
+    }
+
     // Different archiving tools behave differently between platforms depending on whether the
     // archive file exists. Make it uniform by simply removing the prior copy.
     if (fs::exists(ar.out_path)) {
@@ -69,4 +79,8 @@ void create_archive_plan::archive(const build_env& env) const {
                                        _qual_name),
                                    BPT_ERR_REF("archive-failure"));
     }
+
+    env.db.record_output_digest(ar.out_path, bpt::digest_file(ar.out_path));
+    env.db.record_step_fingerprint(ar.out_path, "archive", fingerprint);
+    env.db.record_step_timing(ar.out_path, "archive", _qual_name, dur_ms);
 }
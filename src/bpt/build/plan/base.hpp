@@ -1,5 +1,6 @@
 #pragma once
 
+#include <bpt/build/progress.hpp>
 #include <bpt/db/database.hpp>
 #include <bpt/toolchain/toolchain.hpp>
 #include <bpt/usage_reqs.hpp>
@@ -16,6 +17,8 @@ struct build_env {
     toolchain_knobs knobs;
 
     const usage_requirements& ureqs;
+
+    progress_options progress{};
 };
 
 using build_env_ref = const build_env&;
@@ -1,7 +1,9 @@
 #include "./compile_exec.hpp"
 
 #include <bpt/build/file_deps.hpp>
+#include <bpt/build/progress.hpp>
 #include <bpt/error/errors.hpp>
+#include <bpt/util/fs/io.hpp>
 #include <bpt/util/log.hpp>
 #include <bpt/util/parallel.hpp>
 #include <bpt/util/proc.hpp>
@@ -19,6 +21,8 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 
 using namespace bpt;
@@ -34,6 +38,141 @@ struct compile_counter {
     const std::size_t  max_digits;
 };
 
+/**
+ * Commits new dependency information to the build database from a dedicated thread while
+ * compilations are still running. Records are written in batched transactions: Whatever has been
+ * queued while the prior batch was being written becomes the next batch. Compilations that have
+ * completed are thus retained even if the build is interrupted, and there is no long tail of
+ * database updates once the last compilation finishes.
+ */
+class deps_writer {
+    struct pending_timing {
+        fs::path                  output;
+        std::string               owner;
+        std::chrono::milliseconds duration;
+    };
+
+    database& _db;
+
+    std::mutex                                      _mut;
+    std::condition_variable                         _cv;
+    std::vector<file_deps_info>                     _pending;
+    std::vector<std::pair<fs::path, std::uint64_t>> _pending_digests;
+    std::vector<pending_timing>                     _pending_timings;
+    bool                                            _done = false;
+    std::exception_ptr                              _error;
+    std::size_t                                     _n_batches = 0;
+    std::chrono::milliseconds                       _write_time{0};
+
+    // Declared last, as it must start after all other members are initialized
+    std::thread _thread;
+
+    void _write_batch(const std::vector<file_deps_info>&                     deps,
+                      const std::vector<std::pair<fs::path, std::uint64_t>>& digests,
+                      const std::vector<pending_timing>&                     timings) {
+        auto tr = _db.transaction();
+        for (auto& info : deps) {
+            bpt_log(trace, "Update dependency info on {}", info.output.string());
+            update_deps_info(neo::into(_db), info);
+        }
+        for (auto& [path, digest] : digests) {
+            _db.record_output_digest(path, digest);
+        }
+        for (auto& t : timings) {
+            _db.record_step_timing(t.output, "compile", t.owner, t.duration);
+        }
+    }
+
+    bool _has_pending() const noexcept {
+        return !_pending.empty() || !_pending_digests.empty() || !_pending_timings.empty();
+    }
+
+    void _run() {
+        neo::listener log_listen = &log::ev_log::print;
+
+        std::unique_lock lk{_mut};
+        while (true) {
+            _cv.wait(lk, [&] { return _done || _has_pending(); });
+            if (!_has_pending()) {
+                // We're done, and there is nothing left to write
+                break;
+            }
+            auto deps    = std::exchange(_pending, {});
+            auto digests = std::exchange(_pending_digests, {});
+            auto timings = std::exchange(_pending_timings, {});
+            lk.unlock();
+            try {
+                auto dur = timed<std::chrono::milliseconds>(
+                               [&] { _write_batch(deps, digests, timings); })
+                               .first;
+                lk.lock();
+                _write_time += dur;
+                ++_n_batches;
+            } catch (...) {
+                lk.lock();
+                _error = std::current_exception();
+                break;
+            }
+        }
+    }
+
+    void _stop() noexcept {
+        {
+            std::unique_lock lk{_mut};
+            _done = true;
+        }
+        _cv.notify_one();
+        _thread.join();
+    }
+
+public:
+    explicit deps_writer(database& db)
+        : _db(db)
+        , _thread([this] { _run(); }) {}
+
+    ~deps_writer() {
+        if (_thread.joinable()) {
+            _stop();
+        }
+    }
+
+    /// Queue new dependency information to be written
+    void push(file_deps_info info) {
+        std::unique_lock lk{_mut};
+        _pending.push_back(std::move(info));
+        _cv.notify_one();
+    }
+
+    /// Queue an output digest to be written
+    void push_digest(path_ref output, std::uint64_t digest) {
+        std::unique_lock lk{_mut};
+        _pending_digests.emplace_back(output, digest);
+        _cv.notify_one();
+    }
+
+    /// Queue the duration of a compilation to be recorded in the build history
+    void push_timing(path_ref output, std::string_view owner, std::chrono::milliseconds duration) {
+        std::unique_lock lk{_mut};
+        _pending_timings.push_back({output, std::string(owner), duration});
+        _cv.notify_one();
+    }
+
+    /**
+     * Write any remaining queued information and stop the writer thread. If writing any of the
+     * information failed, rethrows that error.
+     */
+    void finish() {
+        _stop();
+        bpt_log(debug,
+                "Dependency updates took {:L}ms in {} transactions",
+                _write_time.count(),
+                _n_batches);
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+    }
+};
+
 struct compile_ticket {
     std::reference_wrapper<const compile_file_plan> plan;
     // If non-null, the information required to compile the file
@@ -44,6 +183,8 @@ struct compile_ticket {
     std::optional<completed_compilation> prior_command;
     // Whether this compilation is for the purpose of header independence
     bool is_syntax_only = false;
+    // How long the compilation is expected to take, used to weight progress
+    std::chrono::milliseconds expected_duration{0};
 };
 
 /**
@@ -52,9 +193,14 @@ struct compile_ticket {
  * @param cf The compilation to execute
  * @param env The build environment
  * @param counter A thread-safe counter for display progress to the user
+ * @param progress Tracks the running compilations for the status line and progress estimates
+ * @param writer The writer that will receive new dependency information
  */
-std::optional<file_deps_info>
-handle_compilation(const compile_ticket& compile, build_env_ref env, compile_counter& counter) {
+void handle_compilation(const compile_ticket& compile,
+                        build_env_ref         env,
+                        compile_counter&      counter,
+                        progress_tracker&     progress,
+                        deps_writer&          writer) {
     if (!compile.needs_recompile) {
         // We don't actually compile this file. Just issue any prior warning messages that were from
         // a prior compilation.
@@ -66,7 +212,7 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
         auto& prior = *compile.prior_command;
         if (bpt::trim_view(prior.output).empty()) {
             // Nothing to show
-            return {};
+            return;
         }
         if (!compile.plan.get().rules().enable_warnings()) {
             // This file shouldn't show warnings. The compiler *may* have produced prior output, but
@@ -76,7 +222,7 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
             bpt_log(trace,
                     "Cached compiler output suppressed for file with disabled warnings ({})",
                     compile.plan.get().source_path().string());
-            return {};
+            return;
         }
         bpt_log(
             warn,
@@ -84,7 +230,7 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
             compile.plan.get().source_path().string(),
             prior.quoted_command,
             prior.output);
-        return {};
+        return;
     }
 
     // Create the parent directory
@@ -102,9 +248,13 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
 
     // Do it!
     bpt_log(info, msg);
+    progress.start();
     auto start_time = fs::file_time_type::clock::now();
-    auto&& [dur_ms, proc_res]
-        = timed<std::chrono::milliseconds>([&] { return run_proc(compile.command.command); });
+    auto&& [dur_ms, proc_res] = timed<std::chrono::milliseconds>([&] {
+        return run_proc(proc_options{.command       = compile.command.command,
+                                     .aux_output_fd = compile.command.gnu_deps_fd});
+    });
+    progress.finish(compile.expected_duration);
     auto nth = counter.n.fetch_add(1);
     bpt_log(info,
             "{:60} - {:>7L}ms [{:{}}/{}]",
@@ -118,6 +268,7 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
     const auto  compile_retc    = proc_res.retc;
     const auto  compile_signal  = proc_res.signal;
     std::string compiler_output = std::move(proc_res.output);
+    std::string piped_deps      = std::move(proc_res.aux_output);
 
     // Build dependency information, if applicable to the toolchain
     std::optional<file_deps_info> ret_deps_info;
@@ -128,26 +279,42 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
          */
     } else if (env.toolchain.deps_mode() == file_deps_mode::gnu) {
         // GNU-style deps using Makefile generation
-        assert(compile.command.gnu_depfile_path.has_value());
-        auto& df_path = *compile.command.gnu_depfile_path;
-        if (!fs::is_regular_file(df_path)) {
-            bpt_log(critical,
-                    "The expected Makefile deps were not generated on disk. This is a bug! "
-                    "(Expected file to exist: [{}])",
-                    df_path.string());
+        std::optional<file_deps_info> dep_info;
+        if (compile.command.gnu_deps_fd) {
+            // The compiler wrote the deps into a pipe, so there is no file to read back
+            if (trim_view(piped_deps).empty()) {
+                bpt_log(critical,
+                        "The expected Makefile deps were not written to the deps pipe. This is a "
+                        "bug! (Compiling [{}])",
+                        source_path.string());
+            } else {
+                bpt_log(trace, "Parsing compilation dependencies from the deps pipe");
+                dep_info = bpt::parse_mkfile_deps_str(piped_deps);
+            }
         } else {
-            bpt_log(trace, "Loading compilation dependencies from {}", df_path.string());
-            auto dep_info = bpt::parse_mkfile_deps_file(df_path);
+            assert(compile.command.gnu_depfile_path.has_value());
+            auto& df_path = *compile.command.gnu_depfile_path;
+            if (!fs::is_regular_file(df_path)) {
+                bpt_log(critical,
+                        "The expected Makefile deps were not generated on disk. This is a bug! "
+                        "(Expected file to exist: [{}])",
+                        df_path.string());
+            } else {
+                bpt_log(trace, "Loading compilation dependencies from {}", df_path.string());
+                dep_info = bpt::parse_mkfile_deps_file(df_path);
+            }
+        }
+        if (dep_info) {
             neo_assert(invariant,
-                       dep_info.output == compile.object_file_path,
+                       dep_info->output == compile.object_file_path,
                        "Generated mkfile deps output path does not match the object file path that "
                        " we gave it to compile into.",
-                       dep_info.output.string(),
+                       dep_info->output.string(),
                        compile.object_file_path.string());
-            dep_info.command.quoted_command = quote_command(compile.command.command);
-            dep_info.command.output         = compiler_output;
-            dep_info.command.duration       = dur_ms;
-            ret_deps_info                   = std::move(dep_info);
+            dep_info->command.quoted_command = quote_command(compile.command.command);
+            dep_info->command.output         = compiler_output;
+            dep_info->command.duration       = dur_ms;
+            ret_deps_info                    = std::move(dep_info);
         }
     } else if (env.toolchain.deps_mode() == file_deps_mode::msvc) {
         // Uglier deps generation by parsing the output from cl.exe
@@ -174,9 +341,25 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
          */
     }
 
+    // Record the digest of the new object file, so that later steps can tell whether it has actually
+    // changed (early cutoff)
+    std::optional<std::uint64_t> output_digest;
+    if (compiled_okay && !compile.is_syntax_only && fs::is_regular_file(compile.object_file_path)) {
+        output_digest = bpt::digest_file(compile.object_file_path);
+    }
+
     if (ret_deps_info) {
         ret_deps_info->command.toolchain_hash = env.toolchain.hash();
         ret_deps_info->compile_start_time     = start_time;
+        ret_deps_info->output_digest          = output_digest;
+        writer.push(std::move(*ret_deps_info));
+    } else if (output_digest) {
+        // We won't be updating the deps info for this file, but the digest of the object must not
+        // be left stale
+        writer.push_digest(compile.object_file_path, *output_digest);
+    }
+    if (compiled_okay) {
+        writer.push_timing(compile.object_file_path, compile.plan.get().qualifier(), dur_ms);
     }
 
     // MSVC prints the filename of the source file. Remove it from the output.
@@ -220,7 +403,6 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
 
     // We'll only get here if the compilation was successful, otherwise we throw
     assert(compiled_okay);
-    return ret_deps_info;
 }
 
 /**
@@ -287,26 +469,40 @@ bool bpt::detail::compile_all(const ref_vector<const compile_file_plan>& compile
     const auto      max_digits = fmt::format("{}", n_to_compile).size();
     compile_counter counter{.max = n_to_compile, .max_digits = max_digits};
 
-    // Ass we execute, accumulate new dependency information from successful compilations
-    std::vector<file_deps_info> all_new_deps;
-    std::mutex                  mut;
+    // Weight each compilation by its average duration from prior builds. Files without a history
+    // are assumed to take as long as the average of those that have one.
+    std::chrono::milliseconds known_total{0};
+    int                       n_known = 0;
+    for (auto& tkt : each_realized) {
+        if (tkt.needs_recompile && tkt.prior_command && tkt.prior_command->duration.count() > 0) {
+            tkt.expected_duration = tkt.prior_command->duration;
+            known_total += tkt.expected_duration;
+            ++n_known;
+        }
+    }
+    const auto default_duration = n_known ? known_total / n_known : std::chrono::milliseconds(1000);
+    std::vector<std::chrono::milliseconds> expected_durations;
+    for (auto& tkt : each_realized) {
+        if (!tkt.needs_recompile) {
+            continue;
+        }
+        if (tkt.expected_duration.count() == 0) {
+            tkt.expected_duration = default_duration;
+        }
+        expected_durations.push_back(tkt.expected_duration);
+    }
+    const int        n_workers = njobs < 1 ? int(std::thread::hardware_concurrency() + 2) : njobs;
+    progress_tracker progress{expected_durations, n_workers, env.progress};
+
+    // As we execute, commit new dependency information from successful compilations
+    deps_writer writer{env.db};
     // Do it!
     auto okay = parallel_run(each_realized, njobs, [&](const compile_ticket& tkt) {
-        auto new_dep = handle_compilation(tkt, env, counter);
-        if (new_dep) {
-            std::unique_lock lk{mut};
-            all_new_deps.push_back(std::move(*new_dep));
-        }
+        handle_compilation(tkt, env, counter, progress, writer);
     });
 
-    // Update compile dependency information
-    bpt::stopwatch update_timer;
-    auto           tr = env.db.transaction();
-    for (auto& info : all_new_deps) {
-        bpt_log(trace, "Update dependency info on {}", info.output.string());
-        update_deps_info(neo::into(env.db), info);
-    }
-    bpt_log(debug, "Dependency update took {:L}ms", update_timer.elapsed_ms().count());
+    // Flush the remaining dependency information
+    writer.finish();
 
     cancellation_point();
     // Return whether or not there were any failures.
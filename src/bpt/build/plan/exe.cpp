@@ -1,8 +1,10 @@
 #include "./exe.hpp"
 
+#include <bpt/build/file_deps.hpp>
 #include <bpt/build/plan/library.hpp>
 #include <bpt/error/errors.hpp>
 #include <bpt/util/algo.hpp>
+#include <bpt/util/fs/io.hpp>
 #include <bpt/util/log.hpp>
 #include <bpt/util/proc.hpp>
 #include <bpt/util/time.hpp>
@@ -11,6 +13,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <set>
 
 using namespace bpt;
 using namespace fansi::literals;
@@ -41,14 +44,34 @@ void link_executable_plan::link(build_env_ref env, const library_plan& lib) cons
         bpt_log(trace, "Executable has no corresponding archive library input");
     }
 
+    std::vector<fs::path> link_inputs;
     for (const lm::usage& links : _links) {
         bpt_log(trace, "  - Link with: {}/{}", links.name, links.namespace_);
-        extend(spec.inputs, env.ureqs.link_paths(links));
+        extend(link_inputs, env.ureqs.link_paths(links));
     }
+    // Each closure is already ordered dependents-first. Keeping only the last occurrence of an
+    // input that is shared between them preserves that order for the combined list.
+    std::set<fs::path>    seen_inputs;
+    std::vector<fs::path> unique_inputs;
+    for (auto it = link_inputs.rbegin(); it != link_inputs.rend(); ++it) {
+        if (seen_inputs.insert(*it).second) {
+            unique_inputs.push_back(std::move(*it));
+        }
+    }
+    std::reverse(unique_inputs.begin(), unique_inputs.end());
+    extend(spec.inputs, std::move(unique_inputs));
 
     // Do it!
     const auto link_command
         = env.toolchain.create_link_executable_command(spec, bpt::fs::current_path(), env.knobs);
+
+    // Don't relink if none of the linker inputs have changed their content
+    const auto fingerprint = compute_step_fingerprint(env.db, link_command, spec.inputs);
+    if (step_is_up_to_date(env.db, spec.output, "link", fingerprint)) {
+        bpt_log(debug, "Skip link of {} (Inputs are unchanged)", spec.output.string());
+        return;
+    }
+
     fs::create_directories(spec.output.parent_path());
     auto msg = fmt::format("[{}] Link: {:30}",
                            lib.qualified_name(),
@@ -68,6 +91,10 @@ void link_executable_plan::link(build_env_ref env, const library_plan& lib) cons
             proc_res.retc,
             proc_res.output);
     }
+
+    env.db.record_output_digest(spec.output, bpt::digest_file(spec.output));
+    env.db.record_step_fingerprint(spec.output, "link", fingerprint);
+    env.db.record_step_timing(spec.output, "link", lib.qualified_name(), dur_ms);
 }
 
 bool link_executable_plan::is_app() const noexcept {
@@ -82,13 +109,25 @@ std::optional<test_failure> link_executable_plan::run_test(build_env_ref env) co
     auto exe_path = calc_executable_path(env);
     auto msg      = fmt::format("Run test: .br.cyan[{:30}]"_styled,
                            fs::relative(exe_path, env.output_root).string());
+    // A test executable that is byte-identical to one that has already passed need not run again
+    const auto fingerprint = compute_step_fingerprint(env.db, {exe_path.string()}, {exe_path});
+    if (step_is_up_to_date(env.db, exe_path, "test", fingerprint)) {
+        bpt_log(info, "{} - .br.green[PASS] (.br.blue[executable is unchanged])"_styled, msg);
+        return std::nullopt;
+    }
+
     bpt_log(info, msg);
     using namespace std::chrono_literals;
     auto&& [dur, res] = timed<std::chrono::microseconds>(
         [&] { return run_proc({.command = {exe_path.string()}, .timeout = 10s}); });
+    env.db.record_step_timing(exe_path,
+                              "test",
+                              _main_compile.qualifier(),
+                              std::chrono::duration_cast<std::chrono::milliseconds>(dur));
 
     if (res.okay()) {
         bpt_log(info, "{} - .br.green[PASS] - {:>9L}μs"_styled, msg, dur.count());
+        env.db.record_step_fingerprint(exe_path, "test", fingerprint);
         return std::nullopt;
     } else {
         auto exit_msg = fmt::format(res.signal ? "signalled {}" : "exited {}",
@@ -6,12 +6,12 @@
 #include <bpt/error/errors.hpp>
 #include <bpt/error/nonesuch.hpp>
 #include <bpt/error/on_error.hpp>
+#include <bpt/util/fs/path.hpp>
 #include <bpt/util/log.hpp>
 #include <bpt/util/parallel.hpp>
 
 #include <boost/leaf/exception.hpp>
 #include <neo/tl.hpp>
-#include <range/v3/algorithm/any_of.hpp>
 #include <range/v3/range/conversion.hpp>
 #include <range/v3/view/concat.hpp>
 #include <range/v3/view/filter.hpp>
@@ -20,8 +20,10 @@
 #include <range/v3/view/transform.hpp>
 #include <range/v3/view/zip.hpp>
 
+#include <map>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
 
 using namespace bpt;
 
@@ -33,13 +35,6 @@ decltype(auto) pair_up(T& left, Range& right) {
     return ranges::views::zip(rep, right);
 }
 
-struct pending_file {
-    bool     marked = false;
-    fs::path filepath;
-
-    auto operator<=>(const pending_file&) const noexcept = default;
-};
-
 }  // namespace
 
 void build_plan::compile_all(const build_env& env, int njobs) const {
@@ -52,36 +47,38 @@ void build_plan::compile_all(const build_env& env, int njobs) const {
 void build_plan::compile_files(const build_env&             env,
                                int                          njobs,
                                const std::vector<fs::path>& filepaths) const {
+    // Index every compilation by the resolved path of its source file. Only the source roots are
+    // resolved against the filesystem: The path of each file within its root is appended
+    // lexically, so that building the index does not need to resolve every file in the project.
+    std::map<fs::path, fs::path>                                   resolved_roots;
+    std::unordered_multimap<std::string, const compile_file_plan*> by_path;
+    for (const compile_file_plan& comp : iter_compilations(*this)) {
+        auto& sf   = comp.source();
+        auto  root = resolved_roots.find(sf.basis_path);
+        if (root == resolved_roots.end()) {
+            root = resolved_roots.emplace(sf.basis_path, resolve_path_weak(sf.basis_path)).first;
+        }
+        auto resolved = normalize_path(root->second / sf.path.lexically_relative(sf.basis_path));
+        by_path.emplace(resolved.string(), &comp);
+    }
 
-    auto as_pending =                  //
-        ranges::views::all(filepaths)  //
-        | ranges::views::transform([](auto&& path) {
-              return pending_file{false, fs::weakly_canonical(path)};
-          })
-        | ranges::to_vector;
-
-    bpt::sort_unique_erase(as_pending);
-
-    auto check_compilation = [&](const compile_file_plan& comp) {
-        return ranges::any_of(as_pending, [&](pending_file& f) {
-            bool same_file = f.filepath == fs::weakly_canonical(comp.source_path());
-            if (same_file) {
-                f.marked = true;
-            }
-            return same_file;
-        });
-    };
-
-    // Create a vector of compilations, and mark files so that we can find who hasn't been marked.
-    auto comps
-        = iter_compilations(*this) | ranges::views::filter(check_compilation) | ranges::to_vector;
-
-    // Make an error if there are any unmarked files
-    auto missing_files = as_pending  //
-        | ranges::views::filter(NEO_TL(!_1.marked))
-        | ranges::views::transform(NEO_TL(e_nonesuch{_1.filepath.string(), std::nullopt}))
+    auto requested = filepaths | ranges::views::transform(NEO_TL(resolve_path_weak(_1)))
         | ranges::to_vector;
+    bpt::sort_unique_erase(requested);
+
+    std::vector<compile_file_plan> comps;
+    std::vector<e_nonesuch>        missing_files;
+    for (auto& filepath : requested) {
+        auto [first, last] = by_path.equal_range(filepath.string());
+        if (first == last) {
+            missing_files.push_back(e_nonesuch{filepath.string(), std::nullopt});
+        }
+        for (; first != last; ++first) {
+            comps.push_back(*first->second);
+        }
+    }
 
+    // Make an error if there are any files that are not compiled as part of the plan
     if (!missing_files.empty()) {
         BOOST_LEAF_THROW_EXCEPTION(make_user_error<errc::compile_failure>(), missing_files);
     }
@@ -24,7 +24,8 @@ using namespace fansi::literals;
 library_plan library_plan::create(path_ref                    pkg_base,
                                   const crs::package_info&    pkg,
                                   const crs::library_info&    lib,
-                                  const library_build_params& params) {
+                                  const library_build_params& params,
+                                  const library_sources&      sources) {
     fs::path out_dir   = params.out_subdir;
     auto     qual_name = neo::ufmt("{}/{}", pkg.id.name.str, lib.name.str);
 
@@ -35,40 +36,32 @@ library_plan library_plan::create(path_ref                    pkg_base,
     std::vector<source_file> header_sources;
     std::vector<source_file> public_header_sources;
 
-    // Collect the source for this library. This will look for any compilable sources in the
-    // `src/` subdirectory of the library.
+    // Sort each source file from the `src/` subdirectory of the library between the source
+    // arrays, depending on the kind of source that we are looking at.
     auto src_dir = bpt::source_root(pkg_base / lib.path / "src");
-    if (src_dir.exists()) {
-        // Sort each source file between the three source arrays, depending on
-        // the kind of source that we are looking at.
-        auto all_sources = src_dir.collect_sources();
-        for (const auto& sfile : all_sources) {
-            if (sfile.kind == source_kind::test) {
-                test_sources.push_back(sfile);
-            } else if (sfile.kind == source_kind::app) {
-                app_sources.push_back(sfile);
-            } else if (sfile.kind == source_kind::source) {
-                lib_sources.push_back(sfile);
-            } else if (sfile.kind == source_kind::header) {
-                header_sources.push_back(sfile);
-            } else {
-                assert(sfile.kind == source_kind::header_impl);
-            }
+    for (const auto& sfile : sources.src) {
+        if (sfile.kind == source_kind::test) {
+            test_sources.push_back(sfile);
+        } else if (sfile.kind == source_kind::app) {
+            app_sources.push_back(sfile);
+        } else if (sfile.kind == source_kind::source) {
+            lib_sources.push_back(sfile);
+        } else if (sfile.kind == source_kind::header) {
+            header_sources.push_back(sfile);
+        } else {
+            assert(sfile.kind == source_kind::header_impl);
         }
     }
 
     auto include_dir = bpt::source_root{pkg_base / lib.path / "include"};
-    if (include_dir.exists()) {
-        auto all_sources = include_dir.collect_sources();
-        for (const auto& sfile : all_sources) {
-            if (!is_header(sfile.kind)) {
-                bpt_log(
-                    warn,
-                    "Public include/ should only contain header files. Not a header: [.br.yellow[{}]]"_styled,
-                    sfile.path.string());
-            } else if (sfile.kind == source_kind::header) {
-                public_header_sources.push_back(sfile);
-            }
+    for (const auto& sfile : sources.include) {
+        if (!is_header(sfile.kind)) {
+            bpt_log(
+                warn,
+                "Public include/ should only contain header files. Not a header: [.br.yellow[{}]]"_styled,
+                sfile.path.string());
+        } else if (sfile.kind == source_kind::header) {
+            public_header_sources.push_back(sfile);
         }
     }
     if (!params.build_tests) {
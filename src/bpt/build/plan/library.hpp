@@ -6,6 +6,7 @@
 #include <bpt/util/fs/path.hpp>
 
 #include <bpt/crs/info/package.hpp>
+#include <bpt/sdist/file.hpp>
 
 #include <libman/library.hpp>
 
@@ -31,6 +32,16 @@ struct library_build_params {
     bool enable_warnings = false;
 };
 
+/**
+ * The source files that were found in the `src/` and `include/` directories of a library
+ */
+struct library_sources {
+    /// The files found in `src/`. Empty if the directory does not exist.
+    std::vector<source_file> src;
+    /// The files found in `include/`. Empty if the directory does not exist.
+    std::vector<source_file> include;
+};
+
 /**
  * A `library_plan` is a composite object that keeps track of the parameters for building a library,
  * including:
@@ -127,6 +138,7 @@ public:
      * will be inferred
      * @param params Parameters controlling the build of the library. i.e. if we create tests,
      * enable warnings, etc.
+     * @param sources The source files that were collected from the library's directories
      * @param qual_name Optionally, provide the fully-qualified name of the library that is being
      * built
      *
@@ -136,7 +148,8 @@ public:
     static library_plan create(path_ref                    pkg_base,
                                const crs::package_info&    pkg,
                                const crs::library_info&    lib,
-                               const library_build_params& params);
+                               const library_build_params& params,
+                               const library_sources&      sources);
 };
 
 }  // namespace bpt
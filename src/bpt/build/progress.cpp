@@ -0,0 +1,127 @@
+#include "./progress.hpp"
+
+#include <bpt/util/log.hpp>
+
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+using namespace bpt;
+using namespace std::chrono_literals;
+
+using std::chrono::milliseconds;
+
+namespace {
+
+std::string format_duration(milliseconds dur) {
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(dur).count();
+    if (secs < 60) {
+        return fmt::format("{}s", secs);
+    }
+    return fmt::format("{}m{:02}s", secs / 60, secs % 60);
+}
+
+}  // namespace
+
+milliseconds bpt::predict_remaining(milliseconds work_total,
+                                    milliseconds work_done,
+                                    milliseconds elapsed,
+                                    int          parallelism) noexcept {
+    auto remaining = std::max(work_total - work_done, 0ms);
+    if (work_done > 0ms) {
+        return milliseconds(static_cast<milliseconds::rep>(
+            static_cast<double>(remaining.count()) * static_cast<double>(elapsed.count())
+            / static_cast<double>(work_done.count())));
+    }
+    return remaining / std::max(parallelism, 1);
+}
+
+std::string progress_estimate::to_string() const {
+    auto pct = work_total > 0ms ? (work_done.count() * 100) / work_total.count() : 100;
+    return fmt::format("[{}/{}] {} running, {}% of expected work done, ETA {}",
+                       n_done,
+                       n_total,
+                       n_running,
+                       pct,
+                       format_duration(eta));
+}
+
+std::string progress_estimate::to_json() const {
+    nlohmann::json data = {
+        {"total", n_total},
+        {"done", n_done},
+        {"running", n_running},
+        {"work_total_ms", work_total.count()},
+        {"work_done_ms", work_done.count()},
+        {"elapsed_ms", elapsed.count()},
+        {"eta_ms", eta.count()},
+    };
+    return data.dump();
+}
+
+progress_tracker::progress_tracker(const std::vector<milliseconds>& expected,
+                                   int                              parallelism,
+                                   progress_options                 opts)
+    : _opts(std::move(opts))
+    , _parallelism(parallelism)
+    , _n_total(expected.size())
+    , _work_total(std::accumulate(expected.begin(), expected.end(), 0ms)) {
+    if (_opts.json_path) {
+        _json_out.open(*_opts.json_path, std::ios::app);
+        if (!_json_out) {
+            bpt_log(warn,
+                    "Unable to open [{}] to write build progress; it will not be recorded",
+                    _opts.json_path->string());
+        }
+    }
+    _report(_estimate(_start_time));
+}
+
+progress_tracker::~progress_tracker() {
+    if (_opts.live) {
+        log::set_status("");
+    }
+}
+
+progress_estimate progress_tracker::_estimate(clock::time_point now) const noexcept {
+    progress_estimate ret;
+    ret.n_total    = _n_total;
+    ret.n_done     = _n_done;
+    ret.n_running  = _n_running;
+    ret.work_total = _work_total;
+    ret.work_done  = _work_done;
+    ret.elapsed    = std::chrono::duration_cast<milliseconds>(now - _start_time);
+    ret.eta        = predict_remaining(_work_total, _work_done, ret.elapsed, _parallelism);
+    return ret;
+}
+
+void progress_tracker::_report(const progress_estimate& est) {
+    if (_opts.live) {
+        log::set_status(est.to_string());
+    }
+    if (_json_out.is_open()) {
+        // Flush each line, so that anyone watching the file sees it right away
+        _json_out << est.to_json() << std::endl;
+    }
+}
+
+void progress_tracker::start() {
+    std::unique_lock lk{_mutex};
+    ++_n_running;
+    _report(_estimate(clock::now()));
+}
+
+void progress_tracker::finish(milliseconds expected) {
+    std::unique_lock lk{_mutex};
+    --_n_running;
+    ++_n_done;
+    _work_done += expected;
+    _report(_estimate(clock::now()));
+}
+
+progress_estimate progress_tracker::estimate() const noexcept {
+    std::unique_lock lk{_mutex};
+    return _estimate(clock::now());
+}
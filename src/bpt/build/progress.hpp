@@ -0,0 +1,106 @@
+#pragma once
+
+#include <bpt/util/fs/path.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace bpt {
+
+/**
+ * @brief How progress should be reported while a build is running
+ */
+struct progress_options {
+    /// Keep a live status line beneath the log output. Only used when the output is a terminal.
+    bool live = false;
+    /// If set, append a JSON object to this file (one per line) each time the progress changes
+    std::optional<fs::path> json_path{};
+};
+
+/**
+ * @brief A snapshot of the progress of a set of jobs
+ */
+struct progress_estimate {
+    std::size_t n_total   = 0;
+    std::size_t n_done    = 0;
+    std::size_t n_running = 0;
+    /// The sum of the expected durations of all jobs
+    std::chrono::milliseconds work_total{0};
+    /// The sum of the expected durations of the jobs that have finished
+    std::chrono::milliseconds work_done{0};
+    /// Wall time since the jobs were started
+    std::chrono::milliseconds elapsed{0};
+    /// The predicted wall time until all jobs have finished
+    std::chrono::milliseconds eta{0};
+
+    /// Render the estimate as a single line of human-readable text
+    std::string to_string() const;
+    /// Render the estimate as a single-line JSON object
+    std::string to_json() const;
+};
+
+/**
+ * @brief Tracks running and finished jobs and predicts how long the remainder will take.
+ *
+ * Each job is weighted by its expected duration (e.g. the average duration from prior builds),
+ * so a few slow jobs at the end of a build are not mistaken for a stall. The ETA scales the
+ * remaining expected work by the rate at which expected work has actually been completed so far,
+ * which accounts for both parallelism and the speed of the current machine. Thread-safe.
+ */
+class progress_tracker {
+    using clock = std::chrono::steady_clock;
+
+    mutable std::mutex _mutex;
+    progress_options   _opts;
+    clock::time_point  _start_time = clock::now();
+    int                _parallelism;
+
+    std::size_t               _n_total   = 0;
+    std::size_t               _n_done    = 0;
+    std::size_t               _n_running = 0;
+    std::chrono::milliseconds _work_total{0};
+    std::chrono::milliseconds _work_done{0};
+
+    std::ofstream _json_out;
+
+    progress_estimate _estimate(clock::time_point now) const noexcept;
+    void              _report(const progress_estimate&);
+
+public:
+    /**
+     * @param expected The expected duration of each job
+     * @param parallelism The number of jobs that may run at once, used before any job has finished
+     * @param opts Where the progress should be reported
+     */
+    progress_tracker(const std::vector<std::chrono::milliseconds>& expected,
+                     int                                           parallelism,
+                     progress_options                              opts);
+    ~progress_tracker();
+
+    progress_tracker(const progress_tracker&) = delete;
+
+    /// Note that a job has started running
+    void start();
+    /// Note that a job has finished, with the expected duration that it was given
+    void finish(std::chrono::milliseconds expected);
+
+    progress_estimate estimate() const noexcept;
+};
+
+/**
+ * @brief Predict the wall time until the remaining expected work has been completed.
+ *
+ * Once some work is done, the remainder is scaled by the observed ratio of wall time to completed
+ * work. Before that, the remaining work is assumed to be spread evenly over `parallelism` jobs.
+ */
+std::chrono::milliseconds predict_remaining(std::chrono::milliseconds work_total,
+                                            std::chrono::milliseconds work_done,
+                                            std::chrono::milliseconds elapsed,
+                                            int                       parallelism) noexcept;
+
+}  // namespace bpt
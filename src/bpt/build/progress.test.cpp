@@ -0,0 +1,34 @@
+#include <bpt/build/progress.hpp>
+
+#include <catch2/catch.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Predict the remaining build time") {
+    // Nothing finished yet: Spread the expected work over the parallel jobs
+    CHECK(bpt::predict_remaining(8000ms, 0ms, 0ms, 4) == 2000ms);
+    CHECK(bpt::predict_remaining(8000ms, 0ms, 0ms, 0) == 8000ms);
+    // Half of the work took 1s of wall time, so the other half will take another
+    CHECK(bpt::predict_remaining(8000ms, 4000ms, 1000ms, 4) == 1000ms);
+    // This machine is running twice as slow as the history predicts
+    CHECK(bpt::predict_remaining(8000ms, 2000ms, 2000ms, 1) == 6000ms);
+    // Jobs that took longer than expected never make the remainder negative
+    CHECK(bpt::predict_remaining(1000ms, 3000ms, 500ms, 1) == 0ms);
+}
+
+TEST_CASE("Track progress") {
+    bpt::progress_tracker tracker{{1000ms, 3000ms}, 2, {}};
+    auto                  est = tracker.estimate();
+    CHECK(est.n_total == 2);
+    CHECK(est.n_done == 0);
+    CHECK(est.work_total == 4000ms);
+
+    tracker.start();
+    tracker.start();
+    tracker.finish(1000ms);
+    est = tracker.estimate();
+    CHECK(est.n_running == 1);
+    CHECK(est.n_done == 1);
+    CHECK(est.work_done == 1000ms);
+    CHECK(est.to_json().find(R"("done":1)") != std::string::npos);
+}
@@ -19,6 +19,7 @@ static int _build(const options& opts) {
         .tweaks_dir        = opts.build.tweaks_dir,
         .toolchain         = opts.load_toolchain(),
         .parallel_jobs     = opts.jobs,
+        .progress          = {.live = opts.build.progress, .json_path = opts.build.progress_json},
     });
 
     return 0;
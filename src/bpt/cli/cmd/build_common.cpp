@@ -47,7 +47,7 @@ builder bpt::cli::create_project_builder(const bpt::cli::options& opts) {
         .enable_warnings = !opts.disable_warnings,
     };
 
-    auto  cache   = open_ready_cache(opts);
+    auto  cache   = open_ready_cache(opts, repo_sync_timing::when_needed);
     auto& meta_db = cache.db();
 
     sdist proj_sd = bpt_leaf_try { return sdist::from_directory(opts.project_dir); }
@@ -73,6 +73,7 @@ builder bpt::cli::create_project_builder(const bpt::cli::options& opts) {
         }
 
         auto sln = bpt::solve(meta_db, crs_deps);
+        cache.prefetch_all(sln, {.n_jobs = opts.jobs});
         for (auto&& pkg : sln) {
             auto dep_meta = fetch_cache_load_dependency(cache, pkg, builder, "_deps");
             resolve_implicit_usages(proj_sd.pkg, dep_meta);
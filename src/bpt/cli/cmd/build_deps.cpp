@@ -20,7 +20,7 @@
 namespace bpt::cli::cmd {
 
 static int _build_deps(const options& opts) {
-    auto cache = open_ready_cache(opts);
+    auto cache = open_ready_cache(opts, repo_sync_timing::when_needed);
 
     bpt::build_params params{
         .out_root          = opts.out_path.value_or(fs::current_path() / "_deps"),
@@ -54,6 +54,7 @@ static int _build_deps(const options& opts) {
         = ranges::views::concat(file_deps, cli_deps);
 
     auto sln = bpt::solve(cache.db(), all_deps);
+    cache.prefetch_all(sln, {.n_jobs = opts.jobs});
     for (auto&& pkg : sln) {
         fetch_cache_load_dependency(cache, pkg, builder, ".");
     }
@@ -0,0 +1,354 @@
+#include "../options.hpp"
+
+#include <bpt/db/database.hpp>
+#include <bpt/error/try_catch.hpp>
+#include <bpt/sdist/file.hpp>
+#include <bpt/util/log.hpp>
+
+#include <fansi/styled.hpp>
+#include <fmt/core.h>
+#include <fmt/ostream.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <ranges>
+
+using namespace fansi::literals;
+
+namespace bpt::cli::cmd {
+
+namespace {
+
+using std::chrono::milliseconds;
+
+/// The steps that are shown in the report, in order
+constexpr std::string_view report_steps[] = {"compile", "archive", "link", "test"};
+
+struct library_cost {
+    std::string  name;
+    milliseconds latest{0};
+    milliseconds previous{0};
+    int          n_files = 0;
+};
+
+/**
+ * Sum the compile cost of each library, using the most recent duration of each of its files. Files
+ * that have no previous duration count their latest one in both totals, so they don't skew the
+ * trend.
+ */
+std::vector<library_cost> library_costs(const std::vector<step_timing_history>& compiles) {
+    std::map<std::string, library_cost> by_name;
+    for (auto& tu : compiles) {
+        auto& cost = by_name[tu.owner];
+        cost.name  = tu.owner;
+        cost.latest += tu.latest;
+        cost.previous += tu.previous.value_or(tu.latest);
+        ++cost.n_files;
+    }
+    std::vector<library_cost> ret;
+    for (auto& [_, cost] : by_name) {
+        ret.push_back(cost);
+    }
+    std::ranges::sort(ret, std::ranges::greater{}, &library_cost::latest);
+    return ret;
+}
+
+std::string show_path(path_ref p, path_ref build_root) {
+    auto rel = p.lexically_relative(build_root);
+    return (rel.empty() || *rel.begin() == "..") ? p.string() : rel.string();
+}
+
+std::string show_trend(milliseconds latest, std::optional<milliseconds> previous) {
+    if (!previous || *previous == milliseconds(0)) {
+        return "";
+    }
+    auto pct = (latest - *previous).count() * 100 / previous->count();
+    if (pct == 0) {
+        return "±0%";
+    }
+    return fmt::format("{:+}%", pct);
+}
+
+/**
+ * The size of the files read by a single compilation. This is the size of the inputs as they are
+ * stored on disk, not the size of the preprocessed translation unit, which also counts each
+ * header once for every time that it is included and expands macros.
+ */
+struct compilation_size {
+    fs::path       output;
+    std::uintmax_t on_disk_input_bytes;
+    int            n_inputs;
+    milliseconds   avg_duration;
+};
+
+struct header_report {
+    /// The headers whose modification causes the most recompilation, most expensive first
+    std::vector<input_impact> headers;
+    /// The compilations that read the most input from disk, largest first
+    std::vector<compilation_size> compilations;
+};
+
+bool is_header_input(path_ref p) {
+    auto kind = infer_source_kind(p);
+    // Files without a recognized extension are usually standard library headers
+    return !kind || *kind == source_kind::header || *kind == source_kind::header_impl;
+}
+
+header_report collect_header_report(const database& db) {
+    header_report ret;
+    for (auto& impact : db.input_impacts()) {
+        if (is_header_input(impact.input)) {
+            ret.headers.push_back(impact);
+        }
+    }
+
+    // Most inputs are shared by many compilations, so only look up the size of each one once
+    std::map<fs::path, std::uintmax_t> sizes;
+    for (auto& comp : db.all_compilation_inputs()) {
+        std::uintmax_t total = 0;
+        for (auto& input : comp.inputs) {
+            auto [it, inserted] = sizes.try_emplace(input, 0);
+            if (inserted) {
+                std::error_code ec;
+                auto            size = fs::file_size(input, ec);
+                it->second           = ec ? 0 : size;
+            }
+            total += it->second;
+        }
+        ret.compilations.push_back(compilation_size{
+            .output              = comp.output,
+            .on_disk_input_bytes = total,
+            .n_inputs            = static_cast<int>(comp.inputs.size()),
+            .avg_duration        = comp.avg_duration,
+        });
+    }
+    std::ranges::sort(ret.compilations,
+                      std::ranges::greater{},
+                      &compilation_size::on_disk_input_bytes);
+    return ret;
+}
+
+nlohmann::json step_json(const step_timing_history& h, path_ref build_root) {
+    return nlohmann::json{
+        {"output", show_path(h.output, build_root)},
+        {"library", h.owner},
+        {"latest_ms", h.latest.count()},
+        {"previous_ms",
+         h.previous ? nlohmann::json(h.previous->count()) : nlohmann::json(nullptr)},
+        {"average_ms", h.average.count()},
+        {"fastest_ms", h.fastest.count()},
+        {"slowest_ms", h.slowest.count()},
+        {"runs", h.n_runs},
+    };
+}
+
+void print_json(const database& db, path_ref build_root, std::size_t top, bool with_headers) {
+    nlohmann::json report = nlohmann::json::object();
+    for (auto step : report_steps) {
+        auto timings = db.step_timings(step);
+        auto entries = nlohmann::json::array();
+        for (auto& h : timings | std::views::take(top)) {
+            entries.push_back(step_json(h, build_root));
+        }
+        report[std::string(step)] = std::move(entries);
+        if (step == "compile") {
+            auto libs = nlohmann::json::array();
+            for (auto& lib : library_costs(timings)) {
+                libs.push_back({
+                    {"name", lib.name},
+                    {"compile_ms", lib.latest.count()},
+                    {"previous_compile_ms", lib.previous.count()},
+                    {"files", lib.n_files},
+                });
+            }
+            report["libraries"] = std::move(libs);
+        }
+    }
+    auto runs = nlohmann::json::array();
+    for (auto& run : db.run_totals()) {
+        auto steps = nlohmann::json::object();
+        for (auto& st : run.steps) {
+            steps[st.step] = {{"total_ms", st.total.count()}, {"count", st.count}};
+        }
+        runs.push_back({
+            {"run_id", run.run_id},
+            {"started_at_ms",
+             std::chrono::duration_cast<milliseconds>(run.started_at.time_since_epoch()).count()},
+            {"steps", std::move(steps)},
+        });
+    }
+    report["runs"] = std::move(runs);
+
+    if (with_headers) {
+        auto hr      = collect_header_report(db);
+        auto headers = nlohmann::json::array();
+        for (auto& h : hr.headers | std::views::take(top)) {
+            headers.push_back({
+                {"header", h.input.string()},
+                {"dependents", h.n_dependents},
+                {"rebuild_cost_ms", h.rebuild_cost.count()},
+            });
+        }
+        report["headers"] = std::move(headers);
+        auto comps        = nlohmann::json::array();
+        for (auto& c : hr.compilations | std::views::take(top)) {
+            comps.push_back({
+                {"output", show_path(c.output, build_root)},
+                {"on_disk_input_bytes", c.on_disk_input_bytes},
+                {"inputs", c.n_inputs},
+                {"average_ms", c.avg_duration.count()},
+            });
+        }
+        report["compile_inputs"] = std::move(comps);
+    }
+    std::cout << report.dump(2) << '\n';
+}
+
+void print_header_tables(const database& db, path_ref build_root, std::size_t top) {
+    auto hr = collect_header_report(db);
+    if (!hr.headers.empty()) {
+        fmt::print(std::cout, "\n.bold[Headers by rebuild cost]:\n"_styled);
+        fmt::print(std::cout, "  {:>12} {:>10}  {}\n", "Rebuild cost", "Dependents", "Header");
+        for (auto& h : hr.headers | std::views::take(top)) {
+            fmt::print(std::cout,
+                       "  {:>10L}ms {:>10}  {}\n",
+                       h.rebuild_cost.count(),
+                       h.n_dependents,
+                       h.input.string());
+        }
+    }
+    if (!hr.compilations.empty()) {
+        fmt::print(std::cout, "\n.bold[Compilations by on-disk input size]:\n"_styled);
+        fmt::print(std::cout,
+                   "  {:>12} {:>7} {:>10}  {}\n",
+                   "On-disk KiB",
+                   "Files",
+                   "Average",
+                   "Output");
+        for (auto& c : hr.compilations | std::views::take(top)) {
+            fmt::print(std::cout,
+                       "  {:>12L} {:>7} {:>8L}ms  {}\n",
+                       c.on_disk_input_bytes / 1024,
+                       c.n_inputs,
+                       c.avg_duration.count(),
+                       show_path(c.output, build_root));
+        }
+    }
+}
+
+void print_tables(const database& db, path_ref build_root, std::size_t top) {
+    for (auto step : report_steps) {
+        auto timings = db.step_timings(step);
+        if (timings.empty()) {
+            continue;
+        }
+        fmt::print(std::cout, "\n.bold[Slowest {} steps] (by latest duration):\n"_styled, step);
+        fmt::print(std::cout,
+                   "  {:>10} {:>10} {:>7} {:>10} {:>10} {:>5}  {}\n",
+                   "Latest",
+                   "Previous",
+                   "Trend",
+                   "Average",
+                   "Slowest",
+                   "Runs",
+                   "Output");
+        for (auto& h : timings | std::views::take(top)) {
+            fmt::print(std::cout,
+                       "  {:>8L}ms {:>10} {:>7} {:>8L}ms {:>8L}ms {:>5}  {} [{}]\n",
+                       h.latest.count(),
+                       h.previous ? fmt::format("{:L}ms", h.previous->count()) : "-",
+                       show_trend(h.latest, h.previous),
+                       h.average.count(),
+                       h.slowest.count(),
+                       h.n_runs,
+                       show_path(h.output, build_root),
+                       h.owner);
+        }
+        if (step == "compile") {
+            fmt::print(std::cout, "\n.bold[Compile cost by library]:\n"_styled);
+            fmt::print(std::cout,
+                       "  {:>10} {:>7} {:>6}  {}\n",
+                       "Total",
+                       "Trend",
+                       "Files",
+                       "Library");
+            for (auto& lib : library_costs(timings) | std::views::take(top)) {
+                fmt::print(std::cout,
+                           "  {:>8L}ms {:>7} {:>6}  {}\n",
+                           lib.latest.count(),
+                           show_trend(lib.latest, lib.previous),
+                           lib.n_files,
+                           lib.name);
+            }
+        }
+    }
+
+    auto runs = db.run_totals();
+    if (runs.empty()) {
+        return;
+    }
+    fmt::print(std::cout, "\n.bold[Recent builds] (oldest first):\n"_styled);
+    fmt::print(std::cout, "  {:>6}", "Build");
+    for (auto step : report_steps) {
+        fmt::print(std::cout, " {:>18}", step);
+    }
+    fmt::print(std::cout, "\n");
+    for (auto& run : runs) {
+        fmt::print(std::cout, "  {:>6}", run.run_id);
+        for (auto step : report_steps) {
+            auto found = std::ranges::find(run.steps, step, &build_run_totals::step_total::step);
+            if (found == run.steps.end()) {
+                fmt::print(std::cout, " {:>18}", "-");
+            } else {
+                fmt::print(std::cout,
+                           " {:>18}",
+                           fmt::format("{:L}ms ({})", found->total.count(), found->count));
+            }
+        }
+        fmt::print(std::cout, "\n");
+    }
+}
+
+int _build_stats(const options& opts, path_ref build_root) {
+    auto db_path    = build_root / ".bpt.db";
+    if (!fs::is_regular_file(db_path)) {
+        bpt_log(error,
+                "There is no build database in [{}]. Run a build there first.",
+                build_root.string());
+        return 1;
+    }
+    auto db  = database::open_readonly(db_path);
+    auto top = static_cast<std::size_t>(std::max(opts.build_stats.top, 1));
+    if (opts.build_stats.json) {
+        print_json(db, build_root, top, opts.build_stats.headers);
+    } else {
+        print_tables(db, build_root, top);
+        if (opts.build_stats.headers) {
+            print_header_tables(db, build_root, top);
+        }
+    }
+    return 0;
+}
+
+}  // namespace
+
+int build_stats(const options& opts) {
+    if (opts.build_stats.json) {
+        // Keep the JSON on stdout free of log messages
+        log::redirect_to_stderr();
+    }
+    auto build_root = fs::weakly_canonical(opts.out_path.value_or(fs::current_path() / "_build"));
+    return bpt_leaf_try { return _build_stats(opts, build_root); }
+    bpt_leaf_catch(e_build_db_version version) {
+        bpt_log(error,
+                "The build database in [{}] was written by a different version of bpt (version "
+                "'{}'). Run a build there first.",
+                build_root.string(),
+                version.value);
+        return 1;
+    };
+}
+
+}  // namespace bpt::cli::cmd
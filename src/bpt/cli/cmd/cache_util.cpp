@@ -12,26 +12,54 @@
 #include <bpt/util/http/error.hpp>
 #include <bpt/util/http/pool.hpp>
 #include <bpt/util/log.hpp>
+#include <bpt/util/parallel.hpp>
+#include <bpt/util/signal.hpp>
 #include <bpt/util/url.hpp>
 
 #include <fansi/styled.hpp>
+#include <fmt/ostream.h>
 #include <neo/sqlite3/error.hpp>
 
+#include <algorithm>
+#include <optional>
+#include <vector>
+
 using namespace bpt;
 using namespace fansi::literals;
 
-static void
-use_repo(bpt::crs::cache_db& meta_db, const cli::options& opts, std::string_view url_or_path) {
-    // Convert what may be just a domain name or partial URL into a proper URL:
-    auto url = bpt::guess_url_from_string(url_or_path);
-    // Called by error handler to decide whether to rethrow:
+namespace {
+
+/// A repository that was requested with '--use-repo', or the default one
+struct used_repo {
+    neo::url url;
+    /// Whether we have metadata for this repository from a prior sync
+    bool have_cache;
+    /// The sync of this repository, until it fails or is finished
+    std::optional<crs::cache_db::pending_sync> sync = std::nullopt;
+    /// Set if an error means that we cannot continue
+    bool fatal = false;
+};
+
+/**
+ * @brief Invoke `fn` for one stage of syncing `repo`, and handle the errors that it may raise.
+ *
+ * This may be called from any thread. Instead of exiting, a fatal error is recorded in `repo`.
+ * Errors are reported here, as their information is not available from other threads.
+ *
+ * @return Whether the stage succeeded
+ */
+template <typename Func>
+bool sync_stage(used_repo& repo, const cli::options& opts, Func&& fn) {
+    const auto& url = repo.url;
+    // Called by error handler to decide whether we can carry on:
     auto check_cache_after_error = [&] {
+        repo.sync.reset();
         if (opts.repo_sync_mode == cli::repo_sync_mode::always) {
             // We should always sync package listings, so this is a hard error
-            bpt::throw_system_exit(1);
+            repo.fatal = true;
+            return false;
         }
-        auto rid = meta_db.get_remote(url);
-        if (rid.has_value()) {
+        if (repo.have_cache) {
             // We have prior metadata for the given repository.
             bpt_log(warn,
                     "We'll continue by using cached information for .bold.yellow[{}]"_styled,
@@ -41,19 +69,13 @@ use_repo(bpt::crs::cache_db& meta_db, const cli::options& opts, std::string_view
                 error,
                 "We have no cached metadata for .bold.red[{}], and were unable to obtain any."_styled,
                 url.to_string());
-            bpt::throw_system_exit(1);
+            repo.fatal = true;
         }
+        return false;
     };
-    bpt_leaf_try {
-        using m = cli::repo_sync_mode;
-        switch (opts.repo_sync_mode) {
-        case m::cached_okay:
-        case m::always:
-            meta_db.sync_remote(url);
-            return;
-        case m::never:
-            return;
-        }
+    return bpt_leaf_try {
+        fn();
+        return true;
     }
     bpt_leaf_catch(matchv<bpt::e_http_status{404}>,
                    bpt::crs::e_sync_remote sync_repo,
@@ -69,7 +91,7 @@ use_repo(bpt::crs::cache_db& meta_db, const cli::options& opts, std::string_view
                 "  (The missing resource URL is [.bold.yellow[{}]])"_styled,
                 req_url.to_string());
         write_error_marker("repo-sync-http-404");
-        check_cache_after_error();
+        return check_cache_after_error();
     }
     bpt_leaf_catch(catch_<bpt::http_error>,
                    neo::url                req_url,
@@ -87,7 +109,7 @@ use_repo(bpt::crs::cache_db& meta_db, const cli::options& opts, std::string_view
                 resp.status,
                 resp.status_message);
         write_error_marker("repo-sync-http-error");
-        check_cache_after_error();
+        return check_cache_after_error();
     }
     bpt_leaf_catch(catch_<neo::sqlite3::error> exc, bpt::crs::e_sync_remote sync_repo) {
         bpt_log(error,
@@ -97,28 +119,28 @@ use_repo(bpt::crs::cache_db& meta_db, const cli::options& opts, std::string_view
         bpt_log(error,
                 "It's possible that the downloaded SQLite database is corrupt, invalid, or "
                 "incompatible with this version of bpt");
-        check_cache_after_error();
+        return check_cache_after_error();
     }
     bpt_leaf_catch(bpt::crs::e_sync_remote sync_repo,
                    bpt::e_decompress_error err,
-                   bpt::e_read_file_path   read_file) {
+                   neo::url                db_url) {
         bpt_log(error,
                 "Error while sychronizing package data from .bold.yellow[{}]"_styled,
                 sync_repo.value.to_string());
         bpt_log(
             error,
             "Error decompressing remote repository database [.br.yellow[{}]]: .bold.red[{}]"_styled,
-            read_file.value.string(),
+            db_url.to_string(),
             err.value);
         write_error_marker("repo-sync-invalid-db-gz");
-        check_cache_after_error();
+        return check_cache_after_error();
     }
     bpt_leaf_catch(const std::system_error& e, neo::url e_url, http_response_info) {
         bpt_log(error,
                 "An error occurred while downloading [.bold.red[{}]]: {}"_styled,
                 e_url.to_string(),
                 e.code().message());
-        check_cache_after_error();
+        return check_cache_after_error();
     }
     bpt_leaf_catch(const std::system_error& e, network_origin origin, neo::url const* e_url) {
         bpt_log(error,
@@ -129,23 +151,99 @@ use_repo(bpt::crs::cache_db& meta_db, const cli::options& opts, std::string_view
                 e.code().message());
         if (e_url) {
             bpt_log(error, "  (While accessing URL [.bold.red[{}]])"_styled, e_url->to_string());
-            check_cache_after_error();
-        } else {
-            check_cache_after_error();
         }
+        return check_cache_after_error();
+    }
+    bpt_leaf_catch(bpt::user_cancelled)->noreturn_t { throw; }
+    bpt_leaf_catch_all {
+        bpt_log(error,
+                "Unexpected error while synchronizing package data from .bold.red[{}]: {}"_styled,
+                url.to_string(),
+                diagnostic_info);
+        repo.sync.reset();
+        repo.fatal = true;
+        return false;
     };
-    meta_db.enable_remote(url);
 }
 
-crs::cache cli::open_ready_cache(const cli::options& opts) {
+/**
+ * @brief Sync the given repositories, and then enable them in the order that they are given.
+ *
+ * The network requests for every repository are made at the same time. They do not touch the
+ * database, which is only used from this thread.
+ */
+void sync_and_enable(crs::cache_db&         meta_db,
+                     const cli::options&    opts,
+                     std::vector<used_repo> repos) {
+    if (opts.repo_sync_mode != cli::repo_sync_mode::never && !repos.empty()) {
+        for (auto& repo : repos) {
+            sync_stage(repo, opts, [&] { repo.sync = meta_db.begin_sync(repo.url); });
+        }
+        auto n_jobs  = static_cast<int>(repos.size());
+        auto all_ran = bpt::parallel_run(repos, n_jobs, [&](used_repo& repo) {
+            if (repo.sync) {
+                sync_stage(repo, opts, [&] { repo.sync->fetch(); });
+            }
+        });
+        bpt::cancellation_point();
+        if (!all_ran || std::ranges::any_of(repos, &used_repo::fatal)) {
+            bpt::throw_system_exit(1);
+        }
+        // Only one repository is imported at a time
+        for (auto& repo : repos) {
+            if (repo.sync) {
+                sync_stage(repo, opts, [&] { meta_db.finish_sync(std::move(*repo.sync)); });
+                if (repo.fatal) {
+                    bpt::throw_system_exit(1);
+                }
+            }
+        }
+    }
+
+    for (auto& repo : repos) {
+        // Some may already be enabled, but must move to keep the order in which they were given
+        meta_db.disable_remote(repo.url);
+        meta_db.enable_remote(repo.url);
+    }
+}
+
+}  // namespace
+
+crs::cache cli::open_ready_cache(const cli::options& opts, repo_sync_timing timing) {
     auto cache
         = bpt::crs::cache::open(opts.crs_cache_dir.value_or(bpt::crs::cache::default_path()));
     auto& meta_db = cache.db();
+
+    std::vector<used_repo> repos;
+    auto                   add_repo = [&](std::string_view url_or_path) {
+        // Convert what may be just a domain name or partial URL into a proper URL:
+        auto url = bpt::guess_url_from_string(url_or_path);
+        repos.push_back(used_repo{
+            .url        = url,
+            .have_cache = meta_db.get_remote(url).has_value(),
+        });
+    };
     for (auto& r : opts.use_repos) {
-        use_repo(meta_db, opts, r);
+        add_repo(r);
     }
     if (opts.use_default_repo) {
-        use_repo(meta_db, opts, "repo-2.dds.pizza");
+        add_repo("repo-2.dds.pizza");
+    }
+
+    if (timing == repo_sync_timing::immediately
+        || opts.repo_sync_mode == cli::repo_sync_mode::never) {
+        sync_and_enable(meta_db, opts, std::move(repos));
+        return cache;
+    }
+
+    // Make do with what we have cached until it is found to be lacking
+    for (auto& repo : repos) {
+        if (repo.have_cache) {
+            meta_db.enable_remote(repo.url);
+        }
     }
+    meta_db.defer_sync([&meta_db, &opts, repos = std::move(repos)]() mutable {
+        sync_and_enable(meta_db, opts, std::move(repos));
+    });
     return cache;
 }
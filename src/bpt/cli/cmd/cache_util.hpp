@@ -6,12 +6,24 @@ namespace bpt::cli {
 
 struct options;
 
+/// When the remote repositories requested by the user are synced
+enum class repo_sync_timing {
+    /// Before open_ready_cache() returns
+    immediately,
+    /// Once the cached metadata turns out to be lacking. @see crs::cache_db::defer_sync
+    when_needed,
+};
+
 /**
  * @brief Open a CRS cache in the appropriate directory, will all requested
  * remote repositories synced and enabled.
  *
  * @param opts The options given by the user.
+ * @param timing When to sync the remote repositories. If they are synced when needed, the
+ * repositories that we already have metadata for are enabled right away, and the rest are enabled
+ * once they are synced.
  */
-bpt::crs::cache open_ready_cache(const options& opts);
+bpt::crs::cache open_ready_cache(const options&   opts,
+                                 repo_sync_timing timing = repo_sync_timing::immediately);
 
 }  // namespace bpt::cli
@@ -25,6 +25,9 @@ int _compile_file(const options& opts) {
                                       .emit_lmi          = {},
                                       .tweaks_dir        = opts.build.tweaks_dir,
                                       .toolchain         = opts.load_toolchain(),
+                                      // Editors call this on every save. Leave the compilation
+                                      // database to full builds.
+                                      .generate_compdb   = false,
                                       .parallel_jobs     = opts.jobs,
                                   });
             return 0;
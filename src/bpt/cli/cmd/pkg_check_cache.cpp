@@ -0,0 +1,34 @@
+#include "../options.hpp"
+
+#include <bpt/crs/cache.hpp>
+#include <bpt/crs/cache_db.hpp>
+#include <bpt/error/marker.hpp>
+#include <bpt/util/log.hpp>
+
+#include <fansi/styled.hpp>
+
+using namespace fansi::literals;
+
+namespace bpt::cli::cmd {
+
+int pkg_check_cache(const options& opts) {
+    // Open the cache as-is. Syncing remotes here would only get in the way.
+    auto cache_dir = opts.crs_cache_dir.value_or(bpt::crs::cache::default_path());
+    auto cache     = bpt::crs::cache::open(cache_dir);
+    auto problems  = cache.db().check_integrity();
+    if (problems.empty()) {
+        bpt_log(info,
+                "The package cache in [{}] is .bold.green[intact]"_styled,
+                cache_dir.string());
+        return 0;
+    }
+    bpt_log(error, "The package cache in [{}] is .bold.red[damaged]:"_styled, cache_dir.string());
+    for (auto& problem : problems) {
+        bpt_log(error, "  {}", problem);
+    }
+    bpt_log(error, "Delete the cache directory to have it rebuilt from the package repositories.");
+    write_error_marker("pkg-cache-damaged");
+    return 1;
+}
+
+}  // namespace bpt::cli::cmd
@@ -8,14 +8,17 @@
 #include <bpt/crs/repo.hpp>
 #include <bpt/util/url.hpp>
 
+#include <neo/ranges.hpp>
+
+#include <ranges>
+
 namespace bpt::cli::cmd {
 
 int pkg_prefetch(const options& opts) {
     auto cache = open_ready_cache(opts);
-    for (auto& pkg_str : opts.pkg.prefetch.pkgs) {
-        auto pid = crs::pkg_id::parse(pkg_str);
-        cache.prefetch(pid);
-    }
+    auto pids
+        = opts.pkg.prefetch.pkgs | std::views::transform(&crs::pkg_id::parse) | neo::to_vector;
+    cache.prefetch_all(pids, {.n_jobs = opts.jobs});
     return 0;
 }
 
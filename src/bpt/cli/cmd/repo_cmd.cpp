@@ -22,6 +22,7 @@ command repo_import;
 command repo_ls;
 command repo_validate;
 command repo_remove;
+command repo_compact_log;
 
 int repo_cmd(const options& opts) {
     neo_assert(invariant, opts.subcommand == subcommand::repo, "Wrong subcommand for dispatch");
@@ -37,6 +38,8 @@ int repo_cmd(const options& opts) {
             return cmd::repo_validate(opts);
         case repo_subcommand::remove:
             return cmd::repo_remove(opts);
+        case repo_subcommand::compact_log:
+            return cmd::repo_compact_log(opts);
         case repo_subcommand::_none_:;
         }
         neo::unreachable();
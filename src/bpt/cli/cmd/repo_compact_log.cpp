@@ -0,0 +1,22 @@
+#include "../options.hpp"
+
+#include <bpt/crs/repo.hpp>
+#include <bpt/util/log.hpp>
+
+#include <fansi/styled.hpp>
+
+using namespace fansi::literals;
+
+namespace bpt::cli::cmd {
+
+int repo_compact_log(const options& opts) {
+    auto repo = bpt::crs::repository::open_existing(opts.repo.repo_dir);
+    repo.compact_log(opts.repo.compact_log.keep);
+    bpt_log(info,
+            "[{}]: Compacted the change log, which now ends at revision .bold.cyan[{}]"_styled,
+            repo.name(),
+            repo.revno());
+    return 0;
+}
+
+}  // namespace bpt::cli::cmd
@@ -15,12 +15,14 @@ using command = int(const options&);
 
 command build_deps;
 command build;
+command build_stats;
 command compile_file;
 command install_yourself;
 command pkg_create;
 command pkg_search;
 command pkg_prefetch;
 command pkg_solve;
+command pkg_check_cache;
 command repo_cmd;
 
 }  // namespace cmd
@@ -42,6 +44,8 @@ int dispatch_main(const options& opts) noexcept {
                 return cmd::pkg_prefetch(opts);
             case pkg_subcommand::solve:
                 return cmd::pkg_solve(opts);
+            case pkg_subcommand::check_cache:
+                return cmd::pkg_check_cache(opts);
             case pkg_subcommand::_none_:;
             }
             neo::unreachable();
@@ -54,6 +58,8 @@ int dispatch_main(const options& opts) noexcept {
             return cmd::compile_file(opts);
         case subcommand::build_deps:
             return cmd::build_deps(opts);
+        case subcommand::build_stats:
+            return cmd::build_stats(opts);
         case subcommand::install_yourself:
             return cmd::install_yourself(opts);
         case subcommand::_none_:;
@@ -130,7 +130,9 @@ struct setup {
           "occurs and \n  we have cached metadata for the failing repitory, ignore the error and "
           "continue.\n\n"
           "never:\n  Do not attempt to pull repository metadata. This option requires that there "
-          "be a local cache of the repository metadata.",
+          "be a local cache of the repository metadata.\n\n"
+          "When building, repositories are only pulled once the cached metadata is found to be\n"
+          "insufficient to resolve the project's dependencies.",
         .valname = "{always,cached-okay,never}",
         .action  = put_into(opts.repo_sync_mode),
     };
@@ -171,6 +173,10 @@ struct setup {
             .name = "build-deps",
             .help = "Build a set of dependencies and generate a libman index",
         }));
+        setup_build_stats_cmd(group.add_parser({
+            .name = "build-stats",
+            .help = "Show the slowest build steps and build time trends of a build directory",
+        }));
         setup_pkg_cmd(group.add_parser({
             .name = "pkg",
             .help = "Manage packages and package remotes",
@@ -214,6 +220,20 @@ struct setup {
             = "Path to a libman index file to use for loading project dependencies";
         build_cmd.add_argument(jobs_arg.dup());
         build_cmd.add_argument(tweaks_dir_arg.dup());
+        build_cmd.add_argument({
+            .long_spellings = {"progress"},
+            .help           = "Show a status line with the running compilations and an estimated "
+                              "time to completion. Only shown when the output is a terminal.",
+            .nargs          = 0,
+            .action         = debate::store_true(opts.build.progress),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"progress-json"},
+            .help           = "Append compilation progress and time estimates to the given file, "
+                              "as one JSON object per line",
+            .valname        = "<path>",
+            .action         = put_into(opts.build.progress_json),
+        });
     }
 
     void setup_compile_file_cmd(argument_parser& compile_file_cmd) noexcept {
@@ -265,6 +285,32 @@ struct setup {
         });
     }
 
+    void setup_build_stats_cmd(argument_parser& build_stats_cmd) noexcept {
+        build_stats_cmd.add_argument(out_arg.dup()).help
+            = "The build directory to inspect. Default is '_build' in the working directory";
+        build_stats_cmd.add_argument({
+            .long_spellings  = {"top"},
+            .short_spellings = {"n"},
+            .help            = "The number of entries to show in each list. Default is 10",
+            .valname         = "<count>",
+            .action          = put_into(opts.build_stats.top),
+        });
+        build_stats_cmd.add_argument({
+            .long_spellings = {"json"},
+            .help           = "Write the report to stdout as JSON instead of as tables",
+            .nargs          = 0,
+            .action         = store_true(opts.build_stats.json),
+        });
+        build_stats_cmd.add_argument({
+            .long_spellings = {"headers"},
+            .help = "Also show which headers cause the most recompilation when they are changed, "
+                    "and the total on-disk size of the files read by each compilation (not the "
+                    "size of the preprocessed source)",
+            .nargs  = 0,
+            .action = store_true(opts.build_stats.headers),
+        });
+    }
+
     void setup_pkg_cmd(argument_parser& pkg_cmd) {
         auto& pkg_group = pkg_cmd.add_subparsers({
             .valname = "<pkg-subcommand>",
@@ -290,6 +336,10 @@ struct setup {
             .name = "solve",
             .help = "Generate a dependency solution for the given requirements",
         }));
+        pkg_group.add_parser({
+            .name = "check-cache",
+            .help = "Check the integrity of the local package listing cache",
+        });
     }
 
     void setup_pkg_create_cmd(argument_parser& pkg_create_cmd) {
@@ -317,6 +367,8 @@ struct setup {
 
     void setup_pkg_prefetch_cmd(argument_parser& pkg_prefetch_cmd) noexcept {
         add_repo_args(pkg_prefetch_cmd);
+        pkg_prefetch_cmd.add_argument(jobs_arg.dup()).help
+            = "Set the maximum number of packages to download and expand at once";
         pkg_prefetch_cmd.add_argument({
             .help       = "List of package IDs to prefetch",
             .valname    = "<pkg-id>",
@@ -363,6 +415,10 @@ struct setup {
             .help = "Check that all repository packages are valid and resolvable",
         });
         validate_cmd.add_argument(repo_repo_dir_arg.dup());
+        setup_repo_compact_log_cmd(grp.add_parser({
+            .name = "compact-log",
+            .help = "Drop old entries from the change log of a CRS repository",
+        }));
     }
 
     void setup_repo_import_cmd(argument_parser& repo_import_cmd) {
@@ -401,6 +457,16 @@ struct setup {
         });
     }
 
+    void setup_repo_compact_log_cmd(argument_parser& repo_compact_log_cmd) {
+        repo_compact_log_cmd.add_argument(repo_repo_dir_arg.dup());
+        repo_compact_log_cmd.add_argument({
+            .long_spellings = {"keep"},
+            .help           = "The number of the newest change log entries to keep. Default is 100",
+            .valname        = "<count>",
+            .action         = put_into(opts.repo.compact_log.keep),
+        });
+    }
+
     void setup_install_yourself_cmd(argument_parser& install_yourself_cmd) {
         install_yourself_cmd.add_argument({
             .long_spellings = {"where"},
@@ -23,6 +23,7 @@ enum class subcommand {
     build,
     compile_file,
     build_deps,
+    build_stats,
     pkg,
     repo,
     install_yourself,
@@ -37,6 +38,7 @@ enum class pkg_subcommand {
     search,
     prefetch,
     solve,
+    check_cache,
 };
 
 /**
@@ -61,6 +63,7 @@ enum class repo_subcommand {
     remove,
     validate,
     ls,
+    compact_log,
 };
 
 /**
@@ -114,7 +117,7 @@ struct options {
 
     // Compile and build commands with `--no-warnings`/`--no-warn`
     bool disable_warnings = false;
-    // Compile and build commands' `--jobs` parameter
+    // Compile, build, and prefetch commands' `--jobs` parameter
     int jobs = 0;
     // Compile and build commands' `--toolchain` option:
     opt_string toolchain;
@@ -139,6 +142,10 @@ struct options {
         bool     want_apps  = true;
         opt_path lm_index;
         opt_path tweaks_dir;
+        /// Whether to show a live status line with `--progress`
+        bool progress = false;
+        /// Where to write progress estimates with `--progress-json`
+        opt_path progress_json;
     } build;
 
     /**
@@ -161,6 +168,18 @@ struct options {
         opt_path cmake_file;
     } build_deps;
 
+    /**
+     * @brief Parameters specific to 'bpt build-stats'
+     */
+    struct {
+        /// The number of entries to show in each list
+        int top = 10;
+        /// Emit JSON instead of tables
+        bool json = false;
+        /// Include the header rebuild impact and the on-disk input size of each compilation
+        bool headers = false;
+    } build_stats;
+
     /**
      * @brief Parameters and subcommands for 'bpt pkg'
      *
@@ -221,6 +240,12 @@ struct options {
             /// Package IDs of packages to remove
             std::vector<string> pkgs;
         } remove;
+
+        /// Options for 'bpt repo compact-log'
+        struct {
+            /// The number of the newest change log entries to keep
+            int keep = 100;
+        } compact_log;
     } repo;
 
     struct {
@@ -1,29 +1,133 @@
 #include "./compdb.hpp"
 
 #include <bpt/build/iter_compilations.hpp>
+#include <bpt/error/exit.hpp>
+#include <bpt/error/try_catch.hpp>
 #include <bpt/util/fs/io.hpp>
-#include <bpt/util/proc.hpp>
+#include <bpt/util/log.hpp>
+#include <bpt/util/parallel.hpp>
+#include <bpt/util/signal.hpp>
 
-#include <fstream>
+#include <fansi/styled.hpp>
+#include <fmt/ostream.h>
 #include <nlohmann/json.hpp>
+#include <range/v3/range/conversion.hpp>
+#include <range/v3/view/iota.hpp>
+#include <range/v3/view/transform.hpp>
+
+#include <fstream>
+#include <functional>
 
 using namespace bpt;
+using namespace fansi::literals;
+
+namespace {
+
+/// Append the given string to the output as a JSON string literal
+void append_json_string(std::string& out, std::string_view str) {
+    out.append(nlohmann::json(str).dump());
+}
+
+/**
+ * Render a single entry of the compilation database. The output is identical to the entry as it
+ * would appear in `nlohmann::json::dump(2)` of the full array, with keys in sorted order.
+ */
+std::string render_entry(const compdb_entry& entry) {
+    std::string out   = "  {\n    \"arguments\": [";
+    bool        first = true;
+    for (auto& arg : entry.arguments) {
+        out.append(first ? "\n      " : ",\n      ");
+        append_json_string(out, arg);
+        first = false;
+    }
+    out.append(first ? "],\n" : "\n    ],\n");
+    out.append("    \"directory\": ");
+    append_json_string(out, entry.directory);
+    out.append(",\n    \"file\": ");
+    append_json_string(out, entry.file);
+    out.append("\n  }");
+    return out;
+}
+
+/// Join rendered entries into a JSON array
+std::string join_entries(const std::vector<std::string>& entries) {
+    if (entries.empty()) {
+        return "[]";
+    }
+    std::string content = "[\n";
+    for (auto& entry : entries) {
+        if (&entry != &entries.front()) {
+            content.append(",\n");
+        }
+        content.append(entry);
+    }
+    content.append("\n]");
+    return content;
+}
 
-void bpt::generate_compdb(const build_plan& plan, build_env_ref env) {
-    auto compdb = nlohmann::json::array();
+}  // namespace
 
+std::string bpt::render_compdb(const std::vector<compdb_entry>& entries) {
+    return join_entries(entries | ranges::views::transform(render_entry) | ranges::to_vector);
+}
+
+void bpt::generate_compdb(const build_plan& plan, build_env_ref env, int njobs) {
+    std::vector<std::reference_wrapper<const compile_file_plan>> compilations;
     for (const compile_file_plan& cf : iter_compilations(plan)) {
-        auto cmd_info = cf.generate_compile_command(env);
-        auto entry    = nlohmann::json::object({
-            {"directory", env.output_root.string()},
-            {"arguments", cmd_info.command},
-            {"file", cf.source_path().string()},
-        });
-        compdb.push_back(std::move(entry));
+        compilations.emplace_back(cf);
+    }
+
+    // Each entry is rendered independently, so they are generated in parallel and then joined
+    // in plan order.
+    std::vector<std::string> entries(compilations.size());
+
+    auto indices = ranges::views::iota(std::size_t(0), compilations.size()) | ranges::to_vector;
+
+    auto all_rendered = parallel_run(indices, njobs, [&](std::size_t idx) {
+        const compile_file_plan& cf = compilations[idx];
+        // The error information of a failure is only available on the thread that raised it, so
+        // it is reported here. Rethrowing lets parallel_run stop handing out more entries.
+        bpt_leaf_try {
+            compdb_entry entry{
+                .arguments = cf.generate_compile_command(env).command,
+                .directory = env.output_root.string(),
+                .file      = cf.source_path().string(),
+            };
+            entries[idx] = render_entry(entry);
+        }
+        bpt_leaf_catch(bpt::user_cancelled) { throw; }
+        bpt_leaf_catch_all {
+            bpt_log(error,
+                    "Failed to generate the compilation database entry of [.br.yellow[{}]]: {}"_styled,
+                    cf.source_path().string(),
+                    diagnostic_info);
+            throw;
+        };
+    });
+    cancellation_point();
+    if (!all_rendered) {
+        throw_system_exit(1);
     }
 
+    auto content = join_entries(entries);
+
+    // Rewriting an unchanged database would update its mtime, causing tools to re-index
     fs::create_directories(env.output_root);
-    auto compdb_file = env.output_root / "compile_commands.json";
-    auto ostream     = bpt::open_file(compdb_file, std::ios::binary | std::ios::out);
-    ostream << compdb.dump(2);
-}
\ No newline at end of file
+    auto            compdb_file = env.output_root / "compile_commands.json";
+    std::error_code ec;
+    // Only a database of the same size can be unchanged, so most changes are seen without reading
+    if (fs::is_regular_file(compdb_file, ec) && fs::file_size(compdb_file, ec) == content.size()
+        && bpt::read_file(compdb_file) == content) {
+        bpt_log(debug, "Compilation database [{}] is unchanged", compdb_file.string());
+        return;
+    }
+
+    // Write to a temporary file and rename it into place, so that readers never see a partially
+    // written database.
+    auto tmp_file = fs::path(compdb_file) += ".tmp";
+    {
+        auto ostream = bpt::open_file(tmp_file, std::ios::binary | std::ios::out);
+        ostream << content;
+    }
+    fs::rename(tmp_file, compdb_file);
+}
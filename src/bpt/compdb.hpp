@@ -2,8 +2,36 @@
 
 #include <bpt/build/plan/full.hpp>
 
+#include <string>
+#include <vector>
+
 namespace bpt {
 
-void generate_compdb(const build_plan&, build_env_ref);
+/**
+ * @brief A single entry of a compilation database
+ */
+struct compdb_entry {
+    /// The command that compiles the file
+    std::vector<std::string> arguments;
+    /// The working directory of the command
+    std::string directory;
+    /// The source file that is compiled
+    std::string file;
+};
+
+/**
+ * @brief Render the given entries as the content of a compilation database.
+ *
+ * The output is identical to `nlohmann::json::dump(2)` of the equivalent JSON array.
+ */
+std::string render_compdb(const std::vector<compdb_entry>& entries);
+
+/**
+ * @brief Write `compile_commands.json` for the given plan into the output root of the build.
+ *
+ * Entries are generated using up to `njobs` threads. The file is only rewritten if its content
+ * would change, so that tools watching it do not needlessly reload it.
+ */
+void generate_compdb(const build_plan&, build_env_ref, int njobs);
 
 }  // namespace bpt
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "./compdb.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+std::string dump_compdb(const std::vector<bpt::compdb_entry>& entries) {
+    auto arr = nlohmann::json::array();
+    for (auto& entry : entries) {
+        arr.push_back({
+            {"arguments", entry.arguments},
+            {"directory", entry.directory},
+            {"file", entry.file},
+        });
+    }
+    return arr.dump(2);
+}
+
+}  // namespace
+
+TEST_CASE("Render an empty compilation database") {
+    CHECK(bpt::render_compdb({}) == dump_compdb({}));
+}
+
+TEST_CASE("Render a compilation database") {
+    std::vector<bpt::compdb_entry> entries = {
+        {
+            .arguments = {"c++", "-I", "/src/include", "-c", "/src/a.cpp", "-o", "a.o"},
+            .directory = "/build",
+            .file      = "/src/a.cpp",
+        },
+        {
+            // No arguments at all
+            .arguments = {},
+            .directory = "/build",
+            .file      = "/src/b.cpp",
+        },
+        {
+            // Paths that need to be escaped
+            .arguments = {"cl.exe", R"(/IC:\Program Files\"quoted"\include)", "-DTAB=\t", "\x01"},
+            .directory = R"(C:\build dir)",
+            .file      = "/src/spaced name/ünïcode\n.cpp",
+        },
+    };
+    auto rendered = bpt::render_compdb(entries);
+    CHECK(rendered == dump_compdb(entries));
+    CHECK(nlohmann::json::parse(rendered)[2]["directory"] == R"(C:\build dir)");
+}
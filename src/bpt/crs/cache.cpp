@@ -2,15 +2,29 @@
 
 #include "./cache_db.hpp"
 #include "./remote.hpp"
+#include <bpt/error/exit.hpp>
 #include <bpt/error/result.hpp>
+#include <bpt/error/try_catch.hpp>
 #include <bpt/util/fs/dirscan.hpp>
+#include <bpt/util/http/error.hpp>
+#include <bpt/util/http/pool.hpp>
+#include <bpt/util/http/response.hpp>
 #include <bpt/util/log.hpp>
+#include <bpt/util/output.hpp>
+#include <bpt/util/parallel.hpp>
 #include <bpt/util/paths.hpp>
+#include <bpt/util/signal.hpp>
 
 #include <boost/leaf/exception.hpp>
 #include <fansi/styled.hpp>
+#include <fmt/ostream.h>
 
 #include <neo/memory.hpp>
+#include <neo/scope.hpp>
+
+#include <algorithm>
+#include <mutex>
+#include <optional>
 
 using namespace bpt;
 using namespace bpt::crs;
@@ -39,28 +53,169 @@ cache::cache(path_ref dirpath)
 
 cache_db& cache::db() noexcept { return _impl->metadata_db; }
 
-fs::path cache::prefetch(const pkg_id& pid_) {
-    auto pid     = pid_;
-    auto entries = db().for_package(pid.name, pid.version);
-    auto it      = entries.begin();
-    if (it == entries.end()) {
+namespace {
+
+/// A package that has been looked up in the metadata database
+struct resolved_package {
+    pkg_id   pid;
+    fs::path pkg_dir;
+    neo::url remote_url;
+};
+
+resolved_package resolve_package(const cache_db& db, path_ref root_dir, const pkg_id& pid_) {
+    auto pid = pid_;
+    db.sync_name(pid.name);
+    auto find_entry = [&]() -> std::optional<cache_db::package_entry> {
+        auto entries = db.for_package(pid.name, pid.version);
+        auto it      = entries.begin();
+        if (it == entries.end()) {
+            return std::nullopt;
+        }
+        return *it;
+    };
+    auto entry = find_entry();
+    if (!entry && db.sync_deferred()) {
+        // The cached metadata may just be out-of-date
+        entry = find_entry();
+    }
+    if (!entry) {
         BOOST_LEAF_THROW_EXCEPTION(e_no_such_pkg{pid});
     }
-    auto remote = db().get_remote_by_id(it->remote_id);
+    auto remote = db.get_remote_by_id(entry->remote_id);
     if (pid.revision == 0) {
-        pid.revision = it->pkg.id.revision;
-    }
-    auto pkg_dir = _impl->root_dir / "pkgs" / pid.to_string();
-    if (fs::exists(pkg_dir)) {
-        return pkg_dir;
+        pid.revision = entry->pkg.id.revision;
     }
     neo_assert(invariant,
                remote.has_value(),
                "Unable to get the remote of a just-obtained package entry",
                pid.to_string());
-    bpt_log(info, "Fetching package .br.cyan[{}]"_styled, pid.to_string());
-    crs::pull_pkg_from_remote(pkg_dir, remote->url, pid);
-    return pkg_dir;
+    auto pkg_dir = root_dir / "pkgs" / pid.to_string();
+    return resolved_package{pid, pkg_dir, remote->url};
+}
+
+/**
+ * @brief Download and expand the given package.
+ *
+ * This runs on a worker thread, which is the only place where the error information of a failure
+ * is available, so failures are reported here before they are rethrown.
+ */
+void pull_package_reporting_errors(const resolved_package& pkg) {
+    bpt_leaf_try { crs::pull_pkg_from_remote(pkg.pkg_dir, pkg.remote_url, pkg.pid); }
+    bpt_leaf_catch(bpt::user_cancelled) { throw; }
+    bpt_leaf_catch(catch_<bpt::http_error>, neo::url req_url, bpt::http_response_info resp) {
+        bpt_log(error,
+                "Failed to fetch package .br.yellow[{}]: HTTP .br.red[{} {}] from [.bold.yellow[{}]]"_styled,
+                pkg.pid.to_string(),
+                resp.status,
+                resp.status_message,
+                req_url.to_string());
+        throw;
+    }
+    bpt_leaf_catch(const std::system_error& e, neo::url req_url, bpt::http_response_info) {
+        bpt_log(error,
+                "An error occurred while downloading package .br.yellow[{}] from [.bold.red[{}]]: {}"_styled,
+                pkg.pid.to_string(),
+                req_url.to_string(),
+                e.code().message());
+        throw;
+    }
+    bpt_leaf_catch(const std::system_error& e, network_origin origin, neo::url const* req_url) {
+        bpt_log(error,
+                "Network error communicating with .bold.red[{}://{}:{}] while fetching package .br.yellow[{}]: {}"_styled,
+                origin.protocol,
+                origin.hostname,
+                origin.port,
+                pkg.pid.to_string(),
+                e.code().message());
+        if (req_url) {
+            bpt_log(error, "  (While accessing URL [.bold.red[{}]])"_styled, req_url->to_string());
+        }
+        throw;
+    }
+    bpt_leaf_catch_all {
+        bpt_log(error,
+                "Failed to fetch package .br.yellow[{}]: {}"_styled,
+                pkg.pid.to_string(),
+                diagnostic_info);
+        throw;
+    };
+}
+
+}  // namespace
+
+fs::path cache::prefetch(const pkg_id& pid) {
+    auto pkg = resolve_package(db(), _impl->root_dir, pid);
+    if (fs::exists(pkg.pkg_dir)) {
+        return pkg.pkg_dir;
+    }
+    bpt_log(info, "Fetching package .br.cyan[{}]"_styled, pkg.pid.to_string());
+    crs::pull_pkg_from_remote(pkg.pkg_dir, pkg.remote_url, pkg.pid);
+    return pkg.pkg_dir;
+}
+
+std::vector<fs::path> cache::prefetch_all(const std::vector<pkg_id>& pkgs,
+                                          const prefetch_options&    opts) {
+    // The metadata database is only used from this thread. Look up every package first.
+    std::vector<fs::path>         ret;
+    std::vector<resolved_package> missing;
+    for (auto& pid : pkgs) {
+        auto pkg = resolve_package(db(), _impl->root_dir, pid);
+        ret.push_back(pkg.pkg_dir);
+        auto already_queued
+            = std::ranges::find(missing, pkg.pkg_dir, &resolved_package::pkg_dir) != missing.end();
+        if (!already_queued && !fs::exists(pkg.pkg_dir)) {
+            missing.push_back(std::move(pkg));
+        }
+    }
+    if (missing.empty()) {
+        return ret;
+    }
+
+    bpt_log(info, "Fetching {} package(s)", missing.size());
+    const bool live_status = stdout_is_a_tty();
+
+    std::mutex  mut;
+    std::size_t n_done    = 0;
+    std::size_t n_running = 0;
+
+    auto update_status = [&] {
+        if (live_status) {
+            log::set_status(fmt::format("Fetching packages: {}/{} done, {} downloading",
+                                        n_done,
+                                        missing.size(),
+                                        n_running));
+        }
+    };
+    neo_defer {
+        if (live_status) {
+            log::set_status("");
+        }
+    };
+
+    // A failure reaches parallel_run, which then stops handing out more packages. The HTTP pool
+    // bounds how many of the downloads use the same server at once.
+    auto all_fetched = parallel_run(missing, opts.n_jobs, [&](const resolved_package& pkg) {
+        {
+            std::scoped_lock lk{mut};
+            ++n_running;
+            update_status();
+        }
+        neo_defer {
+            std::scoped_lock lk{mut};
+            --n_running;
+            update_status();
+        };
+        bpt_log(info, "Fetching package .br.cyan[{}]"_styled, pkg.pid.to_string());
+        pull_package_reporting_errors(pkg);
+        std::scoped_lock lk{mut};
+        ++n_done;
+        bpt_log(debug, "Fetched package {} [{}/{}]", pkg.pid.to_string(), n_done, missing.size());
+    });
+    cancellation_point();
+    if (!all_fetched) {
+        throw_system_exit(1);
+    }
+    return ret;
 }
 
 fs::path cache::default_path() noexcept { return bpt::bpt_cache_dir() / "crs"; }
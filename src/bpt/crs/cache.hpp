@@ -2,12 +2,21 @@
 
 #include <filesystem>
 #include <memory>
+#include <vector>
 
 namespace bpt::crs {
 
 class cache_db;
 struct pkg_id;
 
+/**
+ * @brief Controls how @ref cache::prefetch_all downloads packages
+ */
+struct prefetch_options {
+    /// The number of packages to fetch at once. If less than one, based on the number of CPUs.
+    int n_jobs = 0;
+};
+
 /**
  * @brief Implements a cache of CRS source distributions along with a cache of CRS metadata from
  * some number of repositories.
@@ -54,6 +63,23 @@ public:
      * of the package.
      */
     std::filesystem::path prefetch(const pkg_id&);
+
+    /**
+     * @brief Ensure that each of the given packages has a locally cached copy of its source
+     * distribution.
+     *
+     * Packages that are not yet cached are downloaded and expanded concurrently. Downloads from
+     * any one remote share the connections of the global @ref http_pool, which bounds how many are
+     * in flight at a time. Progress is reported as each package completes.
+     *
+     * @returns The directory of each of the given packages, in the same order.
+     *
+     * @throws std::exception under the same conditions as @ref prefetch. A package that fails to
+     * be fetched is reported as it fails, and no further downloads are started. Once the
+     * in-progress fetches finish, the process exits with an error.
+     */
+    std::vector<std::filesystem::path> prefetch_all(const std::vector<pkg_id>& pkgs,
+                                                    const prefetch_options&    opts = {});
 };
 
 }  // namespace bpt::crs
@@ -10,9 +10,13 @@
 #include <bpt/util/compress.hpp>
 #include <bpt/util/db/migrate.hpp>
 #include <bpt/util/db/query.hpp>
+#include <bpt/util/fs/io.hpp>
 #include <bpt/util/fs/path.hpp>
+#include <bpt/util/http/error.hpp>
 #include <bpt/util/http/pool.hpp>
 #include <bpt/util/http/response.hpp>
+#include <bpt/util/json5/error.hpp>
+#include <bpt/util/json5/parse.hpp>
 #include <bpt/util/log.hpp>
 #include <bpt/util/string.hpp>
 #include <bpt/util/url.hpp>
@@ -21,17 +25,24 @@
 #include <fansi/styled.hpp>
 #include <neo/any_range.hpp>
 #include <neo/assert.hpp>
-#include <neo/co_resource.hpp>
 #include <neo/memory.hpp>
 #include <neo/opt_ref.hpp>
 #include <neo/ranges.hpp>
 #include <neo/scope.hpp>
 #include <neo/sqlite3/connection.hpp>
+#include <neo/sqlite3/error.hpp>
 #include <neo/sqlite3/exec.hpp>
 #include <neo/sqlite3/transaction.hpp>
 #include <neo/tl.hpp>
+#include <neo/ufmt.hpp>
+#include <nlohmann/json.hpp>
+#include <sqlite3.h>
 
 #include <charconv>
+#include <cstring>
+#include <iterator>
+#include <system_error>
+#include <utility>
 
 using namespace bpt;
 using namespace bpt::crs;
@@ -44,99 +55,155 @@ namespace chrono = std::chrono;
 using chrono::steady_clock;
 using steady_time_point = steady_clock::time_point;
 
+// Loading a database from memory is always available since SQLite 3.36, and optional before that
+#if SQLITE_VERSION_NUMBER >= 3036000 || defined(SQLITE_ENABLE_DESERIALIZE)
+#define BPT_SQLITE_HAS_DESERIALIZE 1
+#else
+#define BPT_SQLITE_HAS_DESERIALIZE 0
+#endif
+
 neo::sqlite3::statement& cache_db::_prepare(neo::sqlite3::sql_string_literal sql) const {
     return _db.get().prepare(sql);
 }
 
 cache_db cache_db::open(unique_database& db) {
-    bpt::apply_db_migrations(db, "bpt_crs_meta", [](auto& db) {
-        db.exec_script(R"(
-            CREATE TABLE bpt_crs_remotes (
-                remote_id INTEGER PRIMARY KEY,
-                url TEXT NOT NULL,
-                unique_name TEXT NOT NULL UNIQUE,
-                revno INTEGER NOT NULL,
-                -- HTTP Etag header
-                etag TEXT,
-                -- HTTP Last-Modified header
-                last_modified TEXT,
-                -- System time of the most recent DB update
-                resource_time INTEGER,
-                -- Content of the prior Cache-Control header for HTTP remotes
-                cache_control TEXT
-            );
-
-            CREATE TABLE bpt_crs_packages (
-                pkg_id INTEGER PRIMARY KEY,
-                json TEXT NOT NULL,
-                remote_id INTEGER NOT NULL
-                    REFERENCES bpt_crs_remotes
-                    ON DELETE CASCADE,
-                remote_revno INTEGER NOT NULL,
-                name TEXT NOT NULL
-                    GENERATED ALWAYS
-                    AS (json_extract(json, '$.name'))
-                    STORED,
-                version TEXT NOT NULL
-                    GENERATED ALWAYS
-                    AS (json_extract(json, '$.version'))
-                    STORED,
-                pkg_version INTEGER NOT NULL
-                    GENERATED ALWAYS
-                    AS (json_extract(json, '$.pkg-version'))
-                    STORED,
-                UNIQUE (name, version, pkg_version, remote_id)
-            );
-
-            CREATE TABLE bpt_crs_libraries (
-                lib_id INTEGER PRIMARY KEY,
-                pkg_id INTEGER NOT NULL
-                    REFERENCES bpt_crs_packages
-                    ON DELETE CASCADE,
-                name TEXT NOT NULL,
-                path TEXT NOT NULL,
-                UNIQUE (pkg_id, name)
-            );
-
-            CREATE TRIGGER bpt_crs_libraries_auto_insert
-                AFTER INSERT ON bpt_crs_packages
-                FOR EACH ROW
-                BEGIN
-                    INSERT INTO bpt_crs_libraries (pkg_id, name, path)
-                        WITH libraries AS (
-                            SELECT value FROM json_each(new.json, '$.libraries')
-                        )
-                        SELECT
-                            new.pkg_id,
-                            json_extract(lib.value, '$.name'),
-                            json_extract(lib.value, '$.path')
-                        FROM libraries AS lib;
-                END;
-
-            CREATE TRIGGER bpt_crs_libraries_auto_update
-                AFTER UPDATE ON bpt_crs_packages
-                FOR EACH ROW WHEN new.json != old.json
-                BEGIN
-                    DELETE FROM bpt_crs_libraries
-                        WHERE pkg_id = new.pkg_id;
-                    INSERT INTO bpt_crs_libraries (pkg_id, name, path)
-                        WITH libraries AS (
-                            SELECT value FROM json_each(new.json, '$.libraries')
-                        )
-                        SELECT
-                            new.pkg_id,
-                            json_extract(lib.value, '$.name'),
-                            json_extract(lib.value, '$.path')
-                        FROM libraries AS lib;
-                END;
-        )"_sql);
-    }).value();
+    bpt::apply_db_migrations(  //
+        db,
+        "bpt_crs_meta",
+        [](auto& db) {  //
+            db.exec_script(R"(
+                CREATE TABLE bpt_crs_remotes (
+                    remote_id INTEGER PRIMARY KEY,
+                    url TEXT NOT NULL,
+                    unique_name TEXT NOT NULL UNIQUE,
+                    revno INTEGER NOT NULL,
+                    -- HTTP Etag header
+                    etag TEXT,
+                    -- HTTP Last-Modified header
+                    last_modified TEXT,
+                    -- System time of the most recent DB update
+                    resource_time INTEGER,
+                    -- Content of the prior Cache-Control header for HTTP remotes
+                    cache_control TEXT
+                );
+
+                CREATE TABLE bpt_crs_packages (
+                    pkg_id INTEGER PRIMARY KEY,
+                    json TEXT NOT NULL,
+                    remote_id INTEGER NOT NULL
+                        REFERENCES bpt_crs_remotes
+                        ON DELETE CASCADE,
+                    remote_revno INTEGER NOT NULL,
+                    name TEXT NOT NULL
+                        GENERATED ALWAYS
+                        AS (json_extract(json, '$.name'))
+                        STORED,
+                    version TEXT NOT NULL
+                        GENERATED ALWAYS
+                        AS (json_extract(json, '$.version'))
+                        STORED,
+                    pkg_version INTEGER NOT NULL
+                        GENERATED ALWAYS
+                        AS (json_extract(json, '$.pkg-version'))
+                        STORED,
+                    UNIQUE (name, version, pkg_version, remote_id)
+                );
+
+                CREATE TABLE bpt_crs_libraries (
+                    lib_id INTEGER PRIMARY KEY,
+                    pkg_id INTEGER NOT NULL
+                        REFERENCES bpt_crs_packages
+                        ON DELETE CASCADE,
+                    name TEXT NOT NULL,
+                    path TEXT NOT NULL,
+                    UNIQUE (pkg_id, name)
+                );
+
+                CREATE TRIGGER bpt_crs_libraries_auto_insert
+                    AFTER INSERT ON bpt_crs_packages
+                    FOR EACH ROW
+                    BEGIN
+                        INSERT INTO bpt_crs_libraries (pkg_id, name, path)
+                            WITH libraries AS (
+                                SELECT value FROM json_each(new.json, '$.libraries')
+                            )
+                            SELECT
+                                new.pkg_id,
+                                json_extract(lib.value, '$.name'),
+                                json_extract(lib.value, '$.path')
+                            FROM libraries AS lib;
+                    END;
+
+                CREATE TRIGGER bpt_crs_libraries_auto_update
+                    AFTER UPDATE ON bpt_crs_packages
+                    FOR EACH ROW WHEN new.json != old.json
+                    BEGIN
+                        DELETE FROM bpt_crs_libraries
+                            WHERE pkg_id = new.pkg_id;
+                        INSERT INTO bpt_crs_libraries (pkg_id, name, path)
+                            WITH libraries AS (
+                                SELECT value FROM json_each(new.json, '$.libraries')
+                            )
+                            SELECT
+                                new.pkg_id,
+                                json_extract(lib.value, '$.name'),
+                                json_extract(lib.value, '$.path')
+                            FROM libraries AS lib;
+                    END;
+            )"_sql);
+        },
+        [](auto& db) {  //
+            db.exec_script(R"(
+                -- The revision of the remote's change log that our packages correspond to, or
+                -- NULL if the remote does not keep a change log
+                ALTER TABLE bpt_crs_remotes ADD COLUMN log_revno INTEGER;
+            )"_sql);
+        },
+        [](auto& db) {  //
+            db.exec_script(R"(
+                -- Whether the remote is read through its sparse index, one package name at a time
+                ALTER TABLE bpt_crs_remotes ADD COLUMN sparse INTEGER NOT NULL DEFAULT 0;
+
+                -- The HTTP caching state of each file that we have fetched from a sparse index
+                CREATE TABLE bpt_crs_sparse_files (
+                    remote_id INTEGER NOT NULL
+                        REFERENCES bpt_crs_remotes
+                        ON DELETE CASCADE,
+                    name TEXT NOT NULL,
+                    etag TEXT,
+                    last_modified TEXT,
+                    resource_time INTEGER,
+                    cache_control TEXT,
+                    UNIQUE (remote_id, name)
+                );
+            )"_sql);
+        },
+        [](auto& db) {  //
+            db.exec_script(R"(
+                -- The package's JSON exactly as the remote's database holds it. When it is
+                -- unchanged, a sync does not need to validate the package again.
+                ALTER TABLE bpt_crs_packages ADD COLUMN remote_json TEXT;
+            )"_sql);
+        })
+        .value();
     db.exec_script(R"(
         CREATE TEMPORARY TABLE IF NOT EXISTS bpt_crs_enabled_remotes (
             enablement_id INTEGER PRIMARY KEY,
             remote_id INTEGER NOT NULL -- references main.bpt_crs_remotes
                 UNIQUE ON CONFLICT IGNORE
         );
+        -- The names that have been checked in the sparse index of each remote in this session
+        CREATE TEMPORARY TABLE IF NOT EXISTS bpt_crs_sparse_checked (
+            remote_id INTEGER NOT NULL,
+            name TEXT NOT NULL,
+            UNIQUE (remote_id, name) ON CONFLICT IGNORE
+        );
+        -- Staging area for the packages of a remote that is being synced
+        CREATE TEMPORARY TABLE IF NOT EXISTS bpt_crs_import (
+            remote_json TEXT NOT NULL,
+            -- The validated JSON, or NULL if the package is new or has changed
+            json TEXT
+        );
         CREATE TEMPORARY VIEW IF NOT EXISTS enabled_packages AS
             SELECT * FROM bpt_crs_packages
             JOIN bpt_crs_enabled_remotes USING (remote_id)
@@ -153,6 +220,25 @@ static cache_db::package_entry pkg_entry_from_row(auto&& row) noexcept {
                                    .pkg        = std::move(meta)};
 }
 
+namespace {
+
+/**
+ * @brief Split the "sparse+" prefix from the scheme of a remote URL.
+ *
+ * A remote that is given as e.g. "sparse+https://example.com/repo" is read through the sparse
+ * index of the repository at "https://example.com/repo".
+ */
+std::pair<neo::url, bool> split_sparse_url(neo::url_view url_) {
+    auto url = url_.normalized();
+    if (!url.scheme.starts_with("sparse+")) {
+        return {std::move(url), false};
+    }
+    url.scheme = url.scheme.substr(std::strlen("sparse+"));
+    return {url.normalized(), true};
+}
+
+}  // namespace
+
 void cache_db::forget_all() { db_exec(_prepare("DELETE FROM bpt_crs_remotes"_sql)).value(); }
 
 namespace {
@@ -213,7 +299,7 @@ neo::any_input_range<cache_db::package_entry> cache_db::all_enabled() const {
 
 optional<cache_db::remote_entry> cache_db::get_remote(neo::url_view const& url_) const {
     return bpt_leaf_try->optional<cache_db::remote_entry> {
-        auto url = url_.normalized();
+        auto url = split_sparse_url(url_).first;
         auto row = db_single<std::int64_t, string, string>(  //
                        _prepare(R"(
                             SELECT remote_id, url, unique_name
@@ -243,7 +329,7 @@ optional<cache_db::remote_entry> cache_db::get_remote_by_id(std::int64_t rowid)
 }
 
 void cache_db::enable_remote(neo::url_view const& url_) {
-    auto url = url_.normalized();
+    auto url = split_sparse_url(url_).first;
     auto res = neo::sqlite3::one_row(  //
         _prepare(R"(
             INSERT INTO bpt_crs_enabled_remotes (remote_id)
@@ -260,15 +346,51 @@ void cache_db::enable_remote(neo::url_view const& url_) {
 
 namespace {
 
+/// An entry from the change log of a remote repository
+struct remote_change {
+    std::int64_t   revno;
+    std::string    action;
+    nlohmann::json package;
+};
+
+/// The changes to a remote repository since we last synced with it
+struct remote_changes {
+    /// The revision of the change log that we will be at once the changes are applied
+    std::int64_t               head_revno;
+    std::vector<remote_change> entries;
+};
+
+/// What we know of a remote repository from a prior sync
+struct prior_remote_info {
+    std::optional<std::string>  etag;
+    std::optional<std::string>  last_modified;
+    std::int64_t                resource_time;
+    std::optional<std::string>  cache_control;
+    std::optional<std::int64_t> log_revno;
+};
+
+/// The data obtained from a remote repository, ready to be imported
 struct remote_repo_db_info {
     fs::path                         local_path;
-    std::optional<std::string_view>  etag;
-    std::optional<std::string_view>  last_modified;
+    std::optional<std::string>       etag;
+    std::optional<std::string>       last_modified;
     std::optional<steady_time_point> resource_time;
-    std::optional<std::string_view>  cache_control;
+    std::optional<std::string>       cache_control;
     bool                             up_to_date;
+    /// If set, these should be applied instead of importing from `local_path`
+    std::optional<remote_changes> changes = std::nullopt;
+    /// If set, the content of the remote database, to be used instead of `local_path`
+    std::optional<std::string> db_image = std::nullopt;
+    /// Keeps `local_path` alive, if the database had to be written to a temporary file
+    std::optional<bpt::temporary_dir> tmpdir = std::nullopt;
 };
 
+/**
+ * @brief The greatest number of change log pages that we will fetch. Each is a request of its own,
+ * so beyond this, downloading the whole database is likely to be quicker.
+ */
+constexpr std::int64_t max_change_log_pages = 4;
+
 /**
  * @brief Determine whether we should revalidate a cached resource based on the cache-control and
  * age of the resource.
@@ -312,11 +434,202 @@ bool should_revalidate(std::string_view cache_control, steady_time_point resourc
     return true;
 }
 
-neo::co_resource<remote_repo_db_info> get_remote_db(bpt::unique_database& db, neo::url url) {
+/**
+ * @brief Compute the create-time of an HTTP resource. By default, just the request time.
+ */
+steady_time_point resource_time_of(const http_response_info& resp) {
+    auto resource_time = steady_clock::now();
+    if (auto age_str = resp.header_value("Age")) {
+        int  age_int = 0;
+        auto r       = std::from_chars(age_str->data(), age_str->data() + age_str->size(), age_int);
+        if (r.ec == std::errc{}) {
+            resource_time -= chrono::seconds{age_int};
+        }
+    }
+    return resource_time;
+}
+
+nlohmann::json read_json_body(request_result& res) {
+    std::string content;
+    res.read_body_stream([&](std::istream& in) {
+        content.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+    });
+    return bpt::parse_json_str(content);
+}
+
+/// A set of changes fetched over HTTP, along with the caching headers of the change log
+struct fetched_changes {
+    remote_changes             changes;
+    steady_time_point          resource_time;
+    std::optional<std::string> cache_control;
+};
+
+/**
+ * @brief Fetch the entries from the change log of the repository at `url` that come after `since`.
+ *
+ * Returns nothing if the repository does not publish a change log, or if the log no longer holds
+ * every entry that we need. In that case, the whole repository database must be downloaded.
+ */
+std::optional<fetched_changes>
+fetch_changes_since(bpt::http_pool& pool, const neo::url& url, std::int64_t since) {
+    return bpt_leaf_try->std::optional<fetched_changes> {
+        fetched_changes ret;
+        nlohmann::json  head;
+        {
+            // Give the connection back before fetching the entries, which may need it
+            auto head_res     = pool.request(url / "repo-log" / "head.json");
+            ret.resource_time = resource_time_of(head_res.resp);
+            if (auto cc = head_res.resp.header_value("Cache-Control")) {
+                ret.cache_control = std::string(*cc);
+            }
+            head = read_json_body(head_res);
+        }
+        auto head_revno = head.at("revno").get<std::int64_t>();
+        auto oldest     = head.at("oldest").get<std::int64_t>();
+        if (since > head_revno) {
+            bpt_log(debug,
+                    "The change log of [{}] ends at revision {}, before the one we have ({}). "
+                    "It may have been recreated.",
+                    url.to_string(),
+                    head_revno,
+                    since);
+            return std::nullopt;
+        }
+        if (since + 1 < oldest) {
+            bpt_log(debug,
+                    "The change log of [{}] has been compacted past revision {}",
+                    url.to_string(),
+                    since);
+            return std::nullopt;
+        }
+        ret.changes.head_revno = head_revno;
+        if (head_revno == since) {
+            return ret;
+        }
+        auto page_size = head.at("page-size").get<std::int64_t>();
+        if (page_size < 1) {
+            bpt_log(debug, "Invalid page size in the change log of [{}]", url.to_string());
+            return std::nullopt;
+        }
+        // Page N holds the revisions after N * page_size, up to and including (N + 1) * page_size
+        auto first_page = since / page_size;
+        auto last_page  = (head_revno - 1) / page_size;
+        if (last_page - first_page + 1 > max_change_log_pages) {
+            bpt_log(debug,
+                    "There are {} changes to [{}]. Downloading the whole database instead.",
+                    head_revno - since,
+                    url.to_string());
+            return std::nullopt;
+        }
+
+        for (auto page_no = first_page; page_no <= last_page; ++page_no) {
+            auto page = [&] {
+                auto page_res = pool.request(url / "repo-log" / neo::ufmt("page-{}.json", page_no));
+                return read_json_body(page_res);
+            }();
+            for (auto& entry : page.at("entries")) {
+                auto revno = entry.at("revno").get<std::int64_t>();
+                if (revno <= since || revno > head_revno) {
+                    // The first page may begin with entries that we have already seen
+                    continue;
+                }
+                auto action = entry.at("action").get<std::string>();
+                if (action != "add" && action != "remove") {
+                    bpt_log(debug,
+                            "Unknown action '{}' in revision {} of the change log of [{}]",
+                            action,
+                            revno,
+                            url.to_string());
+                    return std::nullopt;
+                }
+                auto& pkg = entry.at("package");
+                if (action == "remove") {
+                    // Check these now, so that a bad entry sends us to the full database instead
+                    pkg.at("name").get<std::string>();
+                    pkg.at("version").get<std::string>();
+                    pkg.at("pkg-version").get<std::int64_t>();
+                }
+                ret.changes.entries.push_back(remote_change{
+                    .revno   = revno,
+                    .action  = std::move(action),
+                    .package = std::move(pkg),
+                });
+            }
+        }
+        // Every revision must be applied, in order, or the result would not match the remote
+        auto expect_revno = since;
+        for (auto& change : ret.changes.entries) {
+            if (change.revno != ++expect_revno) {
+                bpt_log(debug,
+                        "Revision {} is missing from the change log of [{}]",
+                        expect_revno,
+                        url.to_string());
+                return std::nullopt;
+            }
+        }
+        if (expect_revno != head_revno) {
+            bpt_log(debug,
+                    "The change log of [{}] ends before revision {}",
+                    url.to_string(),
+                    head_revno);
+            return std::nullopt;
+        }
+        return ret;
+    }
+    bpt_leaf_catch(const http_status_error& err) {
+        bpt_log(debug,
+                "Could not fetch the change log of [{}] (HTTP {})",
+                url.to_string(),
+                err.status_code());
+        return std::nullopt;
+    }
+    bpt_leaf_catch(e_json_parse_error err) {
+        bpt_log(debug, "Invalid JSON in the change log of [{}]: {}", url.to_string(), err.value);
+        return std::nullopt;
+    }
+    bpt_leaf_catch(const nlohmann::json::exception& err) {
+        bpt_log(debug, "Malformed change log from [{}]: {}", url.to_string(), err.what());
+        return std::nullopt;
+    };
+}
+
+std::optional<prior_remote_info> load_prior_info(bpt::unique_database& db, const neo::url& url) {
+    auto& prio_info_st = db.prepare(
+        "SELECT etag, last_modified, resource_time, cache_control, log_revno "
+        "FROM bpt_crs_remotes "
+        "WHERE url=?"_sql);
+    neo::sqlite3::reset_and_bind(prio_info_st, std::string_view(url.to_string())).throw_if_error();
+    auto row = neo::sqlite3::one_row<std::optional<std::string>,
+                                     std::optional<std::string>,
+                                     std::int64_t,
+                                     std::optional<std::string>,
+                                     std::optional<std::int64_t>>(prio_info_st);
+    if (!row.has_value()) {
+        if (row.errc() != neo::sqlite3::errc::done) {
+            row.throw_error();
+        }
+        return std::nullopt;
+    }
+    auto& [etag, last_mod, rc_time, cache_control, log_revno] = *row;
+    return prior_remote_info{
+        .etag          = etag,
+        .last_modified = last_mod,
+        .resource_time = rc_time,
+        .cache_control = cache_control,
+        .log_revno     = log_revno,
+    };
+}
+
+/**
+ * @brief Obtain the data of the remote repository at `url`, given what we know of it from a prior
+ * sync. This does not touch the cache database, so it may run on any thread.
+ */
+remote_repo_db_info fetch_remote_db(const neo::url&                         url,
+                                    const std::optional<prior_remote_info>& prior) {
     if (url.scheme == "file") {
         auto path = fs::path(url.path);
         bpt_log(info, "Importing local repository .cyan[{}] ..."_styled, url.path);
-        auto info = remote_repo_db_info{
+        return remote_repo_db_info{
             .local_path    = path / "repo.db",
             .etag          = std::nullopt,
             .last_modified = std::nullopt,
@@ -324,142 +637,609 @@ neo::co_resource<remote_repo_db_info> get_remote_db(bpt::unique_database& db, ne
             .cache_control = std::nullopt,
             .up_to_date    = false,
         };
-        co_yield info;
-    } else {
-        bpt::http_request_params params;
-        auto&                    prio_info_st = db.prepare(
-            "SELECT etag, last_modified, resource_time, cache_control "
-            "FROM bpt_crs_remotes "
-            "WHERE url=?"_sql);
-        auto url_str = url.to_string();
-        neo_assertion_breadcrumbs("Pulling remote repository metadata", url_str);
-        bpt_log(debug, "Syncing repository [{}] via HTTP", url_str);
-        neo::sqlite3::reset_and_bind(prio_info_st, std::string_view(url_str)).throw_if_error();
-        auto prior_info = neo::sqlite3::one_row<std::optional<std::string>,
-                                                std::optional<std::string>,
-                                                std::int64_t,
-                                                std::optional<std::string>>(prio_info_st);
-        if (prior_info.has_value()) {
-            bpt_log(debug, "Seen this remote repository before. Checking for updates.");
-            const auto& [etag, last_mod, prev_rc_time_, cache_control] = *prior_info;
-            if (etag.has_value()) {
-                params.prior_etag = *etag;
-            }
-            if (last_mod.has_value()) {
-                params.last_modified = *last_mod;
-            }
-            // Check if the cached item is stale according to the server.
-            const auto prev_rc_time = steady_time_point(steady_clock::duration(prev_rc_time_));
-            if (cache_control and not should_revalidate(*cache_control, prev_rc_time)) {
-                bpt_log(info, "Repository data from .cyan[{}] is fresh"_styled, url_str);
-                auto info = remote_repo_db_info{
+    }
+
+    bpt::http_request_params params;
+    auto                     url_str = url.to_string();
+    neo_assertion_breadcrumbs("Pulling remote repository metadata", url_str);
+    bpt_log(debug, "Syncing repository [{}] via HTTP", url_str);
+    auto& pool = bpt::http_pool::global_pool();
+    if (prior.has_value()) {
+        bpt_log(debug, "Seen this remote repository before. Checking for updates.");
+        const auto& [etag, last_mod, prev_rc_time_, cache_control, log_revno] = *prior;
+        if (etag.has_value()) {
+            params.prior_etag = *etag;
+        }
+        if (last_mod.has_value()) {
+            params.last_modified = *last_mod;
+        }
+        // Check if the cached item is stale according to the server.
+        const auto prev_rc_time = steady_time_point(steady_clock::duration(prev_rc_time_));
+        if (cache_control and not should_revalidate(*cache_control, prev_rc_time)) {
+            bpt_log(info, "Repository data from .cyan[{}] is fresh"_styled, url_str);
+            return remote_repo_db_info{
+                .local_path    = "",
+                .etag          = etag,
+                .last_modified = last_mod,
+                .resource_time = prev_rc_time,
+                .cache_control = cache_control,
+                .up_to_date    = true,
+            };
+        }
+
+        // If the repository keeps a change log, try to catch up using only the changes since we
+        // last synced.
+        if (log_revno.has_value()) {
+            if (auto fetched = fetch_changes_since(pool, url, *log_revno)) {
+                if (fetched->changes.entries.empty()) {
+                    bpt_log(info, "Repository data from .cyan[{}] is up-to-date"_styled, url_str);
+                } else {
+                    bpt_log(info,
+                            "Syncing repository .cyan[{}] from its change log ..."_styled,
+                            url_str);
+                }
+                return remote_repo_db_info{
                     .local_path    = "",
                     .etag          = etag,
                     .last_modified = last_mod,
-                    .resource_time = prev_rc_time,
-                    .cache_control = cache_control,
-                    .up_to_date    = true,
+                    .resource_time = fetched->resource_time,
+                    .cache_control = fetched->cache_control,
+                    .up_to_date    = false,
+                    .changes       = std::move(fetched->changes),
                 };
-                co_yield info;
-                co_return;
             }
         }
+    }
 
-        if (!prior_info.has_value() && prior_info.errc() != neo::sqlite3::errc::done) {
-            prior_info.throw_error();
+    auto repo_db_gz_url = url / "repo.db.gz";
+
+    bool           do_discard = true;
+    request_result rinfo      = pool.request(repo_db_gz_url, params);
+    neo_defer {
+        if (do_discard) {
+            rinfo.client.abort_client();
         }
+    };
 
-        auto& pool = bpt::http_pool::thread_local_pool();
+    if (auto message = rinfo.resp.header_value("x-bpt-user-message")) {
+        bpt_log(info, "Message from repository [{}]: {}", url_str, *message);
+    }
 
-        auto repo_db_gz_url = url / "repo.db.gz";
+    // Init the info about the resource that we will return to the caller
+    remote_repo_db_info ret{
+        .local_path    = "",
+        .etag          = std::optional<std::string>(rinfo.resp.etag()),
+        .last_modified = std::optional<std::string>(rinfo.resp.last_modified()),
+        .resource_time = resource_time_of(rinfo.resp),
+        .cache_control = std::optional<std::string>(rinfo.resp.header_value("Cache-Control")),
+        .up_to_date    = false,
+    };
 
-        bool           do_discard = true;
-        request_result rinfo      = pool.request(repo_db_gz_url, params);
-        neo_defer {
-            if (do_discard) {
-                rinfo.client.abort_client();
-            }
-        };
+    if (rinfo.resp.not_modified()) {
+        bpt_log(info, "Repository data from .cyan[{}] is up-to-date"_styled, url_str);
+        do_discard = false;
+        rinfo.discard_body();
+        ret.up_to_date = true;
+        return ret;
+    }
 
-        if (auto message = rinfo.resp.header_value("x-bpt-user-message")) {
-            bpt_log(info, "Message from repository [{}]: {}", url_str, *message);
+    bpt_log(info, "Syncing repository .cyan[{}] ..."_styled, url_str);
+
+    // pool.request() will resolve redirects and errors
+    neo_assert(invariant,
+               !rinfo.resp.is_redirect(),
+               "Did not expect an HTTP redirect at this IO layer");
+    neo_assert(invariant,
+               !rinfo.resp.is_error(),
+               "Did not expect an HTTP error at this IO layer");
+
+    // Keep the database in memory, rather than writing it to disk only to read it back again. It
+    // is decompressed as it arrives, so the compressed body is never held in full.
+    std::string repo_db;
+    rinfo.read_body_stream([&](std::istream& in) {
+        BPT_E_SCOPE(repo_db_gz_url);
+        repo_db = bpt::decompress_gz(in).value();
+    });
+    do_discard = false;
+#if BPT_SQLITE_HAS_DESERIALIZE
+    ret.db_image = std::move(repo_db);
+#else
+    // This SQLite cannot attach a database from memory, so it must take a trip through a file
+    ret.tmpdir     = bpt::temporary_dir::create();
+    ret.local_path = ret.tmpdir->path() / "repo.db";
+    fs::create_directories(ret.tmpdir->path());
+    bpt::write_file(ret.local_path, repo_db);
+#endif
+    return ret;
+}
+
+#if BPT_SQLITE_HAS_DESERIALIZE
+/**
+ * @brief Attach the given database image as the "remote" schema, without going through the
+ * filesystem. The image is used in place, so it must outlive the attachment.
+ */
+void attach_remote_image(bpt::unique_database& db, std::string& image) {
+    db.exec_script(R"(ATTACH DATABASE ':memory:' AS remote)"_sql);
+    auto size = static_cast<sqlite3_int64>(image.size());
+    auto rc   = ::sqlite3_deserialize(db.sqlite3_db().c_ptr(),
+                                      "remote",
+                                      reinterpret_cast<unsigned char*>(image.data()),
+                                      size,
+                                      size,
+                                      SQLITE_DESERIALIZE_READONLY);
+    if (rc != SQLITE_OK) {
+        db.exec_script(R"(DETACH DATABASE remote)"_sql);
+        throw std::system_error(neo::sqlite3::errc{rc},
+                                "Failed to load the remote repository database");
+    }
+}
+#else
+void attach_remote_image(bpt::unique_database&, std::string&) {
+    // get_remote_db() only provides an image if SQLite can load it
+    neo::unreachable();
+}
+#endif
+
+}  // namespace
+
+namespace {
+
+/**
+ * @brief Parse the metadata of a package from a remote repository. Packages with bad metadata are
+ * skipped with a warning, rather than failing the whole sync.
+ */
+std::optional<package_info> parse_remote_package(std::string_view json_str) {
+    return bpt_leaf_try->std::optional<package_info> {
+        auto meta = package_info::from_json_str(json_str);
+        if (meta.id.revision < 1) {
+            bpt_log(warn,
+                    "Remote package {} has an invalid 'pkg-version' of {}.",
+                    meta.id.to_string(),
+                    meta.id.revision);
+            bpt_log(warn, "  The corresponding package will not be available.");
+            bpt_log(debug, "  The bad JSON content is: {}", json_str);
+            return std::nullopt;
+        }
+        return meta;
+    }
+    bpt_leaf_catch(e_invalid_meta_data err) {
+        bpt_log(warn, "Remote package has an invalid JSON entry: {}", err.value);
+        bpt_log(warn, "  The corresponding package will not be available.");
+        bpt_log(debug, "  The bad JSON content is: {}", json_str);
+        return std::nullopt;
+    };
+}
+
+neo::sqlite3::statement& upsert_package_st(bpt::unique_database& db) {
+    return db.prepare(R"(
+        INSERT INTO bpt_crs_packages (json, remote_id, remote_revno)
+            VALUES (?1, ?2, ?3)
+        ON CONFLICT(name, version, pkg_version, remote_id) DO UPDATE
+            SET json=excluded.json,
+                remote_revno=?3,
+                -- The next full sync will validate this package again
+                remote_json=NULL
+    )"_sql);
+}
+
+/**
+ * @brief Import the packages from the attached "remote" database as the packages of the given
+ * remote.
+ *
+ * The packages are staged and merged in bulk. Only those whose JSON differs from what a prior sync
+ * imported are parsed and validated.
+ */
+void import_remote_packages(bpt::unique_database& db,
+                            std::int64_t          remote_id,
+                            std::int64_t          remote_revno) {
+    db.exec_script("DELETE FROM temp.bpt_crs_import"_sql);
+    neo::sqlite3::exec(  //
+        db.prepare(R"(
+            INSERT INTO temp.bpt_crs_import (remote_json, json)
+                SELECT rpkg.meta_json, pkg.json
+                  FROM remote.crs_repo_packages AS rpkg
+             LEFT JOIN bpt_crs_packages AS pkg
+                    ON pkg.remote_id = ?1
+                       AND pkg.name = rpkg.name
+                       AND pkg.version = rpkg.version
+                       AND pkg.pkg_version = rpkg.pkg_version
+                       AND pkg.remote_json = rpkg.meta_json
+        )"_sql),
+        remote_id)
+        .throw_if_error();
+
+    std::vector<std::pair<std::int64_t, std::string>> changed;
+    for (auto [rowid, json_str] : db_query<std::int64_t, std::string>(db.prepare(
+             "SELECT rowid, remote_json FROM temp.bpt_crs_import WHERE json IS NULL"_sql))) {
+        changed.emplace_back(rowid, json_str);
+    }
+    auto& set_json_st = db.prepare("UPDATE temp.bpt_crs_import SET json = ?2 WHERE rowid = ?1"_sql);
+    auto& drop_st     = db.prepare("DELETE FROM temp.bpt_crs_import WHERE rowid = ?"_sql);
+    for (auto& [rowid, json_str] : changed) {
+        auto meta = parse_remote_package(json_str);
+        if (meta.has_value()) {
+            neo::sqlite3::exec(set_json_st, rowid, meta->to_json()).throw_if_error();
+        } else {
+            neo::sqlite3::exec(drop_st, rowid).throw_if_error();
         }
+    }
+    bpt_log(debug, "Validated {} new or changed packages", changed.size());
 
-        // Compute the create-time of the source. By default, just the request time.
-        auto resource_time = steady_clock::now();
-        if (auto age_str = rinfo.resp.header_value("Age")) {
-            int  age_int = 0;
-            auto r = std::from_chars(age_str->data(), age_str->data() + age_str->size(), age_int);
-            if (r.ec == std::errc{}) {
-                resource_time -= chrono::seconds{age_int};
+    // The 'WHERE true' keeps SQLite from reading the 'ON CONFLICT' as part of the join
+    neo::sqlite3::exec(  //
+        db.prepare(R"(
+            INSERT INTO bpt_crs_packages (json, remote_json, remote_id, remote_revno)
+                SELECT json, remote_json, ?1, ?2
+                  FROM temp.bpt_crs_import
+                 WHERE true
+            ON CONFLICT(name, version, pkg_version, remote_id) DO UPDATE
+                SET json = excluded.json,
+                    remote_json = excluded.remote_json,
+                    remote_revno = excluded.remote_revno
+        )"_sql),
+        remote_id,
+        remote_revno)
+        .throw_if_error();
+    db.exec_script("DELETE FROM temp.bpt_crs_import"_sql);
+}
+
+/**
+ * @brief Apply the changes from the change log of a remote repository to the packages that we
+ * already have from it.
+ */
+void apply_remote_changes(bpt::unique_database&                  db,
+                          const neo::url&                        url,
+                          const remote_changes&                  changes,
+                          std::optional<steady_time_point>       rc_time,
+                          std::optional<std::string_view> const& cache_control) {
+    neo::sqlite3::transaction_guard tr{db.sqlite3_db()};
+    auto [remote_id, remote_revno] = *neo::sqlite3::one_row<std::int64_t, std::int64_t>(  //
+        db.prepare(R"(
+            UPDATE bpt_crs_remotes
+               SET log_revno = ?2,
+                   resource_time = ?3,
+                   cache_control = ?4
+             WHERE url = ?1
+            RETURNING remote_id, revno
+        )"_sql),
+        url.to_string(),
+        changes.head_revno,
+        rc_time ? std::make_optional(rc_time->time_since_epoch().count()) : std::nullopt,
+        cache_control);
+
+    std::int64_t n_added   = 0;
+    std::int64_t n_deleted = 0;
+    auto&        delete_st = db.prepare(R"(
+        DELETE FROM bpt_crs_packages
+         WHERE remote_id = ?1
+               AND name = ?2
+               AND version = ?3
+               AND (pkg_version = ?4 OR ?4 = 0)
+    )"_sql);
+    for (auto& change : changes.entries) {
+        if (change.action == "add") {
+            auto meta = parse_remote_package(change.package.dump());
+            if (!meta.has_value()) {
+                continue;
             }
+            neo::sqlite3::exec(upsert_package_st(db), meta->to_json(), remote_id, remote_revno)
+                .throw_if_error();
+            ++n_added;
+        } else {
+            neo::sqlite3::exec(delete_st,
+                               remote_id,
+                               change.package.at("name").get<std::string>(),
+                               change.package.at("version").get<std::string>(),
+                               change.package.at("pkg-version").get<std::int64_t>())
+                .throw_if_error();
+            n_deleted += db.sqlite3_db().changes();
         }
+    }
+    tr.commit();
 
-        // Init the info about the resource that we will return to the caller
-        remote_repo_db_info yield_info{
-            .local_path    = "",
-            .etag          = rinfo.resp.etag(),
-            .last_modified = rinfo.resp.last_modified(),
-            .resource_time = resource_time,
-            .cache_control = rinfo.resp.header_value("Cache-Control"),
-            .up_to_date    = false,
-        };
+    if (!changes.entries.empty()) {
+        bpt_log(info,
+                "Syncing repository .cyan[{}] Done: {} added, {} deleted"_styled,
+                url.to_string(),
+                n_added,
+                n_deleted);
+    }
+}
 
-        if (rinfo.resp.not_modified()) {
-            bpt_log(info, "Repository data from .cyan[{}] is up-to-date"_styled, url_str);
-            do_discard = false;
-            rinfo.discard_body();
-            yield_info.up_to_date = true;
-            co_yield yield_info;
-            co_return;
+/**
+ * @brief Fetch the name of the repository whose sparse index is at `url`. This does not touch the
+ * cache database.
+ */
+std::string fetch_sparse_name(const neo::url& url) {
+    auto config_url = url / "index" / "config.json";
+    bpt_log(info, "Using the package index of .cyan[{}]"_styled, url.to_string());
+    auto config = [&] {
+        if (url.scheme == "file") {
+            return bpt::parse_json_file(fs::path(config_url.path));
         }
+        auto res = bpt::http_pool::global_pool().request(config_url);
+        return read_json_body(res);
+    }();
+    return config.at("name").get<std::string>();
+}
 
-        bpt_log(info, "Syncing repository .cyan[{}] ..."_styled, url_str);
+/**
+ * @brief Register a remote that is read through its sparse index, given the name from
+ * @ref fetch_sparse_name. Packages are fetched by name as they are needed, by
+ * @ref sync_sparse_name.
+ */
+void register_sparse_remote(bpt::unique_database& db,
+                            const neo::url&       url,
+                            const std::string&    name) {
+    neo::sqlite3::transaction_guard tr{db.sqlite3_db()};
+    // Switching a remote over from its full database bumps its revno, so that the packages from
+    // the database import are dropped. The caching headers of the database are forgotten too.
+    auto [remote_id, remote_revno] = *neo::sqlite3::one_row<std::int64_t, std::int64_t>(  //
+        db.prepare(R"(
+            INSERT INTO bpt_crs_remotes (url, unique_name, revno, sparse)
+            VALUES (?1, ?2, 1, 1)
+            ON CONFLICT (unique_name) DO UPDATE
+                SET url = ?1,
+                    revno = CASE WHEN sparse THEN revno ELSE revno + 1 END,
+                    sparse = 1,
+                    etag = NULL,
+                    last_modified = NULL,
+                    resource_time = NULL,
+                    cache_control = NULL,
+                    log_revno = NULL
+            RETURNING remote_id, revno
+        )"_sql),
+        url.to_string(),
+        name);
+    neo::sqlite3::exec(  //
+        db.prepare(R"(
+            DELETE FROM bpt_crs_packages
+             WHERE remote_id = ? AND remote_revno < ?
+        )"_sql),
+        remote_id,
+        remote_revno)
+        .throw_if_error();
+}
 
-        // pool.request() will resolve redirects and errors
-        neo_assert(invariant,
-                   !rinfo.resp.is_redirect(),
-                   "Did not expect an HTTP redirect at this IO layer");
-        neo_assert(invariant,
-                   !rinfo.resp.is_error(),
-                   "Did not expect an HTTP error at this IO layer");
+/**
+ * @brief Bring the packages with the given name from the sparse index of a remote up-to-date.
+ *
+ * Each index file is cached according to its own HTTP caching headers. If the file cannot be
+ * fetched but we have an earlier copy of it, the earlier copy is used.
+ */
+void sync_sparse_name(bpt::unique_database& db,
+                      std::int64_t          remote_id,
+                      const neo::url&       url,
+                      std::string_view      name) {
+    auto file_url = url / "index" / neo::ufmt("{}.json", name);
+    BPT_E_SCOPE(e_sync_remote{url});
+    neo_assertion_breadcrumbs("Fetching package index entry", file_url.to_string());
 
-        auto tmpdir    = bpt::temporary_dir::create();
-        auto dest_file = tmpdir.path() / "repo.db.gz";
-        std::filesystem::create_directories(tmpdir.path());
-        rinfo.save_file(dest_file);
-        do_discard = false;
+    auto& prior_st = db.prepare(R"(
+        SELECT etag, last_modified, resource_time, cache_control
+          FROM bpt_crs_sparse_files
+         WHERE remote_id = ? AND name = ?
+    )"_sql);
+    neo::sqlite3::reset_and_bind(prior_st, remote_id, name).throw_if_error();
+    auto prior = neo::sqlite3::one_row<std::optional<std::string>,
+                                       std::optional<std::string>,
+                                       std::optional<std::int64_t>,
+                                       std::optional<std::string>>(prior_st);
+    if (!prior.has_value() && prior.errc() != neo::sqlite3::errc::done) {
+        prior.throw_error();
+    }
+
+    auto& update_file_st = db.prepare(R"(
+        INSERT INTO bpt_crs_sparse_files
+            (remote_id, name, etag, last_modified, resource_time, cache_control)
+        VALUES (?1, ?2, ?3, ?4, ?5, ?6)
+        ON CONFLICT (remote_id, name) DO UPDATE
+            SET etag = ?3,
+                last_modified = ?4,
+                resource_time = ?5,
+                cache_control = ?6
+    )"_sql);
+
+    std::optional<std::string>  etag;
+    std::optional<std::string>  last_modified;
+    std::optional<std::int64_t> resource_time;
+    std::optional<std::string>  cache_control;
+    // The packages in the index file. An absent file means that there are no such packages.
+    nlohmann::json index = nlohmann::json::object();
+    if (url.scheme == "file") {
+        auto path = fs::path(file_url.path);
+        if (fs::exists(path)) {
+            index = bpt::parse_json_file(path);
+        }
+    } else {
+        bpt::http_request_params params;
+        if (prior.has_value()) {
+            const auto& [prior_etag, prior_last_mod, prior_rc_time, prior_cc] = *prior;
+            if (prior_rc_time.has_value() && prior_cc.has_value()
+                && !should_revalidate(*prior_cc,
+                                      steady_time_point(steady_clock::duration(*prior_rc_time)))) {
+                bpt_log(debug, "Cached index entry [{}] is fresh", file_url.to_string());
+                return;
+            }
+            if (prior_etag.has_value()) {
+                params.prior_etag = *prior_etag;
+            }
+            if (prior_last_mod.has_value()) {
+                params.last_modified = *prior_last_mod;
+            }
+        }
+        try {
+            auto res = bpt::http_pool::global_pool().request(file_url, params);
+            if (auto h = res.resp.etag()) {
+                etag = std::string(*h);
+            }
+            if (auto h = res.resp.last_modified()) {
+                last_modified = std::string(*h);
+            }
+            if (auto h = res.resp.header_value("Cache-Control")) {
+                cache_control = std::string(*h);
+            }
+            resource_time = resource_time_of(res.resp).time_since_epoch().count();
+            if (res.resp.not_modified()) {
+                res.discard_body();
+                bpt_log(debug, "Index entry [{}] is up-to-date", file_url.to_string());
+                neo::sqlite3::exec(update_file_st,
+                                   remote_id,
+                                   name,
+                                   std::get<0>(*prior),
+                                   std::get<1>(*prior),
+                                   resource_time,
+                                   cache_control)
+                    .throw_if_error();
+                return;
+            }
+            index = read_json_body(res);
+        } catch (const http_status_error& err) {
+            if (err.status_code() != 404) {
+                throw;
+            }
+            bpt_log(debug, "There is no index entry [{}]", file_url.to_string());
+        } catch (const std::system_error& err) {
+            if (!prior.has_value()) {
+                throw;
+            }
+            bpt_log(warn,
+                    "Failed to fetch [.bold.yellow[{}]] ({}). We'll continue by using cached "
+                    "information."_styled,
+                    file_url.to_string(),
+                    err.code().message());
+            return;
+        }
+    }
 
-        auto repo_db = tmpdir.path() / "repo.db";
-        bpt::decompress_file_gz(dest_file, repo_db).value();
-        yield_info.local_path = repo_db;
-        co_yield yield_info;
+    neo::sqlite3::transaction_guard tr{db.sqlite3_db()};
+    auto remote_revno = *neo::sqlite3::one_cell<std::int64_t>(
+        db.prepare("SELECT revno FROM bpt_crs_remotes WHERE remote_id = ?"_sql),
+        remote_id);
+    neo::sqlite3::exec(  //
+        db.prepare(R"(
+            DELETE FROM bpt_crs_packages
+             WHERE remote_id = ? AND name = ?
+        )"_sql),
+        remote_id,
+        name)
+        .throw_if_error();
+    int n_packages = 0;
+    for (auto& pkg_json : index.value("packages", nlohmann::json::array())) {
+        auto meta = parse_remote_package(pkg_json.dump());
+        if (!meta.has_value()) {
+            continue;
+        }
+        if (meta->id.name.str != name) {
+            bpt_log(warn,
+                    "Index entry [{}] lists a package of a different name ({}). It will be "
+                    "ignored.",
+                    file_url.to_string(),
+                    meta->id.to_string());
+            continue;
+        }
+        neo::sqlite3::exec(upsert_package_st(db), meta->to_json(), remote_id, remote_revno)
+            .throw_if_error();
+        ++n_packages;
     }
+    neo::sqlite3::exec(update_file_st,
+                       remote_id,
+                       name,
+                       etag,
+                       last_modified,
+                       resource_time,
+                       cache_control)
+        .throw_if_error();
+    tr.commit();
+    bpt_log(debug,
+            "Loaded {} package(s) named {} from [{}]",
+            n_packages,
+            name,
+            file_url.to_string());
 }
 
 }  // namespace
 
-void cache_db::sync_remote(const neo::url_view& url_) const {
+struct cache_db::pending_sync::impl {
+    neo::url url;
+    bool     sparse;
+    /// Read from the database by begin_sync()
+    std::optional<prior_remote_info> prior;
+    /// Fetched by fetch(), for remotes that are imported whole
+    std::optional<remote_repo_db_info> fetched;
+    /// Fetched by fetch(), for remotes that are read through their sparse index
+    std::optional<std::string> sparse_name;
+};
+
+cache_db::pending_sync cache_db::begin_sync(const neo::url_view& url_) const {
+    auto [url, sparse] = split_sparse_url(url_);
+    BPT_E_SCOPE(e_sync_remote{url});
+    pending_sync ret;
+    ret._impl         = std::make_shared<pending_sync::impl>();
+    ret._impl->url    = url;
+    ret._impl->sparse = sparse;
+    if (!sparse) {
+        ret._impl->prior = load_prior_info(_db, url);
+    }
+    return ret;
+}
+
+void cache_db::pending_sync::fetch() {
+    auto& self = *_impl;
+    BPT_E_SCOPE(e_sync_remote{self.url});
+    if (self.sparse) {
+        self.sparse_name = fetch_sparse_name(self.url);
+    } else {
+        self.fetched = fetch_remote_db(self.url, self.prior);
+    }
+}
+
+void cache_db::sync_remote(const neo::url_view& url) const {
+    auto sync = begin_sync(url);
+    sync.fetch();
+    finish_sync(std::move(sync));
+}
+
+void cache_db::finish_sync(pending_sync&& sync) const {
+    auto self = std::move(sync._impl);
+    neo_assert(expects,
+               self && (self->fetched || self->sparse_name),
+               "finish_sync() was given a sync that has not been fetched");
     bpt::unique_database& db  = _db;
-    auto                  url = url_.normalized();
+    const auto&           url = self->url;
     BPT_E_SCOPE(e_sync_remote{url});
-    auto remote_db = get_remote_db(_db, url);
+    if (self->sparse) {
+        register_sparse_remote(db, url, *self->sparse_name);
+        return;
+    }
+    auto& remote_db = *self->fetched;
 
-    auto rc_time = remote_db->resource_time;
+    auto rc_time = remote_db.resource_time;
 
-    if (remote_db->up_to_date) {
+    if (remote_db.up_to_date) {
         neo::sqlite3::exec(  //
             db.prepare("UPDATE bpt_crs_remotes "
-                       "SET resource_time = ?1, cache_control = ?2"_sql),
+                       "SET resource_time = ?1, cache_control = ?2 "
+                       "WHERE url = ?3"_sql),
             rc_time ? std::make_optional(rc_time->time_since_epoch().count()) : std::nullopt,
-            remote_db->cache_control)
+            remote_db.cache_control,
+            url.to_string())
             .throw_if_error();
         return;
     }
 
-    neo::sqlite3::exec(db.prepare("ATTACH DATABASE ? AS remote"_sql),
-                       remote_db->local_path.string())
-        .throw_if_error();
+    if (remote_db.changes) {
+        apply_remote_changes(db, url, *remote_db.changes, rc_time, remote_db.cache_control);
+        return;
+    }
+
+    if (remote_db.db_image) {
+        attach_remote_image(db, *remote_db.db_image);
+    } else {
+        neo::sqlite3::exec(db.prepare("ATTACH DATABASE ? AS remote"_sql),
+                           remote_db.local_path.string())
+            .throw_if_error();
+    }
     neo_defer { db.exec_script(R"(DETACH DATABASE remote)"_sql); };
 
     // Import those packages
@@ -483,60 +1263,21 @@ void cache_db::sync_remote(const neo::url_view& url_) const {
                 last_modified = ?3,
                 resource_time = ?4,
                 cache_control = ?5,
-                revno = revno + 1
+                revno = revno + 1,
+                sparse = 0
         RETURNING remote_id, revno
     )"_sql);
     auto [remote_id, remote_revno] = *neo::sqlite3::one_row<std::int64_t, std::int64_t>(  //
         update_remote_st,
         url.to_string(),
-        remote_db->etag,
-        remote_db->last_modified,
+        remote_db.etag,
+        remote_db.last_modified,
         rc_time ? std::make_optional(rc_time->time_since_epoch().count()) : std::nullopt,
-        remote_db->cache_control);
-
-    auto remote_packages =  //
-        *neo::sqlite3::exec_tuples<std::string_view>(db.prepare(R"(
-            SELECT meta_json FROM remote.crs_repo_packages
-        )"_sql))
-        | std::views::transform([](auto tup) -> std::optional<package_info> {
-              auto [json_str] = tup;
-              return bpt_leaf_try->std::optional<package_info> {
-                  auto meta = package_info::from_json_str(json_str);
-                  if (meta.id.revision < 1) {
-                      bpt_log(warn,
-                              "Remote package {} has an invalid 'pkg-version' of {}.",
-                              meta.id.to_string(),
-                              meta.id.revision);
-                      bpt_log(warn, "  The corresponding package will not be available.");
-                      bpt_log(debug, "  The bad JSON content is: {}", json_str);
-                      return std::nullopt;
-                  }
-                  return meta;
-              }
-              bpt_leaf_catch(e_invalid_meta_data err) {
-                  bpt_log(warn, "Remote package has an invalid JSON entry: {}", err.value);
-                  bpt_log(warn, "  The corresponding package will not be available.");
-                  bpt_log(debug, "  The bad JSON content is: {}", json_str);
-                  return std::nullopt;
-              };
-          });
+        remote_db.cache_control);
 
     auto n_before = *neo::sqlite3::one_cell<std::int64_t>(
         db.prepare("SELECT count(*) FROM bpt_crs_packages"_sql));
-    auto& update_pkg_st = db.prepare(R"(
-        INSERT INTO bpt_crs_packages (json, remote_id, remote_revno)
-            VALUES (?1, ?2, ?3)
-        ON CONFLICT(name, version, pkg_version, remote_id) DO UPDATE
-            SET json=excluded.json,
-                remote_revno=?3
-    )"_sql);
-    for (auto meta : remote_packages) {
-        if (!meta.has_value()) {
-            continue;
-        }
-        neo::sqlite3::exec(update_pkg_st, meta->to_json(), remote_id, remote_revno)
-            .throw_if_error();
-    }
+    import_remote_packages(db, remote_id, remote_revno);
     auto n_after = *neo::sqlite3::one_cell<std::int64_t>(
         db.prepare("SELECT count(*) FROM bpt_crs_packages"_sql));
     const std::int64_t n_added = n_after - n_before;
@@ -548,9 +1289,27 @@ void cache_db::sync_remote(const neo::url_view& url_) const {
     neo::sqlite3::reset_and_bind(delete_old_st, remote_id, remote_revno).throw_if_error();
     neo::sqlite3::exec(delete_old_st).throw_if_error();
     const auto n_deleted = db.sqlite3_db().changes();
+    // In case the remote was read through its sparse index before
+    neo::sqlite3::exec(db.prepare("DELETE FROM bpt_crs_sparse_files WHERE remote_id = ?"_sql),
+                       remote_id)
+        .throw_if_error();
 
-    bpt_log(debug, "Running integrity check");
-    db.exec_script("PRAGMA main.integrity_check"_sql);
+    // Remember where the remote's change log was at, so that the next sync can start from there.
+    // Repositories from older versions of bpt do not record their revision.
+    std::optional<std::int64_t> log_revno;
+    auto                        has_revno = *neo::sqlite3::one_cell<std::int64_t>(db.prepare(R"(
+        SELECT count(*) FROM pragma_table_info('crs_repo_self', 'remote')
+         WHERE name = 'revno'
+    )"_sql));
+    if (has_revno) {
+        log_revno = *neo::sqlite3::one_cell<std::int64_t>(
+            db.prepare("SELECT revno FROM remote.crs_repo_self"_sql));
+    }
+    neo::sqlite3::exec(  //
+        db.prepare("UPDATE bpt_crs_remotes SET log_revno = ?2 WHERE remote_id = ?1"_sql),
+        remote_id,
+        log_revno)
+        .throw_if_error();
 
     bpt_log(info,
             "Syncing repository .cyan[{}] Done: {} added, {} deleted"_styled,
@@ -559,6 +1318,85 @@ void cache_db::sync_remote(const neo::url_view& url_) const {
             n_deleted);
 }
 
+void cache_db::disable_remote(neo::url_view const& url_) {
+    auto url = split_sparse_url(url_).first;
+    neo::sqlite3::exec(  //
+        _prepare(R"(
+            DELETE FROM bpt_crs_enabled_remotes
+             WHERE remote_id IN (SELECT remote_id FROM bpt_crs_remotes WHERE url = ?)
+        )"_sql),
+        string_view(url.to_string()))
+        .throw_if_error();
+}
+
+void cache_db::sync_name(bpt::name const& name) const {
+    _sync_sparse_names(name);
+    if (!_deferred_sync) {
+        return;
+    }
+    // Finish the query before syncing, which may need to modify the database
+    bool have_any = [&] {
+        auto pkgs = for_package(name);
+        return pkgs.begin() != pkgs.end();
+    }();
+    if (!have_any && sync_deferred()) {
+        // The sync may have enabled more sparse remotes
+        _sync_sparse_names(name);
+    }
+}
+
+void cache_db::defer_sync(std::function<void()> fn) noexcept { _deferred_sync = std::move(fn); }
+
+bool cache_db::sync_deferred() const {
+    if (!_deferred_sync) {
+        return false;
+    }
+    // Take the function first, so that it is only run once, even if it fails
+    auto fn = std::exchange(_deferred_sync, nullptr);
+    bpt_log(debug, "Cached package metadata is insufficient. Synchronizing remote repositories.");
+    ++_sync_generation;
+    fn();
+    return true;
+}
+
+void cache_db::_sync_sparse_names(bpt::name const& name) const {
+    bpt::unique_database& db         = _db;
+    auto&                 pending_st = db.prepare(R"(
+        SELECT remote_id, url
+          FROM bpt_crs_remotes
+          JOIN bpt_crs_enabled_remotes USING (remote_id)
+         WHERE sparse
+               AND NOT EXISTS (
+                   SELECT 1 FROM bpt_crs_sparse_checked AS checked
+                    WHERE checked.remote_id = bpt_crs_remotes.remote_id
+                          AND checked.name = ?1
+               )
+    )"_sql);
+    std::vector<std::pair<std::int64_t, std::string>> pending;
+    for (auto [remote_id, url] :
+         db_query<std::int64_t, std::string>(pending_st, string_view(name.str))) {
+        pending.emplace_back(remote_id, url);
+    }
+    for (auto& [remote_id, url] : pending) {
+        sync_sparse_name(db, remote_id, bpt::parse_url(url), name.str);
+        neo::sqlite3::exec(  //
+            db.prepare("INSERT INTO bpt_crs_sparse_checked (remote_id, name) VALUES (?, ?)"_sql),
+            remote_id,
+            string_view(name.str))
+            .throw_if_error();
+    }
+}
+
+std::vector<std::string> cache_db::check_integrity() const {
+    std::vector<std::string> problems;
+    for (auto [msg] : db_query<std::string>(_prepare("PRAGMA main.integrity_check"_sql))) {
+        if (msg != "ok") {
+            problems.push_back(msg);
+        }
+    }
+    return problems;
+}
+
 neo::sqlite3::connection_ref cache_db::sqlite3_db() const noexcept {
     return _db.get().sqlite3_db();
 }
\ No newline at end of file
@@ -10,6 +10,9 @@
 #include <neo/sqlite3/fwd.hpp>
 #include <neo/url/url.hpp>
 
+#include <functional>
+#include <memory>
+
 namespace bpt::crs {
 
 struct e_no_such_remote_url {
@@ -29,6 +32,10 @@ struct e_no_such_remote_url {
  */
 class cache_db {
     neo::ref_member<bpt::unique_database> _db;
+    /// A sync that has been put off until it is needed. @see defer_sync
+    mutable std::function<void()> _deferred_sync;
+    /// The number of syncs that have been run by sync_deferred. @see sync_generation
+    mutable std::uint64_t _sync_generation = 0;
 
     explicit cache_db(bpt::unique_database& db) noexcept
         : _db(db) {}
@@ -36,6 +43,9 @@ class cache_db {
     // Convenience method to return a prepared statement
     neo::sqlite3::statement& _prepare(neo::sqlite3::sql_string_literal) const;
 
+    // Fetch the index entries of the given name from the enabled sparse remotes. @see sync_name
+    void _sync_sparse_names(bpt::name const& name) const;
+
 public:
     /**
      * @brief A cache entry for a CRS package.
@@ -107,9 +117,92 @@ public:
 
     /**
      * @brief Ensure that we have up-to-date package metadata from the given remote repo
+     *
+     * If the URL scheme has a "sparse+" prefix (e.g. "sparse+https://"), the remote is read
+     * through its sparse index instead: Only the repository's name is fetched here, and the
+     * metadata of each package is fetched when @ref sync_name is first called for its name.
      */
     void sync_remote(const neo::url_view& url) const;
 
+    /**
+     * @brief A sync of a remote repository, split into stages so that the network requests for
+     * many remotes can be made at the same time.
+     *
+     * @see begin_sync
+     */
+    class pending_sync {
+        friend cache_db;
+        struct impl;
+        std::shared_ptr<impl> _impl;
+
+    public:
+        /**
+         * @brief Fetch the data of the remote repository. This does not use the database, so it
+         * may be called from any thread.
+         */
+        void fetch();
+    };
+
+    /**
+     * @brief Begin a sync of the given remote, which does the same as @ref sync_remote in stages.
+     *
+     * This only reads what we already know of the remote. The result must then be fetched with
+     * @ref pending_sync::fetch, and given to @ref finish_sync on the thread that uses this
+     * database.
+     */
+    [[nodiscard]] pending_sync begin_sync(const neo::url_view& url) const;
+
+    /**
+     * @brief Import the data obtained by a pending sync that has been fetched.
+     */
+    void finish_sync(pending_sync&& sync) const;
+
+    /**
+     * @brief Ensure that we have up-to-date metadata for packages of the given name from every
+     * enabled remote that is read through its sparse index.
+     *
+     * Each name is only checked once in the lifetime of the database connection. This has no
+     * effect for remotes whose full metadata is imported by @ref sync_remote.
+     *
+     * If there are still no packages of the given name, a sync that was put off with @ref
+     * defer_sync is run now.
+     */
+    void sync_name(bpt::name const& name) const;
+
+    /**
+     * @brief Put off bringing the enabled remotes up-to-date until the cached metadata is found
+     * to be lacking.
+     *
+     * The given function is invoked at most once, by @ref sync_deferred. This happens when @ref
+     * sync_name finds no packages of the requested name, and may be requested by any other user of
+     * the database that cannot make do with what is cached (e.g. a failed dependency solve).
+     */
+    void defer_sync(std::function<void()> fn) noexcept;
+
+    /**
+     * @brief Run the sync that was given to @ref defer_sync, if it has not yet been run.
+     *
+     * @return Whether a sync was run. If so, queries should be repeated to see the new data.
+     */
+    bool sync_deferred() const;
+
+    /**
+     * @brief Get the number of syncs that have been run by @ref sync_deferred.
+     *
+     * A deferred sync may be run by any query that goes through @ref sync_name. If this value
+     * changes between two queries, the results of the earlier query may be out-of-date.
+     */
+    std::uint64_t sync_generation() const noexcept { return _sync_generation; }
+
+    /**
+     * @brief Check the structural integrity of the cache database.
+     *
+     * This is too slow to do on every sync, and is meant for explicit maintenance.
+     *
+     * @return A description of each problem that was found. Empty if the database is intact.
+     */
+    [[nodiscard]] std::vector<std::string> check_integrity() const;
+
     std::optional<pkg_id> lowest_version_matching(const dependency& dep) const;
 
     neo::sqlite3::connection_ref sqlite3_db() const noexcept;
@@ -4,6 +4,7 @@
 #include <bpt/temp.hpp>
 #include <bpt/util/fs/io.hpp>
 #include <bpt/util/fs/shutil.hpp>
+#include <bpt/util/http/download.hpp>
 #include <bpt/util/http/pool.hpp>
 #include <bpt/util/log.hpp>
 
@@ -12,6 +13,7 @@
 #include <neo/ufmt.hpp>
 
 #include <fstream>
+#include <istream>
 
 using namespace bpt;
 using namespace bpt::crs;
@@ -23,17 +25,24 @@ neo::url calc_pkg_url(neo::url_view from, pkg_id pkg) {
         / neo::ufmt("{}~{}", pkg.version.to_string(), pkg.revision) / "pkg.tgz";
 }
 
-void expand_tgz(path_ref tgz_path, path_ref into) {
-    auto infile = bpt::open_file(tgz_path, std::ios::binary | std::ios::in);
+void expand_tgz_stream(std::istream& in, path_ref into, std::string_view input_name) {
     fs::create_directories(into);
     neo::expand_directory_targz(
         neo::expand_options{
             .destination_directory = into,
-            .input_name            = tgz_path.string(),
+            .input_name            = std::string(input_name),
         },
-        infile);
+        in);
 }
 
+void expand_tgz(path_ref tgz_path, path_ref into) {
+    auto infile = bpt::open_file(tgz_path, std::ios::binary | std::ios::in);
+    expand_tgz_stream(infile, into, tgz_path.string());
+}
+
+/// Where the partial downloads of archives destined for `dest_dir` are kept between attempts
+fs::path partial_download_dir(path_ref dest_dir) { return dest_dir / ".bpt-partial"; }
+
 }  // namespace
 
 void crs::pull_pkg_ar_from_remote(path_ref dest, neo::url_view from, pkg_id pkg) {
@@ -55,34 +64,56 @@ void crs::pull_pkg_ar_from_remote(path_ref dest, neo::url_view from, pkg_id pkg)
     auto tmp = dest.parent_path() / ".bpt-download.tmp";
     neo_defer { std::ignore = ensure_absent(tmp); };
 
-    {
-        auto& pool   = http_pool::thread_local_pool();
-        auto  reqres = pool.request(tgz_url);
-        reqres.save_file(tmp);
-    }
+    download_resumable(http_pool::global_pool(),
+                       tgz_url,
+                       partial_download_dir(dest.parent_path()),
+                       [&](std::istream& in) {
+                           auto out = bpt::open_file(tmp, std::ios::binary | std::ios::out);
+                           out << in.rdbuf();
+                       });
 
     bpt::ensure_absent(dest).value();
     bpt::move_file(tmp, dest).value();
 }
 
 void crs::pull_pkg_from_remote(path_ref expand_into, neo::url_view from, pkg_id pkg) {
-    fs::path expand_tgz_path;
+    // Expand into a staging directory beside the destination, so that a partially expanded package
+    // is never visible at the destination.
+    auto tmpdir  = bpt::temporary_dir::create_in(expand_into.parent_path());
+    auto staging = tmpdir.path() / "pkg";
+    auto tgz_url = calc_pkg_url(from, pkg);
     if (from.scheme == "file") {
         bpt_log(debug,
-                "Expanding package archive of {} from remote [{}] in-place into [{}]",
+                "Expanding package archive of {} from remote [{}] into [{}]",
                 pkg.to_string(),
                 from.to_string(),
                 expand_into.string());
         // We can skip copying the tarball and just expand the one in the repository directly.
-        fs::path tgz_path = calc_pkg_url(from, pkg).path;
-        expand_tgz(tgz_path, expand_into);
+        expand_tgz(fs::path{tgz_url.path}, staging);
     } else {
-        // Create a tempdir, download into it, and expand that
-        auto tmpdir   = bpt::temporary_dir::create_in(expand_into.parent_path());
-        auto tgz_path = tmpdir.path() / neo::ufmt("~{}.tgz", pkg.to_string());
-        // Download:
-        pull_pkg_ar_from_remote(tgz_path, from, pkg);
-        // Expand:
-        expand_tgz(tgz_path, expand_into);
+        bpt_log(trace,
+                "Streaming package archive of {} from [{}] into [{}]",
+                pkg.to_string(),
+                tgz_url.to_string(),
+                expand_into.string());
+        // Decompress and expand the archive as it is received. The archive itself is only kept
+        // if the download is interrupted, so that the next attempt can resume it.
+        download_resumable(http_pool::global_pool(),
+                           tgz_url,
+                           partial_download_dir(expand_into.parent_path()),
+                           [&](std::istream& body) {
+                               expand_tgz_stream(body, staging, tgz_url.to_string());
+                           });
+    }
+
+    auto moved = bpt::move_file(staging, expand_into);
+    if (!moved && fs::is_directory(expand_into)) {
+        // Someone else put the package in place while we were fetching it
+        bpt_log(debug,
+                "Package {} was already expanded into [{}]",
+                pkg.to_string(),
+                expand_into.string());
+        return;
     }
+    moved.value();
 }
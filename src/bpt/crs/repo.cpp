@@ -22,6 +22,14 @@
 #include <neo/sqlite3/transaction.hpp>
 #include <neo/tar/util.hpp>
 #include <neo/ufmt.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
 
 using namespace bpt;
 using namespace bpt::crs;
@@ -32,29 +40,55 @@ using path_ref = const std::filesystem::path&;
 namespace {
 
 void ensure_migrated(unique_database& db) {
-    apply_db_migrations(db, "crs_repo_meta", [](unique_database& db) {
-        db.exec_script(R"(
-            CREATE TABLE crs_repo_self (
-                rowid INTEGER PRIMARY KEY,
-                name TEXT NOT NULL
-            );
-
-            CREATE TABLE crs_repo_packages (
-                package_id INTEGER PRIMARY KEY,
-                meta_json TEXT NOT NULL,
-                name TEXT NOT NULL
-                    GENERATED ALWAYS AS (json_extract(meta_json, '$.name'))
-                    VIRTUAL,
-                version TEXT NOT NULL
-                    GENERATED ALWAYS AS (json_extract(meta_json, '$.version'))
-                    VIRTUAL,
-                pkg_version INTEGER NOT NULL
-                    GENERATED ALWAYS AS (json_extract(meta_json, '$.pkg-version'))
-                    VIRTUAL,
-                UNIQUE(name, version, pkg_version)
-            );
-        )"_sql);
-    }).value();
+    apply_db_migrations(  //
+        db,
+        "crs_repo_meta",
+        [](unique_database& db) {  //
+            db.exec_script(R"(
+                CREATE TABLE crs_repo_self (
+                    rowid INTEGER PRIMARY KEY,
+                    name TEXT NOT NULL
+                );
+
+                CREATE TABLE crs_repo_packages (
+                    package_id INTEGER PRIMARY KEY,
+                    meta_json TEXT NOT NULL,
+                    name TEXT NOT NULL
+                        GENERATED ALWAYS AS (json_extract(meta_json, '$.name'))
+                        VIRTUAL,
+                    version TEXT NOT NULL
+                        GENERATED ALWAYS AS (json_extract(meta_json, '$.version'))
+                        VIRTUAL,
+                    pkg_version INTEGER NOT NULL
+                        GENERATED ALWAYS AS (json_extract(meta_json, '$.pkg-version'))
+                        VIRTUAL,
+                    UNIQUE(name, version, pkg_version)
+                );
+            )"_sql);
+        },
+        [](unique_database& db) {  //
+            db.exec_script(R"(
+                -- Every change to crs_repo_packages, in order. Clients that have seen an earlier
+                -- revision apply these instead of downloading the whole database again.
+                CREATE TABLE crs_repo_changes (
+                    revno INTEGER PRIMARY KEY AUTOINCREMENT,
+                    action TEXT NOT NULL CHECK (action IN ('add', 'remove')),
+                    meta_json TEXT NOT NULL
+                );
+                -- Changes up to and including this revno have been dropped from the log
+                ALTER TABLE crs_repo_self ADD COLUMN compacted_revno INTEGER NOT NULL DEFAULT 0;
+            )"_sql);
+        },
+        [](unique_database& db) {  //
+            db.exec_script(R"(
+                -- The revision of the newest change. The published snapshot of the database leaves
+                -- out crs_repo_changes, so clients learn the revision of the snapshot from here.
+                ALTER TABLE crs_repo_self ADD COLUMN revno INTEGER NOT NULL DEFAULT 0;
+                UPDATE crs_repo_self
+                   SET revno = coalesce((SELECT max(revno) FROM crs_repo_changes), compacted_revno);
+            )"_sql);
+        })
+        .value();
 }
 
 void copy_source_tree(path_ref from_dir, path_ref to_dir) {
@@ -83,14 +117,76 @@ void archive_package_libraries(path_ref from_dir, path_ref dest_root, const pack
     }
 }
 
+/**
+ * The number of change log entries in each page of "repo-log/". Clients fetch whole pages, so
+ * this trades the size of each page against the number of requests needed to catch up.
+ */
+constexpr std::int64_t log_page_size = 64;
+
+/// The page of the change log that holds the given revision. Revisions start at one.
+std::int64_t log_page_of(std::int64_t revno) noexcept { return (revno - 1) / log_page_size; }
+
+/// Get the page number from the filename of a page of the change log, "page-<N>.json"
+std::optional<std::int64_t> parse_log_page_name(std::string_view name) noexcept {
+    if (!name.starts_with("page-") || !name.ends_with(".json")) {
+        return std::nullopt;
+    }
+    auto         num     = name.substr(5, name.size() - 10);
+    std::int64_t page_no = 0;
+    auto         conv    = std::from_chars(num.data(), num.data() + num.size(), page_no);
+    if (num.empty() || conv.ec != std::errc{} || conv.ptr != num.data() + num.size()) {
+        return std::nullopt;
+    }
+    return page_no;
+}
+
+/**
+ * Get the revision of the head that was last published to the change log, if it was published in
+ * pages of the current size. Otherwise, every page must be written again.
+ */
+std::optional<std::int64_t> read_published_head(path_ref head_path) {
+    if (!fs::is_regular_file(head_path)) {
+        return std::nullopt;
+    }
+    auto head   = nlohmann::json::parse(bpt::read_file(head_path), nullptr, false);
+    auto is_int = [&](const char* key) {
+        return head.contains(key) && head[key].is_number_integer();
+    };
+    if (!is_int("page-size") || !is_int("revno")
+        || head["page-size"].get<std::int64_t>() != log_page_size) {
+        return std::nullopt;
+    }
+    return head["revno"].get<std::int64_t>();
+}
+
+/// Write a file that is read by clients, such that they never see it partially written
+void publish_file(path_ref dest, std::string_view content) {
+    auto tmp = fs::path(dest) += ".tmp";
+    bpt::write_file(tmp, content);
+    move_file(tmp, dest).value();
+}
+
 }  // namespace
 
 void repository::_vacuum_and_compress() const {
     neo_assert(invariant,
                !_db.sqlite3_db().is_transaction_active(),
                "Database cannot be recompressed while a transaction is open");
-    db_exec(_prepare("VACUUM"_sql)).value();
-    bpt::compress_file_gz(_dirpath / "repo.db", _dirpath / "repo.db.gz").value();
+    // The change log is published separately in "repo-log/", and would only grow the snapshot that
+    // clients download, so the snapshot is compressed from a copy without it. VACUUM INTO already
+    // writes a compacted copy, so this is the only pass over the whole database. The pages of the
+    // dropped table are zeroed rather than vacuumed away, and cost next to nothing once compressed.
+    auto snapshot_dir = bpt::temporary_dir::create();
+    auto snapshot     = snapshot_dir.path() / "repo.db";
+    db_exec(_prepare("VACUUM INTO ?"_sql), snapshot.string()).value();
+    {
+        auto snapshot_db = unique_database::open_existing(snapshot.string()).value();
+        snapshot_db.exec_script(R"(
+            PRAGMA secure_delete = ON;
+            DROP TABLE crs_repo_changes;
+        )"_sql);
+    }
+    bpt::compress_file_gz(snapshot, _dirpath / "repo.db.gz").value();
 }
 
 repository repository::create(path_ref dirpath, std::string_view name) {
@@ -107,6 +203,8 @@ repository repository::create(path_ref dirpath, std::string_view name) {
     };
     auto r = repository{std::move(db), dirpath};
     r._vacuum_and_compress();
+    r._publish_log();
+    r._publish_index_config();
     return r;
 }
 
@@ -121,6 +219,142 @@ neo::sqlite3::statement& repository::_prepare(neo::sqlite3::sql_string_literal s
     return _db.prepare(sql);
 }
 
+std::int64_t repository::revno() const {
+    return db_cell<std::int64_t>(_prepare("SELECT revno FROM crs_repo_self"_sql)).value();
+}
+
+void repository::_log_change(std::string_view action, std::string_view meta_json) {
+    db_exec(_prepare("INSERT INTO crs_repo_changes (action, meta_json) VALUES (?, ?)"_sql),
+            action,
+            meta_json)
+        .value();
+    db_exec(_prepare(R"(
+                UPDATE crs_repo_self
+                   SET revno = (SELECT max(revno) FROM crs_repo_changes)
+            )"_sql))
+        .value();
+}
+
+void repository::_publish_log() const {
+    auto log_dir = _dirpath / "repo-log";
+    fs::create_directories(log_dir);
+    auto compacted
+        = db_cell<std::int64_t>(_prepare("SELECT compacted_revno FROM crs_repo_self"_sql)).value();
+    auto head_revno = revno();
+
+    // A page never changes once it is full, so only the pages that have gained entries since the
+    // head was last published need to be written. They are all written before the head, so a
+    // client that sees the new head will find every entry it names.
+    std::int64_t published = 0;
+    if (auto prior = read_published_head(log_dir / "head.json")) {
+        published = (std::min)(*prior, head_revno);
+    }
+    std::map<std::int64_t, nlohmann::json> pages;
+
+    auto& entries_st = _prepare(R"(
+        SELECT revno, action, meta_json
+          FROM crs_repo_changes
+         WHERE revno > ?
+         ORDER BY revno
+    )"_sql);
+    for (auto [entry_revno, action, meta_json] :
+         db_query<std::int64_t, std::string_view, std::string_view>(
+             entries_st,
+             published / log_page_size * log_page_size)) {
+        auto& page = pages[log_page_of(entry_revno)];
+        page["entries"].push_back({
+            {"revno", entry_revno},
+            {"action", action},
+            {"package", nlohmann::json::parse(meta_json)},
+        });
+    }
+    entries_st.reset();
+    for (auto& [page_no, page] : pages) {
+        publish_file(log_dir / neo::ufmt("page-{}.json", page_no), page.dump());
+    }
+
+    // Drop the pages that have been compacted away, as well as anything that is not a page
+    auto first_page = log_page_of(compacted + 1);
+    for (auto& file : fs::directory_iterator{log_dir}) {
+        auto name = file.path().filename().string();
+        if (name == "head.json") {
+            continue;
+        }
+        auto page_no = parse_log_page_name(name);
+        if (!page_no || *page_no < first_page) {
+            ensure_absent(file.path()).value();
+        }
+    }
+
+    nlohmann::json head = {
+        {"revno", head_revno},
+        {"oldest", compacted + 1},
+        {"page-size", log_page_size},
+    };
+    publish_file(log_dir / "head.json", head.dump());
+}
+
+void repository::_publish_index(std::string_view name) const {
+    auto  dest = index_dir() / neo::ufmt("{}.json", name);
+    auto  pkgs = nlohmann::json::array();
+    auto& st   = _prepare(R"(
+        SELECT meta_json FROM crs_repo_packages
+         WHERE name = ?
+         ORDER BY package_id
+    )"_sql);
+    for (auto [meta_json] : db_query<std::string_view>(st, name)) {
+        pkgs.push_back(nlohmann::json::parse(meta_json));
+    }
+    if (pkgs.empty()) {
+        ensure_absent(dest).value();
+        return;
+    }
+    fs::create_directories(index_dir());
+    publish_file(dest, nlohmann::json{{"packages", std::move(pkgs)}}.dump());
+}
+
+void repository::_ensure_index() const {
+    if (fs::exists(index_dir() / "config.json")) {
+        return;
+    }
+    // Repositories from older versions of bpt have no index. Write it once, in full.
+    bpt_log(debug, "Writing the package index of repository [{}]", _dirpath.string());
+    std::vector<std::string> names;
+    for (auto [name] :
+         db_query<std::string>(_prepare("SELECT DISTINCT name FROM crs_repo_packages"_sql))) {
+        names.push_back(name);
+    }
+    for (auto& name : names) {
+        _publish_index(name);
+    }
+    _publish_index_config();
+}
+
+void repository::_publish_index_config() const {
+    fs::create_directories(index_dir());
+    publish_file(index_dir() / "config.json", nlohmann::json{{"name", name()}}.dump());
+}
+
+void repository::compact_log(std::int64_t keep) {
+    neo::sqlite3::transaction_guard tr{_db.sqlite3_db()};
+    auto                            head = revno();
+    db_exec(_prepare(R"(
+                UPDATE crs_repo_self
+                   SET compacted_revno = max(compacted_revno, ?1)
+            )"_sql),
+            head - (std::max)(keep, std::int64_t(0)))
+        .value();
+    db_exec(_prepare(R"(
+                DELETE FROM crs_repo_changes
+                 WHERE revno <= (SELECT compacted_revno FROM crs_repo_self)
+            )"_sql))
+        .value();
+    tr.commit();
+    _vacuum_and_compress();
+    _publish_log();
+    _ensure_index();
+}
+
 std::string repository::name() const {
     return db_cell<std::string>(_prepare("SELECT name FROM crs_repo_self WHERE rowid=1729"_sql))
         .value();
@@ -167,11 +401,15 @@ void repository::import_dir(path_ref dirpath) {
     bpt_leaf_catch(matchv<neo::sqlite3::errc::constraint_unique>) {
         BOOST_LEAF_THROW_EXCEPTION(current_error(), e_repo_import_pkg_already_present{});
     };
+    _log_change("add", pkg.to_json());
 
     move_file(tmp_tgz, dest_dir / "pkg.tgz").value();
     bpt::copy_file(prep_dir.path() / "pkg.json", dest_dir / "pkg.json").value();
     tr.commit();
     _vacuum_and_compress();
+    _publish_log();
+    _ensure_index();
+    _publish_index(pkg.id.name.str);
 
     NEO_EMIT(ev_repo_imported_package{*this, dirpath, pkg});
 }
@@ -187,7 +425,8 @@ neo::any_input_range<package_info> repository::all_packages() const {
 }
 
 void repository::remove_pkg(const package_info& meta) {
-    auto to_delete = subdir_of(meta);
+    auto                            to_delete = subdir_of(meta);
+    neo::sqlite3::transaction_guard tr{_db.sqlite3_db()};
     db_exec(_prepare(R"(
                 DELETE FROM crs_repo_packages
                  WHERE name = ?1
@@ -199,5 +438,18 @@ void repository::remove_pkg(const package_info& meta) {
             meta.id.version.to_string(),
             meta.id.revision)
         .value();
+    if (_db.sqlite3_db().changes() != 0) {
+        nlohmann::json removed = {
+            {"name", meta.id.name.str},
+            {"version", meta.id.version.to_string()},
+            {"pkg-version", meta.id.revision},
+        };
+        _log_change("remove", removed.dump());
+    }
     ensure_absent(to_delete).value();
+    tr.commit();
+    _vacuum_and_compress();
+    _publish_log();
+    _ensure_index();
+    _publish_index(meta.id.name.str);
 }
@@ -23,6 +23,12 @@ class repository {
         , _dirpath(dirpath) {}
 
     void _vacuum_and_compress() const;
+    void _log_change(std::string_view action, std::string_view meta_json);
+    void _publish_log() const;
+    void _publish_index(std::string_view name) const;
+    void _publish_index_config() const;
+    /// Write the whole index if the repository does not have one yet
+    void _ensure_index() const;
 
 public:
     static repository create(const std::filesystem::path& directory, std::string_view name);
@@ -31,6 +37,12 @@ public:
     std::filesystem::path subdir_of(const package_info&) const noexcept;
 
     auto        pkg_dir() const noexcept { return _dirpath / "pkg"; }
+    /**
+     * @brief The directory of the sparse package index. "index/<name>.json" holds the metadata of
+     * every package with that name, and "index/config.json" names the repository. Clients that
+     * use the index fetch only the names that they need, rather than the whole database.
+     */
+    auto        index_dir() const noexcept { return _dirpath / "index"; }
     auto&       root() const noexcept { return _dirpath; }
     std::string name() const;
 
@@ -39,6 +51,25 @@ public:
 
     void remove_pkg(const package_info&);
 
+    /**
+     * @brief The revision of the most recent change to the packages in the repository.
+     *
+     * Every import and removal is recorded in a change log, which is published beside the
+     * repository database in pages of consecutive entries, "repo-log/page-<N>.json".
+     * "repo-log/head.json" names the newest revision, the oldest one that is still in the log,
+     * and the number of entries in a page, so that clients which have seen an earlier revision
+     * can fetch only the pages that hold what has changed since.
+     */
+    std::int64_t revno() const;
+
+    /**
+     * @brief Drop all but the newest `keep` entries from the change log.
+     *
+     * Clients that are further behind than the remaining entries will download the full
+     * repository database instead.
+     */
+    void compact_log(std::int64_t keep);
+
     neo::any_input_range<package_info> all_packages() const;
 };
 
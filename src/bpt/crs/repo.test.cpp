@@ -4,13 +4,19 @@
 #include <bpt/crs/error.hpp>
 #include <bpt/error/try_catch.hpp>
 #include <bpt/temp.hpp>
+#include <bpt/util/compress.hpp>
+#include <bpt/util/db/query.hpp>
+#include <bpt/util/fs/io.hpp>
+#include <bpt/util/json5/parse.hpp>
 
 #include <catch2/catch.hpp>
 #include <neo/ranges.hpp>
+#include <nlohmann/json.hpp>
 
 #include <filesystem>
 
 namespace fs = std::filesystem;
+using namespace neo::sqlite3::literals;
 
 TEST_CASE("Init repo") {
     auto tempdir = bpt::temporary_dir::create();
@@ -64,3 +70,110 @@ TEST_CASE_METHOD(empty_repo, "Import a simple packages") {
     CHECK(third.id.version.to_string() == "1.3.0");
     CHECK(third.id.revision == 2);
 }
+
+TEST_CASE_METHOD(empty_repo, "Changes are recorded in the change log") {
+    auto log_dir = repo.root() / "repo-log";
+    CHECK(repo.revno() == 0);
+    CHECK(fs::is_regular_file(log_dir / "head.json"));
+
+    REQUIRES_LEAF_NOFAIL(repo.import_dir(bpt::testing::DATA_DIR / "simple.crs"));
+    REQUIRES_LEAF_NOFAIL(repo.import_dir(bpt::testing::DATA_DIR / "simple2.crs"));
+    CHECK(repo.revno() == 2);
+    auto page = bpt::parse_json_file(log_dir / "page-0.json");
+    REQUIRE(page["entries"].size() == 2);
+    CHECK(page["entries"][1]["revno"] == 2);
+    CHECK(page["entries"][1]["action"] == "add");
+    CHECK(page["entries"][1]["package"]["version"] == "1.3.0");
+
+    auto all = REQUIRES_LEAF_NOFAIL(repo.all_packages() | neo::to_vector);
+    REQUIRES_LEAF_NOFAIL(repo.remove_pkg(all.front()));
+    CHECK(repo.revno() == 3);
+    page = bpt::parse_json_file(log_dir / "page-0.json");
+    REQUIRE(page["entries"].size() == 3);
+    CHECK(page["entries"][2]["action"] == "remove");
+    CHECK(page["entries"][2]["package"]["version"] == "1.2.43");
+
+    auto head = bpt::parse_json_file(log_dir / "head.json");
+    CHECK(head["revno"] == 3);
+    CHECK(head["oldest"] == 1);
+    CHECK(head["page-size"] == 64);
+
+    // Compaction drops the oldest entries, but revisions are never reused
+    REQUIRES_LEAF_NOFAIL(repo.compact_log(1));
+    CHECK(repo.revno() == 3);
+    head = bpt::parse_json_file(log_dir / "head.json");
+    CHECK(head["oldest"] == 3);
+
+    REQUIRES_LEAF_NOFAIL(repo.compact_log(0));
+    CHECK(repo.revno() == 3);
+    REQUIRES_LEAF_NOFAIL(repo.import_dir(bpt::testing::DATA_DIR / "simple3.crs"));
+    CHECK(repo.revno() == 4);
+    head = bpt::parse_json_file(log_dir / "head.json");
+    CHECK(head["revno"] == 4);
+    CHECK(head["oldest"] == 4);
+    // The page only holds what remains of the log
+    page = bpt::parse_json_file(log_dir / "page-0.json");
+    REQUIRE(page["entries"].size() == 1);
+    CHECK(page["entries"][0]["revno"] == 4);
+}
+
+TEST_CASE_METHOD(empty_repo, "Files that are not pages are removed from the change log") {
+    auto log_dir = repo.root() / "repo-log";
+    // Change logs were once published with a file for each entry
+    bpt::write_file(log_dir / "1.json", "{}");
+    REQUIRES_LEAF_NOFAIL(repo.import_dir(bpt::testing::DATA_DIR / "simple.crs"));
+    CHECK_FALSE(fs::exists(log_dir / "1.json"));
+    CHECK(fs::is_regular_file(log_dir / "page-0.json"));
+    CHECK(fs::is_regular_file(log_dir / "head.json"));
+}
+
+TEST_CASE_METHOD(empty_repo, "The published database leaves out the change log") {
+    REQUIRES_LEAF_NOFAIL(repo.import_dir(bpt::testing::DATA_DIR / "simple.crs"));
+    REQUIRES_LEAF_NOFAIL(repo.import_dir(bpt::testing::DATA_DIR / "simple2.crs"));
+
+    auto tdir     = bpt::temporary_dir::create();
+    auto snapshot = tdir.path() / "repo.db";
+    REQUIRES_LEAF_NOFAIL(bpt::decompress_file_gz(repo.root() / "repo.db.gz", snapshot).value());
+    auto db = REQUIRES_LEAF_NOFAIL(bpt::unique_database::open_existing(snapshot.string()).value());
+    auto n_log_tables = REQUIRES_LEAF_NOFAIL(bpt::db_cell<std::int64_t>(db.prepare(R"(
+        SELECT count(*) FROM sqlite_master WHERE name = 'crs_repo_changes'
+    )"_sql)).value());
+    CHECK(n_log_tables == 0);
+    auto revno = REQUIRES_LEAF_NOFAIL(
+        bpt::db_cell<std::int64_t>(db.prepare("SELECT revno FROM crs_repo_self"_sql)).value());
+    CHECK(revno == 2);
+}
+
+TEST_CASE_METHOD(empty_repo, "Packages are published in the sparse index") {
+    auto config = bpt::parse_json_file(repo.index_dir() / "config.json");
+    CHECK(config["name"] == "test");
+
+    REQUIRES_LEAF_NOFAIL(repo.import_dir(bpt::testing::DATA_DIR / "simple.crs"));
+    REQUIRES_LEAF_NOFAIL(repo.import_dir(bpt::testing::DATA_DIR / "simple2.crs"));
+    auto index = bpt::parse_json_file(repo.index_dir() / "test-pkg.json");
+    REQUIRE(index["packages"].size() == 2);
+    CHECK(index["packages"][0]["version"] == "1.2.43");
+    CHECK(index["packages"][1]["version"] == "1.3.0");
+
+    auto all = REQUIRES_LEAF_NOFAIL(repo.all_packages() | neo::to_vector);
+    for (auto& pkg : all) {
+        REQUIRES_LEAF_NOFAIL(repo.remove_pkg(pkg));
+    }
+    CHECK_FALSE(fs::exists(repo.index_dir() / "test-pkg.json"));
+}
+
+TEST_CASE_METHOD(empty_repo, "A missing index is written when the repository is modified") {
+    REQUIRES_LEAF_NOFAIL(repo.import_dir(bpt::testing::DATA_DIR / "simple.crs"));
+    // Repositories from older versions of bpt have no index
+    fs::remove_all(repo.index_dir());
+
+    // Only reading the repository leaves it as it is
+    auto reopened = REQUIRES_LEAF_NOFAIL(bpt::crs::repository::open_existing(repo.root()));
+    CHECK(REQUIRES_LEAF_NOFAIL(reopened.all_packages() | neo::to_vector).size() == 1);
+    CHECK_FALSE(fs::exists(reopened.index_dir()));
+
+    REQUIRES_LEAF_NOFAIL(reopened.import_dir(bpt::testing::DATA_DIR / "simple2.crs"));
+    CHECK(fs::is_regular_file(reopened.index_dir() / "config.json"));
+    auto index = bpt::parse_json_file(reopened.index_dir() / "test-pkg.json");
+    CHECK(index["packages"].size() == 2);
+}
@@ -10,6 +10,7 @@
 #include <neo/sqlite3/statement.hpp>
 #include <neo/sqlite3/transaction.hpp>
 
+#include <boost/leaf/exception.hpp>
 #include <nlohmann/json.hpp>
 #include <range/v3/range/conversion.hpp>
 #include <range/v3/view/transform.hpp>
@@ -23,8 +24,15 @@ using namespace std::literals;
 
 namespace {
 
+/// The version of the database schema. Databases with any other version are migrated on open.
+constexpr auto cur_version = "alpha-6-dev3"sv;
+
 void migrate_1(nsql::connection& db) {
     db.exec(R"(
+        DROP TABLE IF EXISTS bpt_step_timings;
+        DROP TABLE IF EXISTS bpt_build_runs;
+        DROP TABLE IF EXISTS bpt_step_fingerprints;
+        DROP TABLE IF EXISTS bpt_output_digests;
         DROP TABLE IF EXISTS bpt_deps;
         DROP TABLE IF EXISTS bpt_file_commands;
         DROP TABLE IF EXISTS bpt_files;
@@ -56,6 +64,38 @@ void migrate_1(nsql::connection& db) {
             input_mtime INTEGER NOT NULL,
             UNIQUE(input_file_id, output_file_id)
         );
+        CREATE TABLE bpt_output_digests (
+            file_id
+                INTEGER NOT NULL
+                PRIMARY KEY REFERENCES bpt_source_files(file_id),
+            digest INTEGER NOT NULL
+        );
+        CREATE TABLE bpt_step_fingerprints (
+            file_id
+                INTEGER NOT NULL
+                REFERENCES bpt_source_files(file_id),
+            step TEXT NOT NULL,
+            fingerprint INTEGER NOT NULL,
+            UNIQUE(file_id, step)
+        );
+        CREATE TABLE bpt_build_runs (
+            run_id INTEGER PRIMARY KEY,
+            -- Milliseconds since the Unix epoch
+            started_at INTEGER NOT NULL
+        );
+        CREATE TABLE bpt_step_timings (
+            run_id
+                INTEGER NOT NULL
+                REFERENCES bpt_build_runs(run_id) ON DELETE CASCADE,
+            file_id
+                INTEGER NOT NULL
+                REFERENCES bpt_source_files(file_id),
+            step TEXT NOT NULL,
+            -- The qualified name of the library that the step belongs to
+            owner TEXT NOT NULL,
+            duration INTEGER NOT NULL,
+            UNIQUE(run_id, file_id, step)
+        );
     )")
         .throw_if_error();
 }
@@ -74,7 +114,6 @@ void ensure_migrated(nsql::connection& db) {
     auto version_st  = *db.prepare("SELECT version FROM bpt_meta_1");
     auto version_str = *nsql::one_cell<std::string>(version_st);
 
-    const auto cur_version = "alpha-5-dev1"sv;
     if (cur_version != version_str) {
         if (!version_str.empty()) {
             bpt_log(info, "NOTE: A prior version of the project build database was found.");
@@ -113,6 +152,19 @@ database database::open(const std::string& db_path) {
     return database(std::move(db));
 }
 
+database database::open_readonly(path_ref db_path) {
+    auto db = *nsql::connection::open(db_path.string(), nsql::openmode::readonly);
+    // A database that predates the version table has no version at all
+    std::string version_str;
+    if (auto version_st = db.prepare("SELECT version FROM bpt_meta_1"); version_st.has_value()) {
+        version_str = *nsql::one_cell<std::string>(*version_st);
+    }
+    if (version_str != cur_version) {
+        BOOST_LEAF_THROW_EXCEPTION(e_build_db_version{version_str});
+    }
+    return database(std::move(db));
+}
+
 database::database(nsql::connection db)
     : _db(std::move(db)) {}
 
@@ -135,6 +187,7 @@ std::int64_t database::_record_file(path_ref path_) {
 }
 
 void database::record_dep(path_ref input, path_ref output, fs::file_time_type input_mtime) {
+    std::unique_lock lk{_mutex};
     auto  in_id  = _record_file(input);
     auto  out_id = _record_file(output);
     auto& st     = _stmt_cache(R"(
@@ -145,6 +198,7 @@ void database::record_dep(path_ref input, path_ref output, fs::file_time_type in
 }
 
 void database::record_compilation(path_ref file, const completed_compilation& cmd) {
+    std::unique_lock lk{_mutex};
     auto file_id = _record_file(file);
 
     auto& st = _stmt_cache(R"(
@@ -175,6 +229,7 @@ void database::record_compilation(path_ref file, const completed_compilation& cm
 }
 
 void database::forget_inputs_of(path_ref file) {
+    std::unique_lock lk{_mutex};
     auto& st = _stmt_cache(R"(
         WITH id_to_delete AS (
             SELECT file_id
@@ -188,7 +243,8 @@ void database::forget_inputs_of(path_ref file) {
 }
 
 std::optional<std::vector<input_file_info>> database::inputs_of(path_ref file_) const {
-    auto  file = fs::weakly_canonical(file_);
+    std::unique_lock lk{_mutex};
+    auto             file = fs::weakly_canonical(file_);
     auto& st   = _stmt_cache(R"(
         WITH file AS (
             SELECT file_id
@@ -217,7 +273,8 @@ std::optional<std::vector<input_file_info>> database::inputs_of(path_ref file_)
 }
 
 std::optional<completed_compilation> database::command_of(path_ref file_) const {
-    auto  file = fs::weakly_canonical(file_);
+    std::unique_lock lk{_mutex};
+    auto             file = fs::weakly_canonical(file_);
     auto& st   = _stmt_cache(R"(
         WITH file AS (
             SELECT file_id
@@ -237,3 +294,220 @@ std::optional<completed_compilation> database::command_of(path_ref file_) const
     auto& [cmd, out, dur, tc_id] = *opt_res;
     return completed_compilation{cmd, out, tc_id, std::chrono::milliseconds(dur)};
 }
+
+void database::record_output_digest(path_ref file, std::uint64_t digest) {
+    std::unique_lock lk{_mutex};
+    auto             file_id = _record_file(file);
+    auto&            st      = _stmt_cache(R"(
+        INSERT OR REPLACE INTO bpt_output_digests (file_id, digest)
+        VALUES (?, ?)
+    )"_sql);
+    nsql::exec(st, file_id, static_cast<std::int64_t>(digest)).throw_if_error();
+}
+
+std::optional<std::uint64_t> database::output_digest_of(path_ref file_) const {
+    std::unique_lock lk{_mutex};
+    auto             file = fs::weakly_canonical(file_);
+    auto&            st   = _stmt_cache(R"(
+        SELECT digest
+          FROM bpt_output_digests
+          JOIN bpt_source_files USING (file_id)
+         WHERE path = ?
+    )"_sql);
+    st.reset();
+    st.bindings()[1] = file.generic_string();
+    auto opt_res     = nsql::next<std::int64_t>(st);
+    if (opt_res.errc() == nsql::errc::done) {
+        return std::nullopt;
+    }
+    auto [digest] = *opt_res;
+    return static_cast<std::uint64_t>(digest);
+}
+
+void database::record_step_fingerprint(path_ref         output,
+                                       std::string_view step,
+                                       std::uint64_t    fingerprint) {
+    std::unique_lock lk{_mutex};
+    auto             file_id = _record_file(output);
+    auto&            st      = _stmt_cache(R"(
+        INSERT OR REPLACE INTO bpt_step_fingerprints (file_id, step, fingerprint)
+        VALUES (?, ?, ?)
+    )"_sql);
+    nsql::exec(st, file_id, step, static_cast<std::int64_t>(fingerprint)).throw_if_error();
+}
+
+std::optional<std::uint64_t> database::step_fingerprint_of(path_ref         output_,
+                                                           std::string_view step) const {
+    std::unique_lock lk{_mutex};
+    auto             output = fs::weakly_canonical(output_);
+    auto&            st     = _stmt_cache(R"(
+        SELECT fingerprint
+          FROM bpt_step_fingerprints
+          JOIN bpt_source_files USING (file_id)
+         WHERE path = ? AND step = ?
+    )"_sql);
+    st.reset();
+    st.bindings()[1] = output.generic_string();
+    st.bindings()[2] = step;
+    auto opt_res     = nsql::next<std::int64_t>(st);
+    if (opt_res.errc() == nsql::errc::done) {
+        return std::nullopt;
+    }
+    auto [fingerprint] = *opt_res;
+    return static_cast<std::uint64_t>(fingerprint);
+}
+
+void database::record_step_timing(path_ref                  output,
+                                  std::string_view          step,
+                                  std::string_view          owner,
+                                  std::chrono::milliseconds duration) {
+    std::unique_lock lk{_mutex};
+    if (!_current_run_id) {
+        // This is the first step to finish in this build
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch());
+        auto& st = _stmt_cache(R"(
+            INSERT INTO bpt_build_runs (started_at) VALUES (?) RETURNING run_id
+        )"_sql);
+        auto [run_id]   = *nsql::one_row<std::int64_t>(st, now.count());
+        _current_run_id = run_id;
+        // Only keep the history of the most recent builds
+        auto& prune = _stmt_cache("DELETE FROM bpt_build_runs WHERE run_id <= ? - ?"_sql);
+        nsql::exec(prune, run_id, max_recorded_runs).throw_if_error();
+    }
+    auto  file_id = _record_file(output);
+    auto& st      = _stmt_cache(R"(
+        INSERT OR REPLACE INTO bpt_step_timings (run_id, file_id, step, owner, duration)
+        VALUES (?, ?, ?, ?, ?)
+    )"_sql);
+    nsql::exec(st, *_current_run_id, file_id, step, owner, std::int64_t(duration.count()))
+        .throw_if_error();
+}
+
+std::vector<step_timing_history> database::step_timings(std::string_view step) const {
+    std::unique_lock lk{_mutex};
+    auto&            st = _stmt_cache(R"(
+        WITH ranked AS (
+            SELECT file_id,
+                   owner,
+                   duration,
+                   row_number() OVER (PARTITION BY file_id ORDER BY run_id DESC) AS nth
+              FROM bpt_step_timings
+             WHERE step = ?
+        )
+        SELECT path,
+               max(CASE WHEN nth = 1 THEN owner END),
+               max(CASE WHEN nth = 1 THEN duration END) AS latest,
+               coalesce(max(CASE WHEN nth = 2 THEN duration END), -1),
+               CAST(avg(duration) AS INTEGER),
+               min(duration),
+               max(duration),
+               count(*)
+          FROM ranked
+          JOIN bpt_source_files USING (file_id)
+         GROUP BY file_id
+         ORDER BY latest DESC, path
+    )"_sql);
+    st.reset();
+    st.bindings()[1] = step;
+    using std::chrono::milliseconds;
+    std::vector<step_timing_history> ret;
+    for (auto [path, owner, latest, previous, avg, min, max, n_runs] :
+         nsql::iter_tuples<std::string,
+                           std::string,
+                           std::int64_t,
+                           std::int64_t,
+                           std::int64_t,
+                           std::int64_t,
+                           std::int64_t,
+                           std::int64_t>(st)) {
+        ret.push_back(step_timing_history{
+            .output   = path,
+            .owner    = owner,
+            .latest   = milliseconds(latest),
+            .previous = previous < 0 ? std::nullopt : std::optional(milliseconds(previous)),
+            .average  = milliseconds(avg),
+            .fastest  = milliseconds(min),
+            .slowest  = milliseconds(max),
+            .n_runs   = static_cast<int>(n_runs),
+        });
+    }
+    return ret;
+}
+
+std::vector<build_run_totals> database::run_totals() const {
+    std::unique_lock lk{_mutex};
+    auto&            st = _stmt_cache(R"(
+        SELECT run_id, started_at, step, sum(duration), count(*)
+          FROM bpt_step_timings
+          JOIN bpt_build_runs USING (run_id)
+         GROUP BY run_id, step
+         ORDER BY run_id, step
+    )"_sql);
+    st.reset();
+    std::vector<build_run_totals> ret;
+    for (auto [run_id, started_at, step, total, n_steps] :
+         nsql::iter_tuples<std::int64_t, std::int64_t, std::string, std::int64_t, std::int64_t>(
+             st)) {
+        if (ret.empty() || ret.back().run_id != run_id) {
+            ret.push_back(build_run_totals{
+                .run_id     = run_id,
+                .started_at = std::chrono::system_clock::time_point(
+                    std::chrono::milliseconds(started_at)),
+                .steps      = {},
+            });
+        }
+        ret.back().steps.push_back(
+            {.step = step, .total = std::chrono::milliseconds(total), .count = int(n_steps)});
+    }
+    return ret;
+}
+
+std::vector<input_impact> database::input_impacts() const {
+    std::unique_lock lk{_mutex};
+    auto&            st = _stmt_cache(R"(
+        SELECT input.path, count(*), sum(coalesce(comp.avg_duration, 0)) AS cost
+          FROM bpt_compile_deps AS deps
+          JOIN bpt_source_files AS input ON input.file_id = deps.input_file_id
+          LEFT JOIN bpt_compilations AS comp ON comp.file_id = deps.output_file_id
+         GROUP BY deps.input_file_id
+         ORDER BY cost DESC, input.path
+    )"_sql);
+    st.reset();
+    std::vector<input_impact> ret;
+    for (auto [path, n_dependents, cost] :
+         nsql::iter_tuples<std::string, std::int64_t, std::int64_t>(st)) {
+        ret.push_back(input_impact{
+            .input        = path,
+            .n_dependents = static_cast<int>(n_dependents),
+            .rebuild_cost = std::chrono::milliseconds(cost),
+        });
+    }
+    return ret;
+}
+
+std::vector<compilation_inputs> database::all_compilation_inputs() const {
+    std::unique_lock lk{_mutex};
+    auto&            st = _stmt_cache(R"(
+        SELECT output.path, coalesce(comp.avg_duration, 0), input.path
+          FROM bpt_compile_deps AS deps
+          JOIN bpt_source_files AS output ON output.file_id = deps.output_file_id
+          JOIN bpt_source_files AS input ON input.file_id = deps.input_file_id
+          LEFT JOIN bpt_compilations AS comp ON comp.file_id = deps.output_file_id
+         ORDER BY output.path, input.path
+    )"_sql);
+    st.reset();
+    std::vector<compilation_inputs> ret;
+    for (auto [output, duration, input] :
+         nsql::iter_tuples<std::string, std::int64_t, std::string>(st)) {
+        if (ret.empty() || ret.back().output != output) {
+            ret.push_back(compilation_inputs{
+                .output       = output,
+                .avg_duration = std::chrono::milliseconds(duration),
+                .inputs       = {},
+            });
+        }
+        ret.back().inputs.push_back(input);
+    }
+    return ret;
+}
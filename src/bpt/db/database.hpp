@@ -12,7 +12,9 @@
 #include <mutex>
 #include <optional>
 #include <shared_mutex>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace bpt {
 
@@ -29,11 +31,75 @@ struct input_file_info {
     fs::file_time_type prev_mtime;
 };
 
+/**
+ * @brief The recorded durations of one build step for one output, across recent builds
+ */
+struct step_timing_history {
+    fs::path output;
+    /// The qualified name of the library that the step belongs to
+    std::string               owner;
+    std::chrono::milliseconds latest;
+    /// The duration from the build before the latest one, if the step ran then
+    std::optional<std::chrono::milliseconds> previous;
+    std::chrono::milliseconds                average;
+    std::chrono::milliseconds                fastest;
+    std::chrono::milliseconds                slowest;
+    /// The number of recorded builds in which the step ran
+    int n_runs;
+};
+
+/**
+ * @brief The cost of touching a file that compilations depend on
+ */
+struct input_impact {
+    fs::path input;
+    /// The number of outputs that depend on the file
+    int n_dependents;
+    /// The sum of the average compile durations of those outputs
+    std::chrono::milliseconds rebuild_cost;
+};
+
+/**
+ * @brief The recorded inputs of a single compilation
+ */
+struct compilation_inputs {
+    fs::path                  output;
+    std::chrono::milliseconds avg_duration;
+    std::vector<fs::path>     inputs;
+};
+
+/**
+ * @brief The total time spent in each kind of build step during a single build
+ */
+struct build_run_totals {
+    struct step_total {
+        std::string               step;
+        std::chrono::milliseconds total;
+        int                       count;
+    };
+
+    std::int64_t                          run_id;
+    std::chrono::system_clock::time_point started_at;
+    std::vector<step_total>               steps;
+};
+
+/**
+ * @brief The version of a build database that was written by an incompatible version of bpt
+ */
+struct e_build_db_version {
+    std::string value;
+};
+
 class database {
     neo::sqlite3::connection              _db;
     mutable neo::sqlite3::statement_cache _stmt_cache{_db};
 
     std::map<fs::path, std::int64_t> _stored_file_ids_cache;
+    /// The build run that step timings are being recorded into, once one has been started
+    std::optional<std::int64_t> _current_run_id;
+
+    /// Serializes access from the parallel archive/link/test stages
+    mutable std::mutex _mutex;
 
     explicit database(neo::sqlite3::connection db);
     database(const database&) = delete;
@@ -43,6 +109,12 @@ class database {
 public:
     static database open(const std::string& db_path);
     static database open(path_ref db_path) { return open(db_path.string()); }
+    /**
+     * @brief Open an existing database only to read from it. Unlike `open()`, this never upgrades
+     * or replaces the database. Throws `e_build_db_version` if it was written by an incompatible
+     * version of bpt.
+     */
+    static database open_readonly(path_ref db_path);
 
     neo::sqlite3::transaction_guard transaction() noexcept {
         return neo::sqlite3::transaction_guard(_db);
@@ -54,6 +126,33 @@ public:
 
     std::optional<std::vector<input_file_info>> inputs_of(path_ref file) const;
     std::optional<completed_compilation>        command_of(path_ref file) const;
+
+    void                         record_output_digest(path_ref file, std::uint64_t digest);
+    std::optional<std::uint64_t> output_digest_of(path_ref file) const;
+
+    void record_step_fingerprint(path_ref output, std::string_view step, std::uint64_t fingerprint);
+    std::optional<std::uint64_t> step_fingerprint_of(path_ref output, std::string_view step) const;
+
+    /// The number of builds for which step timings are retained
+    static constexpr int max_recorded_runs = 20;
+
+    /**
+     * @brief Record how long a build step (e.g. "compile", "link", "test") took for an output. The
+     * first timing recorded through this database starts a new build run in the history.
+     */
+    void record_step_timing(path_ref                  output,
+                            std::string_view          step,
+                            std::string_view          owner,
+                            std::chrono::milliseconds duration);
+    /// Obtain the timing history of every output of the given step, slowest (latest) first
+    std::vector<step_timing_history> step_timings(std::string_view step) const;
+    /// Obtain the total time spent in each step for each recorded build, oldest first
+    std::vector<build_run_totals> run_totals() const;
+
+    /// Obtain the rebuild impact of every recorded compilation input, most expensive first
+    std::vector<input_impact> input_impacts() const;
+    /// Obtain the recorded inputs of every compilation
+    std::vector<compilation_inputs> all_compilation_inputs() const;
 };
 
 }  // namespace bpt
\ No newline at end of file
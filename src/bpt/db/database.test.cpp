@@ -5,3 +5,71 @@
 using namespace std::literals;
 
 TEST_CASE("Create a database") { auto db = bpt::database::open(":memory:"s); }
+
+TEST_CASE("Record output digests and step fingerprints") {
+    auto db = bpt::database::open(":memory:"s);
+    CHECK_FALSE(db.output_digest_of("/foo/bar.o").has_value());
+    db.record_output_digest("/foo/bar.o", 0xdeadbeef'cafebabe);
+    CHECK(db.output_digest_of("/foo/bar.o") == 0xdeadbeef'cafebabe);
+
+    CHECK_FALSE(db.step_fingerprint_of("/foo/libbar.a", "archive").has_value());
+    db.record_step_fingerprint("/foo/libbar.a", "archive", 42);
+    CHECK(db.step_fingerprint_of("/foo/libbar.a", "archive") == 42u);
+    // Fingerprints are distinct for each step
+    CHECK_FALSE(db.step_fingerprint_of("/foo/libbar.a", "link").has_value());
+    db.record_step_fingerprint("/foo/libbar.a", "archive", 1729);
+    CHECK(db.step_fingerprint_of("/foo/libbar.a", "archive") == 1729u);
+}
+
+TEST_CASE("Record step timings") {
+    using namespace std::chrono_literals;
+    auto db = bpt::database::open(":memory:"s);
+    CHECK(db.step_timings("compile").empty());
+    CHECK(db.run_totals().empty());
+
+    db.record_step_timing("/foo/baz.o", "compile", "foo/foo", 300ms);
+    db.record_step_timing("/foo/bar.o", "compile", "foo/foo", 1200ms);
+    db.record_step_timing("/foo/app", "link", "foo/foo", 50ms);
+
+    auto compiles = db.step_timings("compile");
+    REQUIRE(compiles.size() == 2);
+    // The slowest comes first
+    CHECK(compiles[0].output == "/foo/bar.o");
+    CHECK(compiles[0].owner == "foo/foo");
+    CHECK(compiles[0].latest == 1200ms);
+    CHECK(compiles[0].n_runs == 1);
+    CHECK_FALSE(compiles[0].previous.has_value());
+
+    // Every timing from this database belongs to the same build
+    auto runs = db.run_totals();
+    REQUIRE(runs.size() == 1);
+    REQUIRE(runs[0].steps.size() == 2);
+    CHECK(runs[0].steps[0].step == "compile");
+    CHECK(runs[0].steps[0].total == 1500ms);
+    CHECK(runs[0].steps[0].count == 2);
+    CHECK(runs[0].steps[1].step == "link");
+}
+
+TEST_CASE("Compute the rebuild impact of compilation inputs") {
+    using namespace std::chrono_literals;
+    auto db  = bpt::database::open(":memory:"s);
+    auto now = bpt::fs::file_time_type::clock::now();
+    db.record_compilation("/foo/a.o", {"cc a.cpp", "", 0, 2000ms});
+    db.record_compilation("/foo/b.o", {"cc b.cpp", "", 0, 1000ms});
+    db.record_dep("/foo/a.cpp", "/foo/a.o", now);
+    db.record_dep("/foo/b.cpp", "/foo/b.o", now);
+    db.record_dep("/foo/common.hpp", "/foo/a.o", now);
+    db.record_dep("/foo/common.hpp", "/foo/b.o", now);
+
+    auto impacts = db.input_impacts();
+    REQUIRE(impacts.size() == 3);
+    CHECK(impacts[0].input == "/foo/common.hpp");
+    CHECK(impacts[0].n_dependents == 2);
+    CHECK(impacts[0].rebuild_cost == 3000ms);
+
+    auto comps = db.all_compilation_inputs();
+    REQUIRE(comps.size() == 2);
+    CHECK(comps[0].output == "/foo/a.o");
+    CHECK(comps[0].avg_duration == 2000ms);
+    CHECK(comps[0].inputs == std::vector<bpt::fs::path>{"/foo/a.cpp", "/foo/common.hpp"});
+}
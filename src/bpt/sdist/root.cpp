@@ -1,5 +1,7 @@
 #include "./root.hpp"
 
+#include <bpt/util/fs/dirscan.hpp>
+
 #include <neo/memory.hpp>
 #include <range/v3/view/filter.hpp>
 #include <range/v3/view/transform.hpp>
@@ -35,3 +37,14 @@ std::vector<source_file> source_root::collect_sources() const {
     // Collect all source files from the directory
     return bpt::collect_sources(path) | neo::to_vector;
 }
+
+std::vector<source_file> source_root::collect_sources(file_collector& fcoll) const {
+    std::vector<source_file> ret;
+    for (fs::path relpath : fcoll.collect(path)) {
+        auto sf = source_file::from_path(path / relpath, path);
+        if (sf.has_value()) {
+            ret.push_back(std::move(*sf));
+        }
+    }
+    return ret;
+}
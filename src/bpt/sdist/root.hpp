@@ -15,6 +15,8 @@ struct collected_sources : neo::any_range<source_file, std::input_iterator_tag>,
     using any_range::any_range;
 };
 
+class file_collector;
+
 collected_sources collect_sources(path_ref dirpath);
 
 /**
@@ -30,6 +32,12 @@ struct source_root {
      */
     std::vector<source_file> collect_sources() const;
 
+    /**
+     * Generate the same listing as `collect_sources()`, but use the given collector to reuse the
+     * cached listing of any part of the directory that has not been modified since its last scan.
+     */
+    std::vector<source_file> collect_sources(file_collector& fcoll) const;
+
     /**
      * Check if the directory exists
      */
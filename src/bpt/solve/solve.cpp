@@ -184,6 +184,8 @@ struct metadata_provider {
     packages_for_name(std::string_view name) const {
         auto found = pkgs_by_name.find(name);
         if (found == pkgs_by_name.end()) {
+            // Fetch the metadata for the name from sparse remotes, if we haven't yet
+            cache_db.sync_name(bpt::name{std::string(name)});
             found
                 = pkgs_by_name
                       .emplace(std::string(name),
@@ -378,9 +380,29 @@ void try_load_nonesuch_packages(boost::leaf::error_id           error,
 
 std::vector<crs::pkg_id> bpt::solve(crs::cache_db const&                  cache,
                                     neo::any_input_range<crs::dependency> deps_) {
-    metadata_provider provider{cache};
     auto deps = deps_ | stdv::transform(NEO_TL(requirement::from_crs_dep(_1))) | neo::to_vector;
-    auto sln  = bpt_leaf_try { return pubgrub::solve(deps, provider); }
+
+    auto try_solve = [&] {
+        metadata_provider provider{cache};
+        return pubgrub::solve(deps, provider);
+    };
+    auto sln = bpt_leaf_try {
+        // A deferred sync may be run by the provider partway through the solve, after which the
+        // listings it has already memoized are out-of-date. Such an attempt is made again.
+        auto generation = cache.sync_generation();
+        try {
+            auto attempt = try_solve();
+            if (cache.sync_generation() == generation) {
+                return attempt;
+            }
+        } catch (const solve_failure_exception&) {
+            // The cached metadata may be out-of-date. If we have not yet synced, do so and retry.
+            if (cache.sync_generation() == generation && !cache.sync_deferred()) {
+                throw;
+            }
+        }
+        return try_solve();
+    }
     bpt_leaf_catch(catch_<solve_failure_exception> exc)->noreturn_t {
         auto error = boost::leaf::new_error();
         try_load_nonesuch_packages(error, cache, deps);
@@ -284,6 +284,13 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
         }
     }
 
+    const bool gnu_deps_via_pipe = deps_mode_str == "gnu-pipe";
+#if _WIN32
+    if (gnu_deps_via_pipe) {
+        fail(context, "`deps_mode` ‘gnu-pipe’ is not supported on Windows");
+    }
+#endif
+
     const enum file_deps_mode deps_mode = [&] {
         if (!deps_mode_str.has_value()) {
             if (is_gnu_like) {
@@ -293,7 +300,7 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
             } else {
                 return file_deps_mode::none;
             }
-        } else if (deps_mode_str == "gnu") {
+        } else if (deps_mode_str == "gnu" || gnu_deps_via_pipe) {
             return file_deps_mode::gnu;
         } else if (deps_mode_str == "msvc") {
             return file_deps_mode::msvc;
@@ -508,7 +515,8 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
     };
 
     toolchain_prep tc;
-    tc.deps_mode = deps_mode;
+    tc.deps_mode         = deps_mode;
+    tc.gnu_deps_via_pipe = gnu_deps_via_pipe;
     tc.c_compile = read_opt(c_compile_file, [&] {
         string_seq c;
         if (compiler_launcher) {
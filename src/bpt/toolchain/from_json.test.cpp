@@ -61,6 +61,15 @@ TEST_CASE("Generating toolchain commands") {
         .link = "g++ -fPIC foo.o bar.a -pthread -omeow.exe",
     });
 
+    check_tc_compile(test{
+        .given         = "{compiler_id: 'gnu', advanced: {deps_mode: 'gnu-pipe'}}",
+        .compile       = "g++ -MD -MF /dev/fd/3 -MQ foo.o -c foo.cpp -ofoo.o -fPIC -pthread",
+        .with_warnings = "g++ -Wall -Wextra -Wpedantic -Wconversion -MD -MF /dev/fd/3 -MQ "
+                         "foo.o -c foo.cpp -ofoo.o -fPIC -pthread",
+        .ar   = "ar rcs stuff.a foo.o bar.o",
+        .link = "g++ -fPIC foo.o bar.a -pthread -omeow.exe",
+    });
+
     check_tc_compile(test{
         .given         = "{compiler_id: 'gnu', debug: true}",
         .compile       = "g++ -MD -MF foo.o.d -MQ foo.o -c foo.cpp -ofoo.o -g -fPIC -pthread",
@@ -311,3 +320,15 @@ TEST_CASE("Manipulate a toolchain and file compilation") {
                                       "-fPIC",
                                       "-pthread"});
 }
+
+TEST_CASE("Write GNU-style deps to a pipe") {
+    auto tc = bpt::parse_toolchain_json5("{compiler_id: 'gnu', advanced: {deps_mode: 'gnu-pipe'}}");
+
+    bpt::compile_file_spec cfs;
+    cfs.source_path = "foo.cpp";
+    cfs.out_path    = "foo.o";
+    auto cmd = tc.create_compile_command(cfs, bpt::fs::current_path(), bpt::toolchain_knobs{});
+    CHECK(tc.deps_mode() == bpt::file_deps_mode::gnu);
+    CHECK_FALSE(cmd.gnu_depfile_path.has_value());
+    CHECK(cmd.gnu_deps_fd == 3);
+}
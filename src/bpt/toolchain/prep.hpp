@@ -36,6 +36,8 @@ struct toolchain_prep {
     std::string exe_suffix;
 
     enum file_deps_mode deps_mode;
+    // Whether GNU-style deps should be written to a pipe rather than to a file on disk
+    bool gnu_deps_via_pipe = false;
 
     [[nodiscard]] toolchain realize() const;
 
@@ -48,6 +48,7 @@ toolchain toolchain::realize(const toolchain_prep& prep) {
     ret._exe_prefix          = prep.exe_prefix;
     ret._exe_suffix          = prep.exe_suffix;
     ret._deps_mode           = prep.deps_mode;
+    ret._gnu_deps_via_pipe   = prep.gnu_deps_via_pipe;
     ret._tty_flags           = prep.tty_flags;
 
     ret._c_source_type_flags   = prep.c_source_type_flags;
@@ -166,8 +167,18 @@ compile_command_info toolchain::create_compile_command(const compile_file_spec&
     }
 
     std::optional<fs::path> gnu_depfile_path;
+    std::optional<int>      gnu_deps_fd;
 
-    if (_deps_mode == file_deps_mode::gnu) {
+    if (_deps_mode == file_deps_mode::gnu && _gnu_deps_via_pipe) {
+        // The deps will be written to a pipe that is opened in the compiler process at this fd
+        gnu_deps_fd = 3;
+        extend(flags,
+               {"-MD"sv,
+                "-MF"sv,
+                "/dev/fd/3"sv,
+                "-MQ"sv,
+                std::string_view(spec.out_path.string())});
+    } else if (_deps_mode == file_deps_mode::gnu) {
         gnu_depfile_path = spec.out_path;
         gnu_depfile_path->replace_extension(gnu_depfile_path->extension().string() + ".d");
         extend(flags,
@@ -191,7 +202,7 @@ compile_command_info toolchain::create_compile_command(const compile_file_spec&
             command.push_back(arg);
         }
     }
-    return {std::move(command), std::move(gnu_depfile_path)};
+    return {std::move(command), std::move(gnu_depfile_path), gnu_deps_fd};
 }
 
 vector<string> toolchain::create_archive_command(const archive_spec& spec,
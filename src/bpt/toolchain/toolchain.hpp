@@ -37,6 +37,8 @@ struct compile_file_spec {
 struct compile_command_info {
     std::vector<std::string> command;
     std::optional<fs::path>  gnu_depfile_path;
+    /// If set, the compiler will write its GNU-style deps to this file descriptor instead of a file
+    std::optional<int> gnu_deps_fd;
 };
 
 struct archive_spec {
@@ -75,6 +77,7 @@ class toolchain {
     std::string _exe_suffix;
 
     enum file_deps_mode _deps_mode;
+    bool                _gnu_deps_via_pipe = false;
 
     std::uint64_t _hash = 0;
 
@@ -11,6 +11,7 @@
 #include <fmt/ranges.h>
 #include <range/v3/view/transform.hpp>
 
+#include <algorithm>
 #include <map>
 #include <stdexcept>
 #include <string_view>
@@ -31,6 +32,8 @@ lm::library& usage_requirement_map::add(lm::usage ident) {
     if (!did_insert) {
         BOOST_LEAF_THROW_EXCEPTION(e_dup_library_id{ident}, BPT_ERR_REF("dup-lib-name"));
     }
+    // The new library may complete closures that were computed without it
+    _cache = closure_cache{};
     return inserted->second;
 }
 
@@ -44,35 +47,83 @@ usage_requirement_map usage_requirement_map::from_lm_index(const lm::index& idx)
     return ret;
 }
 
-std::vector<fs::path> usage_requirement_map::link_paths(const lm::usage& key) const {
-    auto req = get(key);
-    if (!req) {
+const lm::library& usage_requirement_map::_get_or_throw(const lm::usage& key) const {
+    auto lib = get(key);
+    if (!lib) {
         BOOST_LEAF_THROW_EXCEPTION(e_nonesuch_library{key}, BPT_ERR_REF("unknown-usage"));
     }
-    std::vector<fs::path> ret;
-    if (req->linkable_path) {
-        ret.push_back(*req->linkable_path);
+    return *lib;
+}
+
+void usage_requirement_map::_collect_link_order(const lm::usage&                 key,
+                                                std::set<library_key>&           seen,
+                                                std::vector<const lm::library*>& postorder) const {
+    const auto& lib = _get_or_throw(key);
+    if (!seen.insert(key).second) {
+        return;
     }
-    for (const auto& dep : req->uses) {
-        extend(ret, link_paths(dep));
+    for (const auto& dep : lib.uses) {
+        _collect_link_order(dep, seen, postorder);
     }
-    for (const auto& link : req->links) {
-        extend(ret, link_paths(link));
+    for (const auto& link : lib.links) {
+        _collect_link_order(link, seen, postorder);
     }
-    return ret;
+    // Every dependency of `lib` is now in the list ahead of it
+    postorder.push_back(&lib);
 }
 
-std::vector<fs::path> usage_requirement_map::include_paths(const lm::usage& usage) const {
+const std::vector<fs::path>& usage_requirement_map::link_paths(const lm::usage& key) const {
+    std::unique_lock lk{_cache.mutex};
+    auto             found = _cache.link_paths.find(key);
+    if (found != _cache.link_paths.end()) {
+        return found->second;
+    }
+
+    std::set<library_key>           seen;
+    std::vector<const lm::library*> postorder;
+    _collect_link_order(key, seen, postorder);
+
+    // Reversing the postorder puts each library ahead of everything it depends on, which is the
+    // order that linkers resolve static archives in.
     std::vector<fs::path> ret;
-    auto                  lib = get(usage);
-    if (!lib) {
-        BOOST_LEAF_THROW_EXCEPTION(e_nonesuch_library{usage}, BPT_ERR_REF("unknown-usage"));
+    for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+        if ((*it)->linkable_path) {
+            ret.push_back(*(*it)->linkable_path);
+        }
     }
-    extend(ret, lib->include_paths);
-    for (const auto& transitive : lib->uses) {
-        extend(ret, include_paths(transitive));
+    return _cache.link_paths.emplace(key, std::move(ret)).first->second;
+}
+
+void usage_requirement_map::_collect_include_paths(const lm::usage&       usage,
+                                                   std::set<library_key>& seen,
+                                                   std::set<fs::path>&    seen_dirs,
+                                                   std::vector<fs::path>& out) const {
+    const auto& lib = _get_or_throw(usage);
+    if (!seen.insert(usage).second) {
+        return;
     }
-    return ret;
+    for (const auto& dir : lib.include_paths) {
+        if (seen_dirs.insert(dir).second) {
+            out.push_back(dir);
+        }
+    }
+    for (const auto& transitive : lib.uses) {
+        _collect_include_paths(transitive, seen, seen_dirs, out);
+    }
+}
+
+const std::vector<fs::path>& usage_requirement_map::include_paths(const lm::usage& usage) const {
+    std::unique_lock lk{_cache.mutex};
+    auto             found = _cache.include_paths.find(usage);
+    if (found != _cache.include_paths.end()) {
+        return found->second;
+    }
+
+    std::set<library_key> seen;
+    std::set<fs::path>    seen_dirs;
+    std::vector<fs::path> ret;
+    _collect_include_paths(usage, seen, seen_dirs, ret);
+    return _cache.include_paths.emplace(usage, std::move(ret)).first->second;
 }
 
 namespace {
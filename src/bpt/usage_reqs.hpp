@@ -7,7 +7,9 @@
 #include <neo/out.hpp>
 
 #include <map>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <string>
 #include <utility>
 
@@ -35,6 +37,33 @@ class usage_requirement_map {
     using _reqs_map_type = std::map<library_key, lm::library>;
     _reqs_map_type _reqs;
 
+    // Memoized transitive closures, computed on first request. Copies of the map start with an
+    // empty cache, and adding a library discards it.
+    struct closure_cache {
+        std::mutex                                   mutex;
+        std::map<library_key, std::vector<fs::path>> include_paths;
+        std::map<library_key, std::vector<fs::path>> link_paths;
+
+        closure_cache() = default;
+        closure_cache(const closure_cache&) noexcept {}
+        closure_cache& operator=(const closure_cache&) noexcept {
+            std::unique_lock lk{mutex};
+            include_paths.clear();
+            link_paths.clear();
+            return *this;
+        }
+    };
+    mutable closure_cache _cache;
+
+    const lm::library& _get_or_throw(const lm::usage&) const;
+    void _collect_include_paths(const lm::usage&,
+                                std::set<library_key>& seen,
+                                std::set<fs::path>&    seen_dirs,
+                                std::vector<fs::path>& out) const;
+    void _collect_link_order(const lm::usage&,
+                             std::set<library_key>&            seen,
+                             std::vector<const lm::library*>& postorder) const;
+
 public:
     using const_iterator = _reqs_map_type::const_iterator;
 
@@ -42,8 +71,20 @@ public:
     lm::library&       add(lm::usage u);
     void               add(lm::usage u, lm::library lib) { add(u) = lib; }
 
-    std::vector<fs::path> link_paths(const lm::usage&) const;
-    std::vector<fs::path> include_paths(const lm::usage& req) const;
+    /**
+     * @brief Obtain the linker inputs required to use the given library, including those of
+     * everything it transitively `uses` and `links`.
+     *
+     * Each input appears once, and every library's input comes before the inputs of the libraries
+     * that it depends on, as required for static archives. The result is cached.
+     */
+    const std::vector<fs::path>& link_paths(const lm::usage&) const;
+    /**
+     * @brief Obtain the #include directories of the given library and everything it transitively
+     * `uses`. The library's own directories come first, and each appears once. The result is
+     * cached.
+     */
+    const std::vector<fs::path>& include_paths(const lm::usage& req) const;
 
     static usage_requirement_map from_lm_index(const lm::index&) noexcept;
 
@@ -74,8 +115,10 @@ public:
     const usage_requirement_map& get_usage_map() const& { return _reqs; }
     usage_requirement_map&&      steal_usage_map() && { return std::move(_reqs); }
 
-    std::vector<fs::path> link_paths(const lm::usage& key) const { return _reqs.link_paths(key); }
-    std::vector<fs::path> include_paths(const lm::usage& req) const {
+    const std::vector<fs::path>& link_paths(const lm::usage& key) const {
+        return _reqs.link_paths(key);
+    }
+    const std::vector<fs::path>& include_paths(const lm::usage& req) const {
         return _reqs.include_paths(req);
     }
 
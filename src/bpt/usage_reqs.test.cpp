@@ -1,5 +1,7 @@
 #include "./usage_reqs.hpp"
 
+#include <bpt/error/try_catch.hpp>
+
 #include <fmt/core.h>
 #include <fmt/ranges.h>
 #include <range/v3/view/transform.hpp>
@@ -114,4 +116,48 @@ TEST_CASE("Cyclic dependencies can be found - larger case") {
                IsRotation({lm::usage{"dep1", "dep1"},
                            lm::usage{"dep2", "dep2"},
                            lm::usage{"dep3", "dep3"}}));
-}
\ No newline at end of file
+}
+
+TEST_CASE("Transitive closures are deduplicated and ordered") {
+    // a uses b and c, which both use d
+    bpt::usage_requirement_map reqs;
+    reqs.add({"a", "a"},
+             lm::library{.name          = "a",
+                         .linkable_path = "liba.a",
+                         .include_paths = {"a/include"},
+                         .uses          = {lm::usage{"b", "b"}, lm::usage{"c", "c"}}});
+    reqs.add({"b", "b"},
+             lm::library{.name          = "b",
+                         .linkable_path = "libb.a",
+                         .include_paths = {"b/include", "shared/include"},
+                         .uses          = {lm::usage{"d", "d"}}});
+    reqs.add({"c", "c"},
+             lm::library{.name          = "c",
+                         .linkable_path = "libc.a",
+                         .include_paths = {"c/include", "shared/include"},
+                         .uses          = {lm::usage{"d", "d"}}});
+    reqs.add({"d", "d"},
+             lm::library{.name = "d", .linkable_path = "libd.a", .include_paths = {"d/include"}});
+
+    auto& includes = reqs.include_paths({"a", "a"});
+    CHECK(includes
+          == std::vector<bpt::fs::path>{"a/include",
+                                        "b/include",
+                                        "shared/include",
+                                        "d/include",
+                                        "c/include"});
+    // The cached closure is handed back on later requests
+    CHECK(&reqs.include_paths({"a", "a"}) == &includes);
+
+    auto& links = reqs.link_paths({"a", "a"});
+    REQUIRE(links.size() == 4);
+    CHECK(links.front() == "liba.a");
+    CHECK(links.back() == "libd.a");
+
+    bpt_leaf_try {
+        reqs.link_paths({"e", "e"});
+        FAIL_CHECK("Expected an error");
+    }
+    bpt_leaf_catch(bpt::e_nonesuch_library missing) { CHECK(missing.value == lm::usage{"e", "e"}); }
+    bpt_leaf_catch_all { FAIL_CHECK("Incorrect error: " << diagnostic_info); };
+}
@@ -4,10 +4,15 @@
 #include <bpt/error/result.hpp>
 #include <bpt/util/fs/io.hpp>
 
+#include <neo/buffers_consumer.hpp>
 #include <neo/gzip_io.hpp>
 #include <neo/io/stream/buffers.hpp>
 #include <neo/io/stream/file.hpp>
 
+#include <algorithm>
+#include <istream>
+#include <vector>
+
 using namespace bpt;
 
 result<void> bpt::compress_file_gz(fs::path in_path, fs::path out_path) noexcept {
@@ -64,4 +69,62 @@ result<void> bpt::decompress_file_gz(fs::path gz_path, fs::path plain_path) noex
     }
 
     return {};
-}
\ No newline at end of file
+}
+
+namespace {
+
+/// Adapts a std::istream to be read as a buffer source
+class istream_source {
+    std::istream&     _in;
+    std::vector<char> _buf = std::vector<char>(64 * 1024);
+    std::size_t       _pos = 0;
+    std::size_t       _end = 0;
+
+public:
+    explicit istream_source(std::istream& in)
+        : _in(in) {}
+
+    neo::const_buffer next(std::size_t n) {
+        if (_pos == _end) {
+            _in.read(_buf.data(), static_cast<std::streamsize>(_buf.size()));
+            _pos = 0;
+            _end = static_cast<std::size_t>(_in.gcount());
+        }
+        return neo::const_buffer(std::string_view(_buf.data() + _pos, (std::min)(n, _end - _pos)));
+    }
+
+    void consume(std::size_t n) noexcept { _pos += n; }
+};
+
+template <typename Source>
+result<std::string> decompress_all(Source& in) noexcept {
+    try {
+        neo::gzip_source<Source&> gzip{in};
+        std::string               ret;
+        while (true) {
+            auto part = gzip.next(64 * 1024);
+            if (neo::buffer_is_empty(part)) {
+                break;
+            }
+            ret.append(reinterpret_cast<const char*>(part.data()), part.size());
+            gzip.consume(part.size());
+        }
+        return ret;
+    } catch (const std::system_error& e) {
+        return boost::leaf::new_error(e.code(), e_decompress_error{e.what()});
+    } catch (const std::runtime_error& e) {
+        return boost::leaf::new_error(e_decompress_error{e.what()});
+    }
+}
+
+}  // namespace
+
+result<std::string> bpt::decompress_gz(std::string_view gz_data) noexcept {
+    neo::buffers_consumer in{neo::const_buffer(gz_data)};
+    return decompress_all(in);
+}
+
+result<std::string> bpt::decompress_gz(std::istream& gz_in) noexcept {
+    istream_source in{gz_in};
+    return decompress_all(in);
+}
@@ -3,6 +3,10 @@
 #include "./fs/path.hpp"
 #include <bpt/error/result_fwd.hpp>
 
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
 namespace bpt {
 
 struct e_compress_error {
@@ -15,4 +19,14 @@ struct e_decompress_error {
 };
 [[nodiscard]] result<void> decompress_file_gz(fs::path in_file, fs::path out_file) noexcept;
 
+/**
+ * @brief Decompress gzip data that is already held in memory
+ */
+[[nodiscard]] result<std::string> decompress_gz(std::string_view gz_data) noexcept;
+
+/**
+ * @brief Decompress gzip data as it is read from the given stream
+ */
+[[nodiscard]] result<std::string> decompress_gz(std::istream& gz_in) noexcept;
+
 }  // namespace bpt
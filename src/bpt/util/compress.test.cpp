@@ -6,6 +6,9 @@
 #include <boost/leaf.hpp>
 #include <catch2/catch.hpp>
 
+#include <cstdint>
+#include <fstream>
+
 template <typename Fun>
 void check_voidres(Fun&& f) {
     boost::leaf::try_handle_all(f, [](const boost::leaf::verbose_diagnostic_info& info) {
@@ -70,4 +73,62 @@ TEST_CASE("Decompress a non-compressed file") {
         [](const boost::leaf::verbose_diagnostic_info& info) {
             FAIL("Unexpected failure: " << info);
         });
-}
\ No newline at end of file
+}
+
+TEST_CASE("Decompress data in memory") {
+    const std::string_view plain_string = "I am the text content";
+    auto                   tdir         = bpt::temporary_dir::create();
+    bpt::fs::create_directories(tdir.path());
+    const auto test_file = tdir.path() / "test.txt";
+    bpt::write_file(test_file, plain_string);
+    auto test_file_gz = bpt::fs::path(test_file) += ".gz";
+    check_voidres([&] { return bpt::compress_file_gz(test_file, test_file_gz); });
+
+    boost::leaf::try_handle_all(
+        [&]() -> bpt::result<void> {
+            BOOST_LEAF_AUTO(plain, bpt::decompress_gz(bpt::read_file(test_file_gz)));
+            CHECK(plain == plain_string);
+            return {};
+        },
+        [](const boost::leaf::verbose_diagnostic_info& info) {
+            FAIL("Unexpected failure: " << info);
+        });
+
+    boost::leaf::try_handle_all(
+        [&]() -> bpt::result<void> {
+            BOOST_LEAF_CHECK(bpt::decompress_gz(plain_string));
+            FAIL("Decompression should have failed");
+            return {};
+        },
+        [&](bpt::e_decompress_error) {},
+        [](const boost::leaf::verbose_diagnostic_info& info) {
+            FAIL("Unexpected failure: " << info);
+        });
+}
+
+TEST_CASE("Decompress data from a stream") {
+    // Poorly compressible, so that the compressed data spans several reads from the stream
+    std::string   plain_string(512 * 1024, '\0');
+    std::uint32_t state = 1;
+    for (auto& c : plain_string) {
+        state = state * 1'664'525 + 1'013'904'223;
+        c     = static_cast<char>(state >> 24);
+    }
+    auto tdir = bpt::temporary_dir::create();
+    bpt::fs::create_directories(tdir.path());
+    const auto test_file = tdir.path() / "test.txt";
+    bpt::write_file(test_file, plain_string);
+    auto test_file_gz = bpt::fs::path(test_file) += ".gz";
+    check_voidres([&] { return bpt::compress_file_gz(test_file, test_file_gz); });
+
+    boost::leaf::try_handle_all(
+        [&]() -> bpt::result<void> {
+            std::ifstream in{test_file_gz, std::ios::binary};
+            BOOST_LEAF_AUTO(plain, bpt::decompress_gz(in));
+            CHECK(plain == plain_string);
+            return {};
+        },
+        [](const boost::leaf::verbose_diagnostic_info& info) {
+            FAIL("Unexpected failure: " << info);
+        });
+}
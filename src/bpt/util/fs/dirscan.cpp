@@ -2,15 +2,105 @@
 
 #include <bpt/util/db/migrate.hpp>
 #include <bpt/util/db/query.hpp>
+#include <bpt/util/fs/readdir.hpp>
+#include <bpt/util/log.hpp>
 
 #include <neo/memory.hpp>
 #include <neo/sqlite3/connection_ref.hpp>
 #include <neo/sqlite3/exec.hpp>
 #include <neo/sqlite3/transaction.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#if !_WIN32
+#include <sys/stat.h>
+#endif
+
 using namespace bpt;
 using namespace neo::sqlite3::literals;
 
+namespace {
+
+/// The values that are used to detect that a directory has been modified
+struct dir_stamp {
+    /// Nanoseconds since the epoch of the filesystem clock
+    std::int64_t mtime = 0;
+    std::int64_t inode = 0;
+
+    bool operator==(const dir_stamp&) const noexcept = default;
+};
+
+/**
+ * A directory modified twice within the granularity of the filesystem clock will not have its
+ * mtime changed by the second modification, so the stamps of directories that were modified
+ * this recently are not trusted.
+ */
+constexpr std::int64_t racy_window_ns = 2'000'000'000;
+
+std::optional<dir_stamp> stamp_of(path_ref dirpath) noexcept {
+#if _WIN32
+    std::error_code ec;
+    if (!fs::is_directory(dirpath, ec)) {
+        return std::nullopt;
+    }
+    auto mtime = fs::last_write_time(dirpath, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return dir_stamp{
+        .mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch())
+                     .count(),
+    };
+#else
+    struct ::stat st;
+    if (::stat(dirpath.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return std::nullopt;
+    }
+#if __APPLE__
+    auto& mtim = st.st_mtimespec;
+#else
+    auto& mtim = st.st_mtim;
+#endif
+    return dir_stamp{
+        .mtime = static_cast<std::int64_t>(mtim.tv_sec) * 1'000'000'000 + mtim.tv_nsec,
+        .inode = static_cast<std::int64_t>(st.st_ino),
+    };
+#endif
+}
+
+/// The current time, comparable to dir_stamp::mtime
+std::int64_t stamp_now() noexcept {
+#if _WIN32
+    auto now = fs::file_time_type::clock::now();
+#else
+    auto now = std::chrono::system_clock::now();
+#endif
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+}
+
+/// A directory that was recorded by a prior scan
+struct recorded_subdir {
+    std::int64_t             subdir_id;
+    dir_stamp                stamp;
+    std::vector<std::string> children;
+};
+
+/// A directory whose immediate entries were read again
+struct rescanned_subdir {
+    std::string              relpath;
+    std::string              parent_relpath;
+    dir_stamp                stamp;
+    std::vector<std::string> files;
+    std::vector<std::string> children;
+};
+
+}  // namespace
+
 file_collector file_collector::create(unique_database& db) {
     apply_db_migrations(  //
         db,
@@ -31,6 +121,34 @@ file_collector file_collector::create(unique_database& db) {
                     UNIQUE (dir_id, relpath)
                 );
             )"_sql);
+        },
+        [](unique_database& db) {  //
+            db.exec_script(R"(
+                DROP TABLE bpt_found_files;
+                DELETE FROM bpt_scanned_dirs;
+                CREATE TABLE bpt_scanned_subdirs (
+                    subdir_id INTEGER PRIMARY KEY,
+                    dir_id INTEGER
+                        NOT NULL
+                        REFERENCES bpt_scanned_dirs
+                            ON DELETE CASCADE,
+                    parent_id INTEGER NOT NULL,
+                    relpath TEXT NOT NULL,
+                    mtime INTEGER NOT NULL,
+                    inode INTEGER NOT NULL,
+                    UNIQUE (dir_id, relpath)
+                );
+                CREATE INDEX idx_scanned_subdirs_parent ON bpt_scanned_subdirs (parent_id);
+                CREATE TABLE bpt_found_files (
+                    file_id INTEGER PRIMARY KEY,
+                    subdir_id INTEGER
+                        NOT NULL
+                        REFERENCES bpt_scanned_subdirs
+                            ON DELETE CASCADE,
+                    relpath TEXT NOT NULL,
+                    UNIQUE (subdir_id, relpath)
+                );
+            )"_sql);
         })
         .value();
     return file_collector{db};
@@ -39,49 +157,177 @@ file_collector file_collector::create(unique_database& db) {
 neo::any_input_range<fs::path> file_collector::collect(path_ref dirpath) {
     std::error_code ec;
     // Normalize the path so that different paths pointing to the same dir will hit caches
-    auto normpath = fs::weakly_canonical(dirpath, ec);
-    // Try and select the row corresponding to this directory
-    std::int64_t dir_id  = -1;
-    auto         dir_id_ = neo::sqlite3::one_row<std::int64_t>(  //
-        _db.get().prepare("SELECT dir_id FROM bpt_scanned_dirs WHERE dirpath = ?"_sql),
-        normpath.string());
-
-    if (dir_id_.has_value()) {
-        dir_id = std::get<0>(*dir_id_);
-    } else {
-        // Nothing for this directory. We need to scan it
-        neo::sqlite3::transaction_guard tr{_db.get().sqlite3_db()};
-
-        auto new_dir_id = *neo::sqlite3::one_row<std::int64_t>(  //
-            _db.get().prepare(R"(
-                INSERT INTO bpt_scanned_dirs (dirpath)
-                     VALUES (?)
-                  RETURNING dir_id
-            )"_sql),
-            normpath.string());
-        auto dir_iter   = fs::recursive_directory_iterator{normpath};
-        auto children   = dir_iter | std::views::transform([&](fs::path p) {
-                            return std::tuple(std::get<0>(new_dir_id),
-                                              p.lexically_relative(normpath).string());
-                        });
-        neo::sqlite3::exec_each(  //
-            _db.get().prepare(R"(
-                INSERT INTO bpt_found_files (dir_id, relpath)
-                VALUES (?, ?)
-            )"_sql),
-            children)
-            .throw_if_error();
-        dir_id = std::get<0>(new_dir_id);
+    auto  normpath = fs::weakly_canonical(dirpath, ec);
+    auto& db       = _db.get();
+
+    // The database is only locked while reading and updating the recorded listing, so that
+    // multiple trees can be walked in parallel.
+    std::unique_lock lk{*_mutex};
+
+    auto dir_id = *db_cell<std::int64_t>(db.prepare(R"(
+        INSERT INTO bpt_scanned_dirs (dirpath)
+             VALUES (?)
+        ON CONFLICT (dirpath) DO UPDATE SET dirpath = dirpath
+          RETURNING dir_id
+    )"_sql),
+                                         std::string_view(normpath.string()));
+
+    // Load the stamps of every directory that was seen the last time this tree was scanned
+    std::map<std::string, recorded_subdir, std::less<>> recorded;
+    std::map<std::int64_t, std::string>                 relpath_of_id;
+    std::vector<std::pair<std::int64_t, std::string>>   parent_links;
+    for (auto [subdir_id, parent_id, relpath, mtime, inode] :
+         db_query<std::int64_t, std::int64_t, std::string, std::int64_t, std::int64_t>(
+             db.prepare(R"(
+                 SELECT subdir_id, parent_id, relpath, mtime, inode
+                   FROM bpt_scanned_subdirs
+                  WHERE dir_id = ?
+             )"_sql),
+             dir_id)) {
+        relpath_of_id.emplace(subdir_id, relpath);
+        if (parent_id != 0) {
+            parent_links.emplace_back(parent_id, relpath);
+        }
+        recorded.emplace(relpath, recorded_subdir{subdir_id, dir_stamp{mtime, inode}, {}});
+    }
+    for (auto& [parent_id, relpath] : parent_links) {
+        auto parent = relpath_of_id.find(parent_id);
+        if (parent == relpath_of_id.end()) {
+            // The parent is gone, so the directory is no longer reached by the walk
+            continue;
+        }
+        recorded.at(parent->second).children.push_back(relpath);
     }
+    lk.unlock();
+
+    // Walk the tree. Unchanged directories are descended into using the recorded listing, while
+    // new and modified directories have their immediate entries read again.
+    const auto                    now = stamp_now();
+    std::vector<rescanned_subdir> rescanned;
+    std::vector<std::string>      removed;
+    // Pairs of the relative path of a directory and the relative path of its parent
+    std::vector<std::pair<std::string, std::string>> pending = {{"", ""}};
+    while (!pending.empty()) {
+        auto [relpath, parent_relpath] = std::move(pending.back());
+        pending.pop_back();
+        auto fullpath = normpath / relpath;
+        auto stamp    = stamp_of(fullpath);
+        if (!stamp.has_value()) {
+            // The directory has been removed, so forget everything that was found within it
+            removed.push_back(relpath);
+            continue;
+        }
 
-    auto st = neo::copy_shared(
-        *_db.get().sqlite3_db().prepare("SELECT relpath FROM bpt_found_files WHERE dir_id = ?"));
+        auto prev = recorded.find(relpath);
+        if (prev != recorded.end() && prev->second.stamp == *stamp) {
+            for (auto& child : prev->second.children) {
+                pending.emplace_back(child, relpath);
+            }
+            continue;
+        }
 
-    return *neo::sqlite3::exec_tuples<std::string>(*st, dir_id)
-        | std::views::transform([pin = st](auto tup) { return fs::path(tup.template get<0>()); });
+        if (now - stamp->mtime < racy_window_ns) {
+            // Record a stamp that will never match, so the directory is read again next time
+            stamp->mtime = 0;
+        }
+        rescanned_subdir dir{relpath, parent_relpath, *stamp, {}, {}};
+        for (auto& entry : read_directory(fullpath)) {
+            auto entry_relpath = (fs::path(relpath) / entry.name).generic_string();
+            if (entry.kind == dir_entry_kind::directory) {
+                pending.emplace_back(entry_relpath, relpath);
+                dir.children.push_back(std::move(entry_relpath));
+            } else if (entry.kind == dir_entry_kind::regular_file) {
+                dir.files.push_back(std::move(entry_relpath));
+            }
+        }
+        rescanned.push_back(std::move(dir));
+    }
+
+    lk.lock();
+    neo::sqlite3::transaction_guard tr{db.sqlite3_db()};
+
+    auto& remove_st = db.prepare(R"(
+        DELETE FROM bpt_scanned_subdirs
+         WHERE dir_id = ?1
+           AND (relpath = ?2 OR substr(relpath, 1, length(?2) + 1) = ?2 || '/')
+    )"_sql);
+    for (auto& relpath : removed) {
+        if (relpath.empty()) {
+            db_exec(db.prepare("DELETE FROM bpt_scanned_subdirs WHERE dir_id = ?"_sql), dir_id)
+                .value();
+        } else {
+            db_exec(remove_st, dir_id, std::string_view(relpath)).value();
+        }
+    }
+
+    auto& update_st   = db.prepare(R"(
+        INSERT INTO bpt_scanned_subdirs (dir_id, parent_id, relpath, mtime, inode)
+             VALUES (?1, ?2, ?3, ?4, ?5)
+        ON CONFLICT (dir_id, relpath) DO UPDATE
+                SET parent_id = ?2,
+                    mtime = ?4,
+                    inode = ?5
+          RETURNING subdir_id
+    )"_sql);
+    auto& clear_st    = db.prepare("DELETE FROM bpt_found_files WHERE subdir_id = ?"_sql);
+    auto& add_file_st = db.prepare(R"(
+        INSERT INTO bpt_found_files (subdir_id, relpath)
+        VALUES (?, ?)
+    )"_sql);
+    // Directories are rescanned parent-first, so the ID of each parent is always known
+    std::map<std::string, std::int64_t, std::less<>> subdir_ids;
+    for (auto& [relpath, prev] : recorded) {
+        subdir_ids.emplace(relpath, prev.subdir_id);
+    }
+    for (auto& dir : rescanned) {
+        // The root of the tree has a parent ID of zero, which is never a valid row ID
+        auto parent_id = dir.relpath.empty() ? 0 : subdir_ids.at(dir.parent_relpath);
+        auto subdir_id = *db_cell<std::int64_t>(update_st,
+                                                dir_id,
+                                                parent_id,
+                                                std::string_view(dir.relpath),
+                                                dir.stamp.mtime,
+                                                dir.stamp.inode);
+        subdir_ids[dir.relpath] = subdir_id;
+        db_exec(clear_st, subdir_id).value();
+        for (auto& file : dir.files) {
+            db_exec(add_file_st, subdir_id, std::string_view(file)).value();
+        }
+
+        // Drop the directories that no longer exist, along with everything beneath them
+        auto prev = recorded.find(dir.relpath);
+        if (prev == recorded.end()) {
+            continue;
+        }
+        for (auto& child : prev->second.children) {
+            if (std::ranges::find(dir.children, child) == dir.children.end()) {
+                db_exec(remove_st, dir_id, std::string_view(child)).value();
+            }
+        }
+    }
+    bpt_log(trace,
+            "Directory scan of [{}] re-read {} of {} directories",
+            normpath.string(),
+            rescanned.size(),
+            recorded.size());
+
+    auto files = neo::copy_shared(std::vector<fs::path>{});
+    for (auto [relpath] : db_query<std::string>(db.prepare(R"(
+             SELECT f.relpath
+               FROM bpt_found_files AS f
+               JOIN bpt_scanned_subdirs USING (subdir_id)
+              WHERE dir_id = ?
+              ORDER BY f.relpath
+         )"_sql),
+                                                dir_id)) {
+        files->emplace_back(relpath);
+    }
+    return *files | std::views::transform([pin = files](const fs::path& p) { return p; });
 }
 
 bool file_collector::has_cached(path_ref dirpath) noexcept {
+    std::unique_lock lk{*_mutex};
+
     auto normpath = fs::weakly_canonical(dirpath);
     auto has_dir  =  //
         db_cell<bool>(_db.get().prepare(
@@ -91,6 +337,8 @@ bool file_collector::has_cached(path_ref dirpath) noexcept {
 }
 
 void file_collector::forget(path_ref dirpath) noexcept {
+    std::unique_lock lk{*_mutex};
+
     auto normpath = fs::weakly_canonical(dirpath);
     auto res      = db_exec(_db.get().prepare("DELETE FROM bpt_scanned_dirs WHERE dirpath = ?"_sql),
                        std::string_view(normpath.string()));
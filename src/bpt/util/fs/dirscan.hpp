@@ -7,21 +7,34 @@
 #include <neo/any_range.hpp>
 
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 namespace bpt {
 
+/**
+ * @brief Collects recursive directory listings and caches them in a database.
+ *
+ * Each directory in a listing is recorded along with its modification time and inode. Creating,
+ * removing, or renaming an entry within a directory updates the modification time of that
+ * directory, so only the directories whose stamps have changed need to be read again when the
+ * listing is next requested.
+ */
 class file_collector {
     std::reference_wrapper<unique_database> _db;
+    /// Serializes access to the database when collecting from multiple threads
+    std::shared_ptr<std::mutex> _mutex = std::make_shared<std::mutex>();
 
-    explicit file_collector(unique_database& db) noexcept
+    explicit file_collector(unique_database& db)
         : _db(db) {}
 
 public:
     // Create a new collector with the given database as the cache source
     [[nodiscard]] static file_collector create(unique_database& db);
 
-    // Obtain a recursive listing of every descendant of the given directory
+    // Obtain a recursive listing of every regular file within the given directory, as paths
+    // relative to that directory, in sorted order. May be called from multiple threads.
     neo::any_input_range<fs::path> collect(path_ref);
     // Remove the given directory from the database cache
     void forget(path_ref) noexcept;
@@ -3,9 +3,13 @@
 #include <neo/ranges.hpp>
 
 #include <bpt/error/result.hpp>
+#include <bpt/temp.hpp>
+#include <bpt/util/fs/io.hpp>
 
 #include <catch2/catch.hpp>
 
+#include <chrono>
+
 TEST_CASE("Create a simple scanner") {
     auto this_dir = bpt::fs::path(__FILE__).lexically_normal().parent_path();
     auto db       = bpt::unique_database::open(":memory:");
@@ -18,3 +22,76 @@ TEST_CASE("Create a simple scanner") {
     finder.forget(this_dir);
     CHECK_FALSE(finder.has_cached(this_dir));
 }
+
+TEST_CASE("Rescan a modified directory") {
+    auto tdir = bpt::temporary_dir::create();
+    bpt::fs::create_directories(tdir.path() / "sub/inner");
+    bpt::write_file(tdir.path() / "a.cpp", "");
+    bpt::write_file(tdir.path() / "sub/inner/b.cpp", "");
+
+    auto db = bpt::unique_database::open(":memory:");
+    REQUIRE(db);
+    auto finder = bpt::file_collector::create(*db);
+    auto found  = finder.collect(tdir.path()) | neo::to_vector;
+    CHECK(found == std::vector<bpt::fs::path>{"a.cpp", "sub/inner/b.cpp"});
+
+    bpt::write_file(tdir.path() / "sub/c.cpp", "");
+    found = finder.collect(tdir.path()) | neo::to_vector;
+    CHECK(found == std::vector<bpt::fs::path>{"a.cpp", "sub/c.cpp", "sub/inner/b.cpp"});
+
+    bpt::fs::remove_all(tdir.path() / "sub/inner");
+    found = finder.collect(tdir.path()) | neo::to_vector;
+    CHECK(found == std::vector<bpt::fs::path>{"a.cpp", "sub/c.cpp"});
+}
+
+TEST_CASE("Reuse the listings of unchanged directories") {
+    auto tdir = bpt::temporary_dir::create();
+    auto root = tdir.path();
+    bpt::fs::create_directories(root / "sub/inner");
+    bpt::write_file(root / "a.cpp", "");
+    bpt::write_file(root / "sub/inner/b.cpp", "");
+
+    // Directories that were modified very recently are always read again, so move them back
+    auto an_hour_ago = bpt::fs::file_time_type::clock::now() - std::chrono::hours(1);
+    auto backdate    = [&](auto... relpaths) {
+        (bpt::fs::last_write_time(root / relpaths, an_hour_ago), ...);
+    };
+    backdate("", "sub", "sub/inner");
+
+    auto db = bpt::unique_database::open(":memory:");
+    REQUIRE(db);
+    auto finder = bpt::file_collector::create(*db);
+    auto found  = finder.collect(root) | neo::to_vector;
+    CHECK(found == std::vector<bpt::fs::path>{"a.cpp", "sub/inner/b.cpp"});
+
+    // Add a file without changing the stamp of its directory. Its listing is not read again, so
+    // the file goes unnoticed.
+    bpt::write_file(root / "sub/inner/hidden.cpp", "");
+    backdate("sub/inner");
+    found = finder.collect(root) | neo::to_vector;
+    CHECK(found == std::vector<bpt::fs::path>{"a.cpp", "sub/inner/b.cpp"});
+
+    // Modifying the parent does not read the unchanged subdirectory again
+    bpt::write_file(root / "sub/c.cpp", "");
+    found = finder.collect(root) | neo::to_vector;
+    CHECK(found == std::vector<bpt::fs::path>{"a.cpp", "sub/c.cpp", "sub/inner/b.cpp"});
+
+    // Once the subdirectory itself is modified, it is read again
+    bpt::write_file(root / "sub/inner/d.cpp", "");
+    found = finder.collect(root) | neo::to_vector;
+    CHECK(found
+          == std::vector<bpt::fs::path>{"a.cpp",
+                                        "sub/c.cpp",
+                                        "sub/inner/b.cpp",
+                                        "sub/inner/d.cpp",
+                                        "sub/inner/hidden.cpp"});
+
+    // Removing the subdirectory drops what was recorded beneath it, even once its parent is
+    // unchanged again
+    bpt::fs::remove_all(root / "sub/inner");
+    backdate("sub");
+    found = finder.collect(root) | neo::to_vector;
+    CHECK(found == std::vector<bpt::fs::path>{"a.cpp", "sub/c.cpp"});
+    found = finder.collect(root) | neo::to_vector;
+    CHECK(found == std::vector<bpt::fs::path>{"a.cpp", "sub/c.cpp"});
+}
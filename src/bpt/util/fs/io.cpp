@@ -1,6 +1,7 @@
 #include "./io.hpp"
 
 #include <bpt/error/on_error.hpp>
+#include <bpt/util/siphash.hpp>
 
 #include <boost/leaf/common.hpp>
 #include <boost/leaf/exception.hpp>
@@ -51,3 +52,8 @@ std::string bpt::read_file(path_ref path) {
     out << infile.rdbuf();
     return std::move(out).str();
 }
+
+std::uint64_t bpt::digest_file(path_ref path) {
+    auto content = read_file(path);
+    return bpt::siphash64(42, 1729, neo::const_buffer(content)).digest();
+}
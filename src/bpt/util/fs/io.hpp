@@ -2,6 +2,7 @@
 
 #include <bpt/error/result_fwd.hpp>
 
+#include <cstdint>
 #include <filesystem>
 #include <iosfwd>
 #include <string_view>
@@ -24,4 +25,10 @@ struct e_read_file_path {
 void                       write_file(std::filesystem::path const& path, std::string_view);
 [[nodiscard]] std::string  read_file(std::filesystem::path const& path);
 
+/**
+ * @brief Compute a 64-bit digest of the content of the given file. Two files with identical
+ * content will always have the same digest.
+ */
+[[nodiscard]] std::uint64_t digest_file(std::filesystem::path const& path);
+
 }  // namespace bpt
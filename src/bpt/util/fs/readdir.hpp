@@ -0,0 +1,34 @@
+#pragma once
+
+#include <bpt/util/fs/path.hpp>
+
+#include <string>
+#include <vector>
+
+namespace bpt {
+
+/// The kind of an entry that was found by `read_directory`
+enum class dir_entry_kind {
+    /// A directory. Symbolic links to directories are not considered to be directories.
+    directory,
+    /// A regular file, or a symbolic link that refers to a regular file
+    regular_file,
+    /// Anything else, including broken symbolic links
+    other,
+};
+
+struct dir_entry_info {
+    /// The filename of the entry within its directory
+    std::string    name;
+    dir_entry_kind kind;
+};
+
+/**
+ * @brief Read the immediate entries of the given directory, excluding "." and "..".
+ *
+ * Entries are read in large batches, and their kinds are taken from the directory listing itself
+ * where the platform provides them, so only symbolic links need an additional stat().
+ */
+[[nodiscard]] std::vector<dir_entry_info> read_directory(path_ref dirpath);
+
+}  // namespace bpt
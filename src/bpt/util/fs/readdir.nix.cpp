@@ -0,0 +1,143 @@
+#include "./readdir.hpp"
+
+#ifndef _WIN32
+
+#include <boost/leaf/exception.hpp>
+#include <neo/scope.hpp>
+#include <neo/ufmt.hpp>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __linux__
+#include <sys/syscall.h>
+#endif
+
+#include <cerrno>
+#include <memory>
+#include <system_error>
+
+using namespace bpt;
+
+namespace {
+
+[[noreturn]] void throw_readdir_error(path_ref dirpath, int err) {
+    auto ec = std::error_code(err, std::system_category());
+    BOOST_LEAF_THROW_EXCEPTION(
+        std::system_error{ec, neo::ufmt("Failed to read the directory [{}]", dirpath.string())},
+        dirpath,
+        ec);
+}
+
+bool is_dot_or_dotdot(const char* name) noexcept {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+dir_entry_kind kind_of(int dir_fd, const char* name, unsigned char d_type) noexcept {
+    switch (d_type) {
+    case DT_DIR:
+        return dir_entry_kind::directory;
+    case DT_REG:
+        return dir_entry_kind::regular_file;
+    case DT_LNK:
+    case DT_UNKNOWN:
+        // Not all filesystems report an entry type. Symbolic links are also resolved below.
+        break;
+    default:
+        return dir_entry_kind::other;
+    }
+    struct ::stat st;
+    if (::fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        return dir_entry_kind::other;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        return dir_entry_kind::directory;
+    }
+    if (S_ISLNK(st.st_mode) && ::fstatat(dir_fd, name, &st, 0) != 0) {
+        return dir_entry_kind::other;
+    }
+    return S_ISREG(st.st_mode) ? dir_entry_kind::regular_file : dir_entry_kind::other;
+}
+
+}  // namespace
+
+#if __linux__
+
+namespace {
+
+/// The record layout that is written by the getdents64 syscall
+struct linux_dirent64 {
+    ::ino64_t      d_ino;
+    ::off64_t      d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[1];
+};
+
+}  // namespace
+
+std::vector<dir_entry_info> bpt::read_directory(path_ref dirpath) {
+    int fd = ::open(dirpath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        throw_readdir_error(dirpath, errno);
+    }
+    neo_defer { ::close(fd); };
+
+    // Large enough to read most source directories with a single syscall
+    constexpr std::size_t buffer_size = 64 * 1024;
+    auto                  buffer      = std::make_unique<char[]>(buffer_size);
+
+    std::vector<dir_entry_info> ret;
+    while (true) {
+        auto nread = ::syscall(SYS_getdents64, fd, buffer.get(), buffer_size);
+        if (nread == -1 && errno == EINTR) {
+            continue;
+        }
+        if (nread < 0) {
+            throw_readdir_error(dirpath, errno);
+        }
+        if (nread == 0) {
+            break;
+        }
+        for (long offset = 0; offset < nread;) {
+            auto ent = reinterpret_cast<const linux_dirent64*>(buffer.get() + offset);
+            offset += ent->d_reclen;
+            if (!is_dot_or_dotdot(ent->d_name)) {
+                ret.push_back({ent->d_name, kind_of(fd, ent->d_name, ent->d_type)});
+            }
+        }
+    }
+    return ret;
+}
+
+#else
+
+std::vector<dir_entry_info> bpt::read_directory(path_ref dirpath) {
+    ::DIR* dir = ::opendir(dirpath.c_str());
+    if (dir == nullptr) {
+        throw_readdir_error(dirpath, errno);
+    }
+    neo_defer { ::closedir(dir); };
+
+    std::vector<dir_entry_info> ret;
+    while (true) {
+        errno    = 0;
+        auto ent = ::readdir(dir);
+        if (ent == nullptr) {
+            if (errno != 0) {
+                throw_readdir_error(dirpath, errno);
+            }
+            break;
+        }
+        if (!is_dot_or_dotdot(ent->d_name)) {
+            ret.push_back({ent->d_name, kind_of(::dirfd(dir), ent->d_name, ent->d_type)});
+        }
+    }
+    return ret;
+}
+
+#endif  // __linux__
+
+#endif  // _WIN32
@@ -0,0 +1,21 @@
+#include "./readdir.hpp"
+
+#ifdef _WIN32
+
+using namespace bpt;
+
+std::vector<dir_entry_info> bpt::read_directory(path_ref dirpath) {
+    std::vector<dir_entry_info> ret;
+    for (auto& entry : fs::directory_iterator{dirpath}) {
+        auto kind = dir_entry_kind::other;
+        if (entry.is_directory() && !entry.is_symlink()) {
+            kind = dir_entry_kind::directory;
+        } else if (entry.is_regular_file()) {
+            kind = dir_entry_kind::regular_file;
+        }
+        ret.push_back({entry.path().filename().string(), kind});
+    }
+    return ret;
+}
+
+#endif  // _WIN32
@@ -0,0 +1,369 @@
+#include "./download.hpp"
+
+#include "./error.hpp"
+
+#include <bpt/util/fs/io.hpp>
+#include <bpt/util/log.hpp>
+#include <bpt/util/siphash.hpp>
+#include <bpt/util/string.hpp>
+
+#include <boost/leaf/exception.hpp>
+#include <fmt/format.h>
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <optional>
+
+using namespace bpt;
+
+namespace {
+
+std::optional<std::uint64_t> parse_u64(std::string_view str) {
+    std::uint64_t ret  = 0;
+    auto          conv = std::from_chars(str.data(), str.data() + str.size(), ret);
+    if (conv.ec != std::errc{} || conv.ptr != str.data() + str.size()) {
+        return std::nullopt;
+    }
+    return ret;
+}
+
+/// The parts of a 'Content-Range' header that we care about
+struct content_range {
+    std::uint64_t                start = 0;
+    std::optional<std::uint64_t> total;
+};
+
+/// Parse a header of the form "bytes <first>-<last>/<total>", where <total> may be "*"
+std::optional<content_range> parse_content_range(std::string_view hdr) {
+    if (!hdr.starts_with("bytes ")) {
+        return std::nullopt;
+    }
+    hdr.remove_prefix(6);
+    auto dash  = hdr.find('-');
+    auto slash = hdr.find('/');
+    if (dash == hdr.npos || slash == hdr.npos || slash < dash) {
+        return std::nullopt;
+    }
+    auto start = parse_u64(hdr.substr(0, dash));
+    if (!start) {
+        return std::nullopt;
+    }
+    content_range ret{.start = *start, .total = std::nullopt};
+    auto          total = hdr.substr(slash + 1);
+    if (total != "*") {
+        ret.total = parse_u64(total);
+        if (!ret.total) {
+            return std::nullopt;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Find the expected SHA-256 of the content (base64-encoded) in the response headers. Both the
+ * structured 'Repr-Digest: sha-256=:<b64>:' and the older 'Digest: SHA-256=<b64>' are understood.
+ */
+std::optional<std::string> expected_sha256(const http_response_info& resp) {
+    for (auto hdr_name : {"Repr-Digest", "Digest"}) {
+        auto hdr = resp.header_value(hdr_name);
+        if (!hdr) {
+            continue;
+        }
+        // There may be a digest in more than one algorithm
+        for (auto item : split_view(*hdr, ",")) {
+            item    = trim_view(item);
+            auto eq = item.find('=');
+            if (eq == item.npos) {
+                continue;
+            }
+            auto algo = item.substr(0, eq);
+            if (!std::ranges::equal(algo, std::string_view("sha-256"), [](char a, char b) {
+                    return std::tolower(static_cast<unsigned char>(a)) == b;
+                })) {
+                continue;
+            }
+            auto value = item.substr(eq + 1);
+            // Structured field byte sequences are wrapped in colons
+            if (value.size() >= 2 && value.front() == ':' && value.back() == ':') {
+                value = value.substr(1, value.size() - 2);
+            }
+            return std::string(value);
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief A streambuf that reads the saved part of a download, followed by the rest of it from the
+ * network.
+ *
+ * Everything that is read from the network is appended to the partial file as it passes through,
+ * and all of the content is fed into a SHA-256 digest.
+ */
+class resuming_streambuf : public std::streambuf {
+    std::ifstream  _saved;
+    std::uint64_t  _saved_remaining;
+    std::istream&  _body;
+    std::ofstream* _partial;
+    bool           _partial_ok = true;
+    std::uint64_t  _size       = 0;
+
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> _sha{EVP_MD_CTX_new(),
+                                                                 &EVP_MD_CTX_free};
+
+    std::array<char, 64 * 1024> _buf;
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        std::streamsize n = 0;
+        if (_saved_remaining) {
+            _saved.read(_buf.data(),
+                        static_cast<std::streamsize>(
+                            (std::min)(std::uint64_t(_buf.size()), _saved_remaining)));
+            n = _saved.gcount();
+            if (n == 0) {
+                // The partial file was truncated beneath us. Let the size check catch it.
+                _partial_ok      = false;
+                _saved_remaining = 0;
+                return traits_type::eof();
+            }
+            _saved_remaining -= static_cast<std::uint64_t>(n);
+        } else {
+            _body.read(_buf.data(), static_cast<std::streamsize>(_buf.size()));
+            n = _body.gcount();
+            if (_partial && n > 0) {
+                // Flush right away, so that whatever we have received survives an interruption
+                _partial->write(_buf.data(), n);
+                _partial->flush();
+                _partial_ok = _partial_ok && _partial->good();
+            }
+        }
+        if (n == 0) {
+            return traits_type::eof();
+        }
+        EVP_DigestUpdate(_sha.get(), _buf.data(), static_cast<std::size_t>(n));
+        _size += static_cast<std::uint64_t>(n);
+        setg(_buf.data(), _buf.data(), _buf.data() + n);
+        return traits_type::to_int_type(*gptr());
+    }
+
+public:
+    /**
+     * @param saved The partial file to read first, if `saved_size` is non-zero
+     * @param saved_size The number of bytes to read from the partial file
+     * @param body The rest of the content, being received from the network
+     * @param partial If non-null, the stream to which the network content is appended
+     */
+    resuming_streambuf(path_ref       saved,
+                       std::uint64_t  saved_size,
+                       std::istream&  body,
+                       std::ofstream* partial)
+        : _saved_remaining(saved_size)
+        , _body(body)
+        , _partial(partial) {
+        if (saved_size) {
+            _saved.open(saved, std::ios::binary);
+        }
+        EVP_DigestInit_ex(_sha.get(), EVP_sha256(), nullptr);
+    }
+
+    /// The number of bytes of content that have been read so far
+    std::uint64_t size() const noexcept { return _size; }
+    /// Whether the partial file still holds exactly the content that has been read
+    bool partial_ok() const noexcept { return _partial && _partial_ok; }
+
+    /// Finish the digest of the content, and return it base64-encoded
+    std::string sha256_base64() {
+        unsigned char md[EVP_MAX_MD_SIZE];
+        unsigned int  md_len = 0;
+        EVP_DigestFinal_ex(_sha.get(), md, &md_len);
+        std::string ret(4 * ((md_len + 2) / 3) + 1, '\0');
+        auto enc_len = EVP_EncodeBlock(reinterpret_cast<unsigned char*>(ret.data()), md, md_len);
+        ret.resize(static_cast<std::size_t>(enc_len));
+        return ret;
+    }
+};
+
+}  // namespace
+
+void bpt::download_resumable(http_pool&                         pool,
+                             neo::url_view                      url,
+                             path_ref                           partial_dir,
+                             std::function<void(std::istream&)> fn) {
+    auto url_str   = url.to_string();
+    auto url_hash  = siphash64(42, 1729, neo::const_buffer(url_str)).digest();
+    auto key       = fmt::format("{:016x}", url_hash);
+    auto part_path = partial_dir / (key + ".part");
+    auto etag_path = partial_dir / (key + ".etag");
+
+    auto discard_partial = [&] {
+        std::error_code ec;
+        fs::remove(part_path, ec);
+        fs::remove(etag_path, ec);
+    };
+
+    // Pick up where a prior download left off, but only if we know which version of the content
+    // it was a part of.
+    std::string     saved_etag;
+    std::uint64_t   saved_size = 0;
+    std::error_code ec;
+    if (fs::is_regular_file(etag_path, ec) && fs::is_regular_file(part_path, ec)) {
+        saved_etag = bpt::read_file(etag_path);
+        saved_size = fs::file_size(part_path, ec);
+        if (ec) {
+            saved_size = 0;
+        }
+    }
+
+    std::string         range;
+    http_request_params params;
+    if (saved_size > 0 && !saved_etag.empty()) {
+        range           = fmt::format("bytes={}-", saved_size);
+        params.range    = range;
+        params.if_range = saved_etag;
+    } else {
+        saved_size = 0;
+    }
+
+    auto reqres = [&] {
+        if (params.range.empty()) {
+            return pool.request(url, params);
+        }
+        try {
+            return pool.request(url, params);
+        } catch (const http_status_error& e) {
+            if (e.status_code() != 416) {
+                throw;
+            }
+            // The saved part is longer than the content. Something is amiss, so start over.
+            bpt_log(debug,
+                    "Server rejected the range request for [{}]. Restarting the download.",
+                    url_str);
+            discard_partial();
+            params.range    = {};
+            params.if_range = {};
+            saved_size      = 0;
+            return pool.request(url, params);
+        }
+    }();
+    auto& resp = reqres.resp;
+
+    std::optional<std::uint64_t> total;
+    std::uint64_t                resume_from = 0;
+    if (resp.is_partial_content() && !params.range.empty()) {
+        auto crange = parse_content_range(resp.content_range().value_or(""));
+        if (!crange || crange->start != saved_size) {
+            reqres.client.abort_client();
+            throw BOOST_LEAF_EXCEPTION(
+                http_server_error(resp.status,
+                                  fmt::format("Server sent an unexpected 'Content-Range' ({}) in "
+                                              "reply to a request for '{}'",
+                                              resp.content_range().value_or("none"),
+                                              range)),
+                e_http_status{resp.status});
+        }
+        bpt_log(info, "Resuming download of [{}] after {} bytes", url_str, saved_size);
+        resume_from = saved_size;
+        total       = crange->total;
+    } else {
+        if (saved_size) {
+            bpt_log(debug,
+                    "Server sent all of [{}] instead of the requested range. Starting over.",
+                    url_str);
+        }
+        if (!resp.transfer_encoding() && resp.content_length()) {
+            total = static_cast<std::uint64_t>(*resp.content_length());
+        }
+    }
+
+    // Without an ETag, a later request could not tell whether the content has changed, so there is
+    // no point in keeping any of it.
+    auto etag = std::string(resp.etag().value_or(""));
+    std::optional<std::ofstream> partial;
+    if (etag.empty()) {
+        discard_partial();
+    } else {
+        fs::create_directories(partial_dir);
+        if (resume_from == 0) {
+            bpt::write_file(etag_path, etag);
+        }
+        partial.emplace(part_path,
+                        std::ios::binary | (resume_from ? std::ios::app : std::ios::trunc));
+    }
+
+    std::uint64_t received    = 0;
+    bool          partial_ok  = false;
+    bool          bad_content = false;
+    try {
+        reqres.read_body_stream([&](std::istream& body) {
+            resuming_streambuf buf{part_path, resume_from, body, partial ? &*partial : nullptr};
+            std::istream       in{&buf};
+            std::exception_ptr fn_error;
+            try {
+                fn(in);
+            } catch (...) {
+                fn_error = std::current_exception();
+            }
+            // Pull through whatever `fn` left unread, so that all of the content is saved and
+            // digested, even if `fn` gave up early.
+            in.clear();
+            in.ignore(std::numeric_limits<std::streamsize>::max());
+            received   = buf.size();
+            partial_ok = buf.partial_ok();
+
+            if (total && received != *total) {
+                bad_content = received > *total;
+                throw BOOST_LEAF_EXCEPTION(
+                    http_server_error(resp.status,
+                                      fmt::format("The download of [{}] ended after {} of {} bytes",
+                                                  url_str,
+                                                  received,
+                                                  *total)),
+                    e_http_status{resp.status});
+            }
+            if (auto expect = expected_sha256(resp)) {
+                auto actual = buf.sha256_base64();
+                if (actual != *expect) {
+                    bad_content = true;
+                    throw BOOST_LEAF_EXCEPTION(
+                        http_server_error(resp.status,
+                                          fmt::format("The SHA-256 of the content downloaded from "
+                                                      "[{}] ({}) does not match the one given by "
+                                                      "the server ({})",
+                                                      url_str,
+                                                      actual,
+                                                      *expect)),
+                        e_http_status{resp.status});
+                }
+                bpt_log(trace, "SHA-256 of [{}] matches: {}", url_str, actual);
+            }
+            if (fn_error) {
+                std::rethrow_exception(fn_error);
+            }
+        });
+    } catch (...) {
+        bool interrupted = !bad_content && (!total || received < *total);
+        if (partial_ok && interrupted) {
+            bpt_log(info,
+                    "Kept {} bytes of [{}]. The download will be resumed on the next attempt.",
+                    received,
+                    url_str);
+        } else {
+            partial.reset();
+            discard_partial();
+        }
+        throw;
+    }
+    partial.reset();
+    discard_partial();
+}
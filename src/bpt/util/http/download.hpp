@@ -0,0 +1,34 @@
+#pragma once
+
+#include "./pool.hpp"
+
+#include <bpt/util/fs/path.hpp>
+
+#include <neo/url/view.hpp>
+
+#include <functional>
+#include <iosfwd>
+
+namespace bpt {
+
+/**
+ * @brief Download the content at `url` and pass it to `fn` as a stream, resuming a prior download
+ * that was interrupted.
+ *
+ * While the content is received it is also written to a partial file in `partial_dir`, named for
+ * the URL. If the download is cut short, the partial file is kept along with the server's ETag for
+ * the content. The next download of the same URL asks the server for only the remainder with a
+ * `Range` request, and `fn` is given the saved part followed by the rest from the network. If the
+ * server ignores the range (or the ETag no longer matches), the download starts over.
+ *
+ * Once all of the content has been received, its size is checked against what the server
+ * announced, and its SHA-256 against the server's `Repr-Digest` (or `Digest`) header, if it sent
+ * one. The partial file is removed once `fn` returns successfully, or if the content turned out to
+ * be complete but bad.
+ */
+void download_resumable(http_pool&                         pool,
+                        neo::url_view                      url,
+                        path_ref                           partial_dir,
+                        std::function<void(std::istream&)> fn);
+
+}  // namespace bpt
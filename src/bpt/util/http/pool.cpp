@@ -8,6 +8,7 @@
 
 #include <boost/leaf/exception.hpp>
 #include <fmt/format.h>
+#include <neo/event.hpp>
 #include <neo/gzip_io.hpp>
 #include <neo/http/parse/chunked.hpp>
 #include <neo/http/request.hpp>
@@ -16,11 +17,91 @@
 #include <neo/io/stream/buffers.hpp>
 #include <neo/io/stream/file.hpp>
 #include <neo/io/stream/socket.hpp>
-
+#include <openssl/ssl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <istream>
 #include <map>
+#include <mutex>
+#include <thread>
 
 namespace bpt::detail {
 
+/**
+ * @brief Remembers the latest TLS session offered by each server, so that later connections to the
+ * same server can resume it rather than perform a full handshake.
+ */
+class tls_session_cache {
+    std::mutex                          _mutex;
+    std::map<std::string, SSL_SESSION*> _sessions;
+
+public:
+    ~tls_session_cache() {
+        for (auto& [_, sess] : _sessions) {
+            SSL_SESSION_free(sess);
+        }
+    }
+
+    static tls_session_cache& instance() {
+        static tls_session_cache inst;
+        return inst;
+    }
+
+    /// Take ownership of a session that was offered for the given key
+    void put(const std::string& key, SSL_SESSION* sess) {
+        std::unique_lock lk{_mutex};
+        auto&            slot = _sessions[key];
+        if (slot) {
+            SSL_SESSION_free(slot);
+        }
+        slot = sess;
+    }
+
+    /// Have the given connection offer to resume the session remembered for the given key, if any
+    void apply(const std::string& key, SSL* ssl) {
+        std::unique_lock lk{_mutex};
+        auto             found = _sessions.find(key);
+        if (found != _sessions.end()) {
+            SSL_set_session(ssl, found->second);
+        }
+    }
+};
+
+/**
+ * @brief The TLS context shared by all client connections. Sessions that servers offer are stored
+ * in the @ref tls_session_cache, keyed by the string that the connection sets as its app data.
+ */
+struct client_tls_context {
+    neo::ssl::openssl_app_init init;
+    neo::ssl::context          ctx{neo::ssl::protocol::tls_any, neo::ssl::role::client};
+
+    client_tls_context() {
+        // Sessions are kept by us rather than OpenSSL's internal store, since a client must choose
+        // which session to offer when it connects.
+        SSL_CTX_set_session_cache_mode(ctx.c_ptr(),
+                                       SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx.c_ptr(), [](SSL* ssl, SSL_SESSION* sess) -> int {
+            auto key = static_cast<const std::string*>(SSL_get_app_data(ssl));
+            if (!key) {
+                return 0;
+            }
+            tls_session_cache::instance().put(*key, sess);
+            // We have taken ownership of the session
+            return 1;
+        });
+    }
+
+    static client_tls_context& instance() {
+        static client_tls_context inst;
+        return inst;
+    }
+};
+
 struct http_client_impl {
     network_origin origin;
     explicit http_client_impl(network_origin o)
@@ -35,11 +116,14 @@ struct http_client_impl {
 
     _state_t _state = _state_t::ready;
 
-    bool _peer_disconnected = false;
+    /// Also set by shutdown(), which may be called while another thread is receiving
+    std::atomic<bool> _peer_disconnected = false;
 
     neo::socket _conn;
 
     std::string _host_string;
+    /// Identifies the server when storing and resuming TLS sessions. Referred to by the SSL object.
+    std::string _tls_session_key;
 
     using sock_buffers = neo::stream_io_buffers<neo::socket&>;
     sock_buffers _sock_in{_conn};
@@ -65,10 +149,16 @@ struct http_client_impl {
         _conn = std::move(sock);
 
         if (origin.protocol == "https") {
-            static neo::ssl::openssl_app_init ssl_init;
-            static neo::ssl::context ssl_ctx{neo::ssl::protocol::tls_any, neo::ssl::role::client};
-            _ssl_in.emplace(ssl_engine{ssl_ctx, _sock_in, neo::stream_io_buffers{_conn}});
+            auto& tls = client_tls_context::instance();
+            _ssl_in.emplace(ssl_engine{tls.ctx, _sock_in, neo::stream_io_buffers{_conn}});
+            auto ssl         = _ssl_in->stream().c_ptr();
+            _tls_session_key = fmt::format("{}:{}", origin.hostname, origin.port);
+            SSL_set_app_data(ssl, &_tls_session_key);
+            tls_session_cache::instance().apply(_tls_session_key, ssl);
             _ssl_in->stream().connect();
+            if (SSL_session_reused(ssl)) {
+                bpt_log(trace, "Resumed TLS session with {}", _tls_session_key);
+            }
         } else if (origin.protocol == "http") {
             // Plain HTTP, nothing special to do
         } else {
@@ -124,6 +214,12 @@ struct http_client_impl {
         if (!params.last_modified.empty()) {
             headers.push_back({"If-Modified-Since", params.last_modified});
         }
+        if (!params.range.empty()) {
+            headers.push_back({"Range", params.range});
+            if (!params.if_range.empty()) {
+                headers.push_back({"If-Range", params.if_range});
+            }
+        }
 
         _do_io([&](auto&& sink) {
             neo::http::write_request(sink, start_line, headers, neo::const_buffer());
@@ -161,6 +257,12 @@ struct http_client_impl {
         bpt_log(debug, " <-- HTTP {} {}", r.status, r.status_message);
         return r;
     }
+
+    /// Shut the connection down, waking any thread that is blocked receiving from it
+    void shutdown() noexcept {
+        _peer_disconnected = true;
+        _conn.shutdown(neo::socket::shutdown_how::both);
+    }
 };
 
 struct origin_order {
@@ -171,7 +273,122 @@ struct origin_order {
 };
 
 struct http_pool_impl {
-    std::multimap<network_origin, std::shared_ptr<http_client_impl>, origin_order> _clients;
+    using clock = std::chrono::steady_clock;
+
+    struct idle_client {
+        std::shared_ptr<http_client_impl> client;
+        clock::time_point                 idle_since;
+    };
+
+    /// The connections to a single origin
+    struct origin_clients {
+        /// The number of open connections, whether idle, in use, or still connecting
+        int n_open = 0;
+        /// The connections that are waiting to be reused, most recently used last
+        std::vector<idle_client> idle;
+        /// The tickets of the threads that are waiting for a connection, in order of arrival
+        std::deque<std::uint64_t> waiters;
+    };
+
+    http_pool_options _opts;
+
+    std::mutex                                             _mutex;
+    std::condition_variable                                _cv;
+    std::map<network_origin, origin_clients, origin_order> _origins;
+    std::uint64_t                                          _next_ticket = 0;
+
+    explicit http_pool_impl(http_pool_options opts)
+        : _opts(opts) {}
+
+    /**
+     * @brief Take the idle connections that have been unused for too long out of the pool. Must
+     * hold the mutex. They are moved into `closing` rather than destroyed, since closing a
+     * connection may perform I/O, which must not be done while holding the mutex.
+     */
+    void _take_stale(origin_clients& oc, std::vector<idle_client>& closing) {
+        auto stale_before = clock::now() - _opts.idle_timeout;
+        // Connections are only ever added at the end, so the stale ones are at the front
+        auto first_fresh = std::ranges::partition_point(oc.idle, [&](const idle_client& idle) {
+            return idle.idle_since < stale_before;
+        });
+        closing.insert(closing.end(),
+                       std::make_move_iterator(oc.idle.begin()),
+                       std::make_move_iterator(first_fresh));
+        oc.n_open -= static_cast<int>(first_fresh - oc.idle.begin());
+        oc.idle.erase(oc.idle.begin(), first_fresh);
+    }
+
+    /// Obtain a connection to the given origin, waiting for one to become available if needed
+    std::shared_ptr<http_client_impl> acquire(const network_origin& origin) {
+        // Declared before the lock, so stale connections are closed after the lock is released
+        std::vector<idle_client> closing;
+        std::unique_lock         lk{_mutex};
+        auto&                    oc     = _origins[origin];
+        auto                     ticket = _next_ticket++;
+        oc.waiters.push_back(ticket);
+        auto max_open = (std::max)(_opts.max_per_origin, 1);
+        auto my_turn  = [&] {
+            _take_stale(oc, closing);
+            return oc.waiters.front() == ticket && (!oc.idle.empty() || oc.n_open < max_open);
+        };
+        if (!my_turn()) {
+            bpt_log(trace,
+                    "Waiting for a connection to {}://{}:{} to become available",
+                    origin.protocol,
+                    origin.hostname,
+                    origin.port);
+            _cv.wait(lk, my_turn);
+        }
+        oc.waiters.pop_front();
+        // The next waiter might be able to proceed as well
+        _cv.notify_all();
+
+        if (!oc.idle.empty()) {
+            auto ret = std::move(oc.idle.back().client);
+            oc.idle.pop_back();
+            bpt_log(debug,
+                    "Reusing existing connection to {}://{}:{}",
+                    origin.protocol,
+                    origin.hostname,
+                    origin.port);
+            return ret;
+        }
+
+        ++oc.n_open;
+        lk.unlock();
+        closing.clear();
+        bpt_log(debug,
+                "Opening new connection to {}://{}:{}",
+                origin.protocol,
+                origin.hostname,
+                origin.port);
+        try {
+            auto ret = std::make_shared<http_client_impl>(origin);
+            ret->connect();
+            return ret;
+        } catch (...) {
+            release(origin, nullptr);
+            throw;
+        }
+    }
+
+    /**
+     * @brief Give back a connection that was obtained with `acquire()`.
+     *
+     * @param client The connection, if it may be reused. If null, the connection is closed.
+     */
+    void release(const network_origin& origin, std::shared_ptr<http_client_impl> client) {
+        {
+            std::unique_lock lk{_mutex};
+            auto&            oc = _origins[origin];
+            if (client) {
+                oc.idle.push_back(idle_client{std::move(client), clock::now()});
+            } else {
+                --oc.n_open;
+            }
+        }
+        _cv.notify_all();
+    }
 };
 
 }  // namespace bpt::detail
@@ -182,8 +399,8 @@ using client_impl_ptr = std::shared_ptr<detail::http_client_impl>;
 
 http_pool::~http_pool() = default;
 
-http_pool::http_pool()
-    : _impl(new detail::http_pool_impl) {}
+http_pool::http_pool(http_pool_options opts)
+    : _impl(new detail::http_pool_impl(opts)) {}
 
 http_client::~http_client() {
     // When the http_client is dropped, return its impl back to the connection pool for this origin
@@ -191,25 +408,30 @@ http_client::~http_client() {
         // We are moved-from
         return;
     }
+    bool reusable = true;
     if (_impl->_state != detail::http_client_impl::_state_t::ready
         && _n_exceptions != std::uncaught_exceptions()) {
         bpt_log(debug, "NOTE: An http_client was dropped due to an exception");
-        return;
+        reusable = false;
+    } else {
+        neo_assert(expects,
+                   _impl->_state == detail::http_client_impl::_state_t::ready,
+                   "An http_client object was dropped while in a partial-request state. Did you "
+                   "read the response header AND body?",
+                   int(_impl->_state),
+                   _impl->origin.protocol,
+                   _impl->origin.hostname,
+                   _impl->origin.port);
+        // If the peer will disconnect, do not return this connection to the pool. Let it destroy.
+        reusable = !_impl->_peer_disconnected;
     }
-    neo_assert(expects,
-               _impl->_state == detail::http_client_impl::_state_t::ready,
-               "An http_client object was dropped while in a partial-request state. Did you read "
-               "the response header AND body?",
-               int(_impl->_state),
-               _impl->origin.protocol,
-               _impl->origin.hostname,
-               _impl->origin.port);
-    if (_impl->_peer_disconnected) {
-        // Do not return this connection to the pool. Let it destroy
-        return;
+    auto origin = _impl->origin;
+    if (!reusable) {
+        // Close the connection before its place in the pool is given to someone else
+        _impl.reset();
     }
     if (auto pool = _pool.lock()) {
-        pool->_clients.emplace(_impl->origin, _impl);
+        pool->release(origin, std::move(_impl));
     }
 }
 
@@ -228,28 +450,9 @@ network_origin network_origin::for_url(neo::url const& url) noexcept {
 }
 
 http_client http_pool::client_for_origin(const network_origin& origin) {
-    auto        iter = _impl->_clients.find(origin);
     http_client ret;
+    ret._impl = _impl->acquire(origin);
     ret._pool = _impl;
-    if (iter == _impl->_clients.end()) {
-        // Nothing for this origin yet
-        bpt_log(debug,
-                "Opening new connection to {}://{}:{}",
-                origin.protocol,
-                origin.hostname,
-                origin.port);
-        auto ptr = std::make_shared<detail::http_client_impl>(origin);
-        ptr->connect();
-        ret._impl = ptr;
-    } else {
-        bpt_log(debug,
-                "Reusing existing connection to {}://{}:{}",
-                origin.protocol,
-                origin.hostname,
-                origin.port);
-        ret._impl = iter->second;
-        _impl->_clients.erase(iter);
-    }
     return ret;
 }
 
@@ -356,6 +559,143 @@ struct recv_http_v1_0_state : erased_message_body {
     void consume(std::size_t n) noexcept override { return _strm.consume(n); }
 };
 
+/**
+ * @brief A streambuf over a message body that is received by a background thread.
+ *
+ * The receiving thread copies the body into chunks and hands them over through a bounded queue,
+ * so it can run ahead of the reader without holding an unbounded amount of the body in memory.
+ */
+class threaded_body_streambuf : public std::streambuf {
+    static constexpr std::size_t chunk_size = 64 * 1024;
+    static constexpr std::size_t max_queued = 16;
+
+    erased_message_body&          _body;
+    std::mutex                    _mutex;
+    std::condition_variable       _cv;
+    std::deque<std::vector<char>> _queue;
+    std::vector<char>             _current;
+    bool                          _done        = false;
+    bool                          _cancelled   = false;
+    bool                          _interrupted = false;
+    std::exception_ptr            _error;
+    std::thread                   _thread;
+
+    void _receive() noexcept {
+        neo::listener log_listen = &log::ev_log::print;
+        try {
+            while (true) {
+                auto part = _body.next(chunk_size);
+                if (neo::buffer_is_empty(part)) {
+                    break;
+                }
+                std::vector<char> chunk(neo::buffer_size(part));
+                std::memcpy(chunk.data(), part.data(), chunk.size());
+                _body.consume(chunk.size());
+
+                std::unique_lock lk{_mutex};
+                _cv.wait(lk, [&] { return _queue.size() < max_queued || _cancelled; });
+                if (_cancelled) {
+                    break;
+                }
+                _queue.push_back(std::move(chunk));
+                _cv.notify_all();
+            }
+        } catch (...) {
+            std::unique_lock lk{_mutex};
+            _error = std::current_exception();
+        }
+        std::unique_lock lk{_mutex};
+        _done = true;
+        _cv.notify_all();
+    }
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        std::unique_lock lk{_mutex};
+        _cv.wait(lk, [&] { return !_queue.empty() || _done; });
+        if (_queue.empty()) {
+            // Either the end of the body, or receiving failed. A failure is reported once the
+            // reader has given up.
+            return traits_type::eof();
+        }
+        _current = std::move(_queue.front());
+        _queue.pop_front();
+        _cv.notify_all();
+        setg(_current.data(), _current.data(), _current.data() + _current.size());
+        return traits_type::to_int_type(*gptr());
+    }
+
+public:
+    explicit threaded_body_streambuf(erased_message_body& body)
+        : _body(body) {
+        _thread = std::thread([this] { _receive(); });
+    }
+
+    ~threaded_body_streambuf() {
+        if (_thread.joinable()) {
+            cancel([] {});
+        }
+    }
+
+    /**
+     * @brief Stop receiving and wait for the receiving thread to exit. The body is left incomplete.
+     *
+     * The receiving thread may be blocked waiting on the peer, so `interrupt` is called first to
+     * wake it if it is still receiving. The error that this causes is not a receive error.
+     */
+    template <typename Interrupt>
+    void cancel(Interrupt&& interrupt) noexcept {
+        bool receiving = false;
+        {
+            std::unique_lock lk{_mutex};
+            _cancelled   = true;
+            receiving    = !_done && !_error;
+            _interrupted = receiving;
+        }
+        _cv.notify_all();
+        if (receiving) {
+            interrupt();
+        }
+        _thread.join();
+    }
+
+    /// Discard the rest of the body and wait for the receiving thread to exit
+    void drain() {
+        while (underflow() != traits_type::eof()) {
+            setg(eback(), egptr(), egptr());
+        }
+        _thread.join();
+    }
+
+    /// The error that stopped the body from being received, if any
+    std::exception_ptr receive_error() const noexcept {
+        return _interrupted ? std::exception_ptr{} : _error;
+    }
+};
+
+/**
+ * @brief Rethrow an error from the thread that received a response body.
+ *
+ * The error information that was loaded on the receiving thread stays with that thread, so what
+ * is known about the response is loaded again on the thread that reports the error.
+ */
+[[noreturn]] void rethrow_received_error(std::exception_ptr        error,
+                                         const network_origin&     origin,
+                                         const http_response_info& resp) {
+    try {
+        std::rethrow_exception(error);
+    } catch (const boost::leaf::error_id& id) {
+        id.load(origin, resp);
+        throw;
+    } catch (...) {
+        boost::leaf::new_error(origin, resp);
+        throw;
+    }
+}
+
 }  // namespace
 
 std::unique_ptr<erased_message_body> http_client::_make_body_reader(const http_response_info& res) {
@@ -399,6 +739,37 @@ std::unique_ptr<erased_message_body> http_client::_make_body_reader(const http_r
     });
 }
 
+void http_client::recv_body_stream(const http_response_info&          resp,
+                                   std::function<void(std::istream&)> fn) {
+    auto                    reader = _make_body_reader(resp);
+    threaded_body_streambuf buf{*reader};
+    std::istream            in{&buf};
+    std::exception_ptr      fn_error;
+    try {
+        fn(in);
+    } catch (...) {
+        fn_error = std::current_exception();
+    }
+    if (fn_error) {
+        // The body was not read to its end, so the connection cannot be reused anyway. Shut it
+        // down so that the receiving thread is not left waiting for data that will never come.
+        buf.cancel([&] { _impl->shutdown(); });
+    } else {
+        buf.drain();
+    }
+    // A failure to receive the body is more useful to report than whatever it caused in `fn`
+    if (auto error = buf.receive_error()) {
+        // The body was not read to its end, so this connection cannot be reused
+        abort_client();
+        rethrow_received_error(error, _impl->origin, resp);
+    }
+    if (fn_error) {
+        abort_client();
+        std::rethrow_exception(fn_error);
+    }
+    _set_ready();
+}
+
 void http_client::discard_body(const http_response_info& resp) {
     auto  reader_ = _make_body_reader(resp);
     auto& reader  = *reader_;
@@ -444,7 +815,7 @@ request_result http_pool::request(neo::url_view url_, http_request_params params
 
         if (resp.not_modified()) {
             // Not Modified, a cache hit
-            return {std::move(client), std::move(resp)};
+            return {std::move(client), std::move(resp), url};
         }
 
         if (resp.is_error()) {
@@ -484,11 +855,16 @@ request_result http_pool::request(neo::url_view url_, http_request_params params
             continue;
         }
 
-        return {std::move(client), std::move(resp)};
+        return {std::move(client), std::move(resp), url};
     }
     neo::unreachable();
 }
 
+void bpt::request_result::read_body_stream(std::function<void(std::istream&)> fn) {
+    BPT_E_SCOPE(url);
+    client.recv_body_stream(resp, std::move(fn));
+}
+
 void bpt::request_result::save_file(const std::filesystem::path& dest) {
     auto out = neo::file_stream::open(dest, neo::open_mode::write);
     client.recv_body_into(resp, neo::stream_io_buffers(out));
@@ -12,7 +12,11 @@
 #include <neo/url/view.hpp>
 #include <neo/utility.hpp>
 
+#include <chrono>
+#include <exception>
 #include <filesystem>
+#include <functional>
+#include <iosfwd>
 #include <memory>
 
 namespace bpt {
@@ -46,7 +50,7 @@ class http_client {
 
     std::weak_ptr<detail::http_pool_impl>     _pool;
     std::shared_ptr<detail::http_client_impl> _impl;
-    int                                       _n_exceptions;
+    int                                       _n_exceptions = std::uncaught_exceptions();
 
     http_client() = default;
 
@@ -93,6 +97,15 @@ public:
         _set_ready();
     }
 
+    /**
+     * @brief Read the body of the given response as a stream, while it is still being received.
+     *
+     * The body is received on a background thread and handed over in chunks, so that `fn` can
+     * process one part of the body while the next is still in flight. Whatever part of the body
+     * `fn` leaves unread is discarded.
+     */
+    void recv_body_stream(const http_response_info& resp, std::function<void(std::istream&)> fn);
+
     void discard_body(const http_response_info&);
 
     void abort_client() noexcept;
@@ -101,27 +114,52 @@ public:
 struct request_result {
     http_client        client;
     http_response_info resp;
+    /// The URL of the response, after any redirects were followed
+    neo::url url;
 
     void discard_body() { client.discard_body(resp); }
 
     void save_file(std::filesystem::path const&);
+
+    /**
+     * @brief Read the body as a stream. @see http_client::recv_body_stream
+     *
+     * An error that is raised while the body is received carries the URL of the response.
+     */
+    void read_body_stream(std::function<void(std::istream&)> fn);
+};
+
+/**
+ * @brief Controls how many connections an @ref http_pool keeps, and for how long
+ */
+struct http_pool_options {
+    /// The greatest number of connections that may be open to a single origin at once. Requests
+    /// beyond this wait for a connection to be returned to the pool, in the order they were made.
+    int max_per_origin = 6;
+    /// Idle connections are closed rather than reused after this long, since servers commonly
+    /// close idle keep-alive connections after only a few seconds.
+    std::chrono::milliseconds idle_timeout{4000};
 };
 
+/**
+ * @brief A pool of keep-alive connections that may be shared between threads.
+ *
+ * Connections are handed out by origin. A connection is returned to the pool when its
+ * @ref http_client is dropped with its response fully read, so that another request (from any
+ * thread) can reuse it. TLS sessions are remembered for the whole process, so a new connection to
+ * a server that has been seen before can skip the full handshake.
+ */
 class http_pool {
     friend class http_client;
     std::shared_ptr<detail::http_pool_impl> _impl;
 
 public:
-    http_pool();
+    explicit http_pool(http_pool_options opts = {});
     http_pool(http_pool&&) = default;
     http_pool& operator=(http_pool&&) = default;
     ~http_pool();
 
-    static http_pool& thread_local_pool() {
-        thread_local http_pool inst;
-        return inst;
-    }
-
+    /// The pool that is shared by the whole process
     static http_pool& global_pool() {
         static http_pool inst;
         return inst;
@@ -1,5 +1,7 @@
 #include "./pool.hpp"
 
+#include <bpt/error/try_catch.hpp>
+
 #include <neo/string_io.hpp>
 #include <neo/url.hpp>
 
@@ -23,3 +25,203 @@ TEST_CASE("Issue a request on a pool") {
     auto           resp = pool.request(neo::url::parse("https://www.google.com"));
     resp.discard_body();
 }
+
+#if !_WIN32
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <istream>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief A local TCP socket that is listening but never responds. Connections to it are completed
+ * by the kernel, so it stands in for a server when only the number of connections matters.
+ */
+class silent_listener {
+    int              _fd = -1;
+    std::uint16_t    _port;
+    std::vector<int> _accepted;
+
+public:
+    silent_listener() {
+        _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(_fd >= 0);
+        ::sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        REQUIRE(::bind(_fd, reinterpret_cast<::sockaddr*>(&addr), sizeof addr) == 0);
+        REQUIRE(::listen(_fd, 16) == 0);
+        ::socklen_t len = sizeof addr;
+        REQUIRE(::getsockname(_fd, reinterpret_cast<::sockaddr*>(&addr), &len) == 0);
+        _port = ntohs(addr.sin_port);
+        ::fcntl(_fd, F_SETFL, ::fcntl(_fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    ~silent_listener() {
+        for (auto fd : _accepted) {
+            ::close(fd);
+        }
+        ::close(_fd);
+    }
+
+    bpt::network_origin origin() const { return {"http", "127.0.0.1", _port}; }
+
+    /// The number of connections that have been made so far
+    std::size_t n_connections() {
+        for (int fd; (fd = ::accept(_fd, nullptr, nullptr)) >= 0;) {
+            _accepted.push_back(fd);
+        }
+        return _accepted.size();
+    }
+};
+
+/**
+ * @brief A local TCP server that accepts a single connection, sends a fixed response to the first
+ * request on it, and then closes it.
+ */
+class canned_responder {
+    int           _fd = -1;
+    std::uint16_t _port;
+    std::thread   _thread;
+
+public:
+    explicit canned_responder(std::string response) {
+        _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(_fd >= 0);
+        ::sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        REQUIRE(::bind(_fd, reinterpret_cast<::sockaddr*>(&addr), sizeof addr) == 0);
+        REQUIRE(::listen(_fd, 1) == 0);
+        ::socklen_t len = sizeof addr;
+        REQUIRE(::getsockname(_fd, reinterpret_cast<::sockaddr*>(&addr), &len) == 0);
+        _port   = ntohs(addr.sin_port);
+        _thread = std::thread([this, response = std::move(response)] {
+            int conn = ::accept(_fd, nullptr, nullptr);
+            if (conn < 0) {
+                return;
+            }
+            // Wait for the end of the request head
+            std::string request;
+            char        buf[1024];
+            while (request.find("\r\n\r\n") == request.npos) {
+                auto n = ::read(conn, buf, sizeof buf);
+                if (n <= 0) {
+                    break;
+                }
+                request.append(buf, static_cast<std::size_t>(n));
+            }
+            for (std::size_t sent = 0; sent < response.size();) {
+                auto n = ::write(conn, response.data() + sent, response.size() - sent);
+                if (n <= 0) {
+                    break;
+                }
+                sent += static_cast<std::size_t>(n);
+            }
+            ::close(conn);
+        });
+    }
+
+    ~canned_responder() {
+        ::shutdown(_fd, SHUT_RDWR);
+        _thread.join();
+        ::close(_fd);
+    }
+
+    std::string url(std::string_view path) const {
+        return "http://127.0.0.1:" + std::to_string(_port) + std::string(path);
+    }
+};
+
+}  // namespace
+
+TEST_CASE("Reuse an idle connection") {
+    silent_listener server;
+    bpt::http_pool  pool;
+    { auto cl = pool.client_for_origin(server.origin()); }
+    { auto cl = pool.client_for_origin(server.origin()); }
+    CHECK(server.n_connections() == 1);
+}
+
+TEST_CASE("Close connections that have been idle for too long") {
+    silent_listener server;
+    bpt::http_pool  pool{{.idle_timeout = std::chrono::milliseconds{1}}};
+    { auto cl = pool.client_for_origin(server.origin()); }
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    { auto cl = pool.client_for_origin(server.origin()); }
+    CHECK(server.n_connections() == 2);
+}
+
+TEST_CASE("Wait in line for a connection beyond the per-origin limit") {
+    using namespace std::chrono_literals;
+    silent_listener server;
+    bpt::http_pool  pool{{.max_per_origin = 1}};
+
+    std::mutex       mut;
+    std::vector<int> order;
+    std::atomic<int> n_waiting = 0;
+
+    auto first = std::make_optional(pool.client_for_origin(server.origin()));
+    auto wait_for_client = [&](int id) {
+        ++n_waiting;
+        auto             cl = pool.client_for_origin(server.origin());
+        std::unique_lock lk{mut};
+        order.push_back(id);
+    };
+    // Each waiter is given time to join the line before the next one
+    std::thread a{wait_for_client, 1};
+    std::this_thread::sleep_for(50ms);
+    std::thread b{wait_for_client, 2};
+    std::this_thread::sleep_for(50ms);
+    CHECK(n_waiting == 2);
+    {
+        std::unique_lock lk{mut};
+        CHECK(order.empty());
+    }
+
+    first.reset();
+    a.join();
+    b.join();
+    CHECK(order == std::vector{1, 2});
+    // Only one connection was ever opened, and it was handed from one client to the next
+    CHECK(server.n_connections() == 1);
+}
+
+TEST_CASE("An error while receiving a streamed body carries the context of the response") {
+    // The body is received on another thread, and fails there, as it is not gzip data
+    canned_responder server{
+        "HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: gzip\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "This is not gzip data"};
+    bpt::http_pool pool;
+    auto           res = pool.request(neo::url::parse(server.url("/body")));
+    bpt_leaf_try {
+        res.read_body_stream([](std::istream& in) {
+            in.ignore(std::numeric_limits<std::streamsize>::max());
+        });
+        FAIL_CHECK("Expected an error");
+    }
+    bpt_leaf_catch(neo::url url, bpt::network_origin origin, bpt::http_response_info resp) {
+        CHECK(url.path == "/body");
+        CHECK(origin.hostname == "127.0.0.1");
+        CHECK(resp.status == 200);
+    }
+    bpt_leaf_catch_all { FAIL_CHECK("Incorrect error: " << diagnostic_info); };
+}
+
+#endif
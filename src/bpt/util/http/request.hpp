@@ -15,6 +15,11 @@ struct http_request_params {
 
     std::string_view prior_etag{};
     std::string_view last_modified{};
+
+    /// If non-empty, the value of a 'Range' header, e.g. "bytes=1024-"
+    std::string_view range{};
+    /// If non-empty (and a range is given), only honor the range if the ETag still matches this
+    std::string_view if_range{};
 };
 
 }  // namespace bpt
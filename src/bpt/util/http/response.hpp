@@ -20,6 +20,7 @@ struct http_response_info {
     bool is_error() const noexcept { return is_client_error() || is_server_error(); }
     bool is_redirect() const noexcept { return status >= 300 && status < 400; }
     bool not_modified() const noexcept { return status == 304; }
+    bool is_partial_content() const noexcept { return status == 206; }
 
     std::optional<std::string_view> header_value(std::string_view key) const noexcept;
     std::optional<int>              content_length() const noexcept;
@@ -28,6 +29,7 @@ struct http_response_info {
     auto transfer_encoding() const noexcept { return header_value("Transfer-Encoding"); }
     auto etag() const noexcept { return header_value("ETag"); }
     auto last_modified() const noexcept { return header_value("Last-Modified"); }
+    auto content_range() const noexcept { return header_value("Content-Range"); }
 };
 
 }  // namespace bpt
@@ -3,9 +3,16 @@
 #include <neo/assert.hpp>
 #include <neo/event.hpp>
 
+#include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
 #include <ostream>
+#include <string>
+#include <thread>
 
 #if _WIN32
 #include <consoleapi2.h>
@@ -19,44 +26,222 @@ static void set_utf8_output() {
 }
 #endif
 
+namespace {
+
+spdlog::level::level_enum to_spdlog_level(bpt::log::level l, std::string_view msg) {
+    using bpt::log::level;
+    switch (l) {
+    case level::trace:
+        return spdlog::level::trace;
+    case level::debug:
+        return spdlog::level::debug;
+    case level::info:
+        return spdlog::level::info;
+    case level::warn:
+        return spdlog::level::warn;
+    case level::error:
+        return spdlog::level::err;
+    case level::critical:
+        return spdlog::level::critical;
+    case level::silent:
+        return spdlog::level::off;
+    }
+    neo_assert_always(invariant, false, "Invalid log level", msg, int(l));
+}
+
+/**
+ * @brief Writes log messages to the terminal on a dedicated thread.
+ *
+ * Worker threads hand their formatted messages to a bounded queue and carry on, rather than
+ * blocking on terminal I/O. Messages from the main thread, and errors from any thread, first drain
+ * the queue and are then written directly, so they stay ordered with everything logged before them
+ * and with the program's own output. An optional status line is kept beneath the messages and
+ * redrawn whenever they are written.
+ */
+class log_writer {
+    struct record {
+        bpt::log::level level;
+        std::string     message;
+    };
+
+    // Producers block when this many messages are waiting to be written
+    static constexpr std::size_t max_pending = 1024;
+
+    spdlog::logger* _logger;
+    // The stream that the logger and the status line write to
+    std::FILE* _out = stdout;
+    // Owns the logger once output has been moved to stderr
+    std::shared_ptr<spdlog::logger> _stderr_logger;
+
+    std::mutex              _mut;
+    std::condition_variable _cv_pending;
+    std::condition_variable _cv_space;
+    std::condition_variable _cv_drained;
+    std::deque<record>      _pending;
+    bool                    _writing = false;
+    bool                    _done    = false;
+    // The status line to be kept beneath the log output, and whether it needs to be redrawn
+    std::string _status;
+    bool        _status_dirty = false;
+    // Whether the status line is currently on the terminal. Only touched by whoever is writing.
+    bool _status_shown = false;
+
+    std::thread::id         _main_thread_id;
+    std::thread             _thread;
+
+    void _write(bpt::log::level l, std::string_view msg) {
+        _logger->log(to_spdlog_level(l, msg), msg);
+    }
+
+    /// Write a group of messages, moving the status line (if any) below them
+    template <typename Func>
+    void _write_around_status(std::string_view status, Func&& write_messages) {
+        if (_status_shown) {
+            std::fputs("\r\x1b[K", _out);
+            _status_shown = false;
+        }
+        write_messages();
+        _logger->flush();
+        if (!status.empty()) {
+            std::fwrite(status.data(), 1, status.size(), _out);
+            _status_shown = true;
+        }
+        std::fflush(_out);
+    }
+
+    void _run() {
+        std::unique_lock lk{_mut};
+        while (true) {
+            _cv_pending.wait(lk, [&] { return _done || !_pending.empty() || _status_dirty; });
+            if (_done && _pending.empty()) {
+                break;
+            }
+            auto batch    = std::exchange(_pending, {});
+            auto status   = _status;
+            _status_dirty = false;
+            _writing      = true;
+            lk.unlock();
+            _cv_space.notify_all();
+            _write_around_status(status, [&] {
+                for (auto& rec : batch) {
+                    _write(rec.level, rec.message);
+                }
+            });
+            lk.lock();
+            _writing = false;
+            if (_pending.empty()) {
+                _cv_drained.notify_all();
+            }
+        }
+    }
+
+    void _wait_drained(std::unique_lock<std::mutex>& lk) {
+        _cv_drained.wait(lk, [&] { return _pending.empty() && !_writing; });
+    }
+
+public:
+    log_writer()
+        : _logger(spdlog::default_logger_raw()) {
+        _logger->set_level(spdlog::level::trace);
+        set_utf8_output();
+        _thread = std::thread([this] { _run(); });
+    }
+
+    ~log_writer() {
+        {
+            std::unique_lock lk{_mut};
+            _done = true;
+        }
+        _cv_pending.notify_one();
+        _thread.join();
+        if (_status_shown) {
+            std::fputs("\r\x1b[K", _out);
+            std::fflush(_out);
+        }
+    }
+
+    void set_main_thread() noexcept {
+        std::unique_lock lk{_mut};
+        _main_thread_id = std::this_thread::get_id();
+    }
+
+    void print(bpt::log::level l, std::string_view msg) {
+        std::unique_lock lk{_mut};
+        if (int(l) >= int(bpt::log::level::error)
+            || std::this_thread::get_id() == _main_thread_id) {
+            _wait_drained(lk);
+            // Hold the lock while writing so that nothing queued after us can be written first
+            _write_around_status(_status, [&] { _write(l, msg); });
+            return;
+        }
+        _cv_space.wait(lk, [&] { return _pending.size() < max_pending; });
+        _pending.push_back(record{l, std::string(msg)});
+        lk.unlock();
+        _cv_pending.notify_one();
+    }
+
+    void set_status(std::string_view status) {
+        std::unique_lock lk{_mut};
+        if (status == _status) {
+            return;
+        }
+        _status       = std::string(status);
+        _status_dirty = true;
+        lk.unlock();
+        _cv_pending.notify_one();
+    }
+
+    void flush() {
+        std::unique_lock lk{_mut};
+        _wait_drained(lk);
+    }
+
+    void redirect_to_stderr() {
+        std::unique_lock lk{_mut};
+        _wait_drained(lk);
+        if (_stderr_logger) {
+            return;
+        }
+        if (_status_shown) {
+            std::fputs("\r\x1b[K", _out);
+            std::fflush(_out);
+            _status_shown = false;
+            _status_dirty = true;
+        }
+        _stderr_logger = spdlog::stderr_color_mt("bpt-stderr");
+        _stderr_logger->set_level(spdlog::level::trace);
+        _logger = _stderr_logger.get();
+        _out    = stderr;
+        lk.unlock();
+        _cv_pending.notify_one();
+    }
+};
+
+log_writer& get_writer() {
+    static log_writer inst;
+    return inst;
+}
+
+}  // namespace
+
 void bpt::log::init_logger() noexcept {
     // spdlog::set_pattern("[%H:%M:%S] [%^%-5l%$] %v");
     spdlog::set_pattern("[%^%-5l%$] %v");
+    get_writer().set_main_thread();
 }
 
 void bpt::log::ev_log::print() const noexcept { log_print(level, message); }
 
 void bpt::log::log_print(bpt::log::level l, std::string_view msg) noexcept {
-    static auto logger_inst = [] {
-        auto logger = spdlog::default_logger_raw();
-        logger->set_level(spdlog::level::trace);
-        set_utf8_output();
-        return logger;
-    }();
-
-    const auto lvl = [&] {
-        switch (l) {
-        case level::trace:
-            return spdlog::level::trace;
-        case level::debug:
-            return spdlog::level::debug;
-        case level::info:
-            return spdlog::level::info;
-        case level::warn:
-            return spdlog::level::warn;
-        case level::error:
-            return spdlog::level::err;
-        case level::critical:
-            return spdlog::level::critical;
-        case level::silent:
-            return spdlog::level::off;
-        }
-        neo_assert_always(invariant, false, "Invalid log level", msg, int(l));
-    }();
-
-    logger_inst->log(lvl, msg);
+    get_writer().print(l, msg);
 }
 
+void bpt::log::flush() noexcept { get_writer().flush(); }
+
+void bpt::log::set_status(std::string_view status) noexcept { get_writer().set_status(status); }
+
+void bpt::log::redirect_to_stderr() noexcept { get_writer().redirect_to_stderr(); }
+
 void bpt::log::log_emit(bpt::log::ev_log ev) noexcept {
     if (!neo::get_event_subscriber<ev_log>()) {
         thread_local bool did_warn = false;
@@ -30,6 +30,27 @@ void log_emit(ev_log) noexcept;
 
 void init_logger() noexcept;
 
+/**
+ * @brief Block until every message logged so far has been written out.
+ *
+ * Messages logged from worker threads are written asynchronously. Call this before writing
+ * directly to the terminal or exiting to keep the output in order. Errors are always written
+ * synchronously.
+ */
+void flush() noexcept;
+
+/**
+ * @brief Keep a single status line beneath the log output, redrawing it as messages are written.
+ * Only meaningful when the output is a terminal. Pass an empty string to remove it.
+ */
+void set_status(std::string_view status) noexcept;
+
+/**
+ * @brief Write all further log output to stderr rather than stdout. Used by commands whose stdout
+ * is meant to be consumed by other programs.
+ */
+void redirect_to_stderr() noexcept;
+
 template <typename T>
 concept formattable = requires(const T item) {
     fmt::format("{}", item);
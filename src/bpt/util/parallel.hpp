@@ -60,6 +60,8 @@ bool parallel_run(Range&& rng, int n_jobs, Func&& fn) {
     for (auto& t : threads) {
         t.join();
     }
+    // Let the workers' messages reach the terminal before the caller carries on
+    log::flush();
     for (auto eptr : exceptions) {
         log_exception(eptr);
     }
@@ -30,6 +30,8 @@ struct proc_result {
     int         retc      = 0;
     bool        timed_out = false;
     std::string output;
+    /// Everything the process wrote to `proc_options::aux_output_fd`, if that was requested
+    std::string aux_output;
 
     bool okay() const noexcept { return retc == 0 && signal == 0; }
 };
@@ -43,6 +45,13 @@ struct proc_options {
      * Timeout for the subprocess, in milliseconds. If zero, will wait forever
      */
     std::optional<std::chrono::milliseconds> timeout = std::nullopt;
+
+    /**
+     * If set, the child process will have a pipe open at this file descriptor number, and everything
+     * it writes to that pipe is collected in `proc_result::aux_output`. The child can refer to it by
+     * the path `/dev/fd/<N>`. Only supported on POSIX systems.
+     */
+    std::optional<int> aux_output_fd = std::nullopt;
 };
 
 proc_result run_proc(const proc_options& opts);
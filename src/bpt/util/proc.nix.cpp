@@ -8,6 +8,7 @@
 
 #include <neo/scope.hpp>
 
+#include <fcntl.h>
 #include <poll.h>
 #include <signal.h>
 #include <sys/wait.h>
@@ -17,6 +18,7 @@
 #include <cerrno>
 #include <deque>
 #include <iostream>
+#include <mutex>
 #include <system_error>
 
 using namespace bpt;
@@ -29,7 +31,31 @@ void check_rc(bool b, std::string_view s) {
     }
 }
 
-::pid_t spawn_child(const proc_options& opts, int stdout_pipe, int close_me) noexcept {
+#if __APPLE__
+/// There is no pipe2() on macOS. Forks made here wait while a pipe is being created, so that they
+/// cannot inherit it before it is marked close-on-exec.
+std::mutex pipe_fork_mutex;
+#endif
+
+/**
+ * Create a pipe whose ends are both close-on-exec, so that they do not leak into other
+ * subprocesses that are spawned concurrently. (If they did, we would not see EOF until those exit.)
+ */
+int open_cloexec_pipe(int (&fds)[2]) noexcept {
+#if __APPLE__
+    std::scoped_lock lk{pipe_fork_mutex};
+    if (::pipe(fds) != 0) {
+        return -1;
+    }
+    ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+#else
+    return ::pipe2(fds, O_CLOEXEC);
+#endif
+}
+
+::pid_t spawn_child(const proc_options& opts, int stdout_pipe, int close_me, int aux_pipe) noexcept {
     // We must allocate BEFORE fork(), since the CRT might stumble with malloc()-related locks that
     // are held during the fork().
     std::vector<const char*> strings;
@@ -44,6 +70,9 @@ void check_rc(bool b, std::string_view s) {
         = fmt::format("[bpt child executor] The requested executable [{}] could not be found.",
                       strings[0]);
 
+#if __APPLE__
+    std::unique_lock lk{pipe_fork_mutex};
+#endif
     auto child_pid = ::fork();
     if (child_pid != 0) {
         return child_pid;
@@ -54,6 +83,15 @@ void check_rc(bool b, std::string_view s) {
     check_rc(rc != -1, "Failed to dup2 stdout");
     rc = dup2(stdout_pipe, STDERR_FILENO);
     check_rc(rc != -1, "Failed to dup2 stderr");
+    if (opts.aux_output_fd) {
+        if (aux_pipe == *opts.aux_output_fd) {
+            // Already in place. Just make sure it survives the exec()
+            rc = ::fcntl(aux_pipe, F_SETFD, 0);
+        } else {
+            rc = dup2(aux_pipe, *opts.aux_output_fd);
+        }
+        check_rc(rc != -1, "Failed to set up the auxiliary output pipe");
+    }
     rc = ::chdir(workdir.data());
     check_rc(rc != -1, "Failed to chdir() for subprocess");
 
@@ -75,7 +113,7 @@ void check_rc(bool b, std::string_view s) {
 proc_result bpt::run_proc(const proc_options& opts) {
     bpt_log(debug, "Spawning subprocess: {}", quote_command(opts.command));
     int  stdio_pipe[2] = {};
-    auto rc            = ::pipe(stdio_pipe);
+    auto rc            = open_cloexec_pipe(stdio_pipe);
     check_rc(rc == 0, "Create stdio pipe for subprocess");
 
     int read_pipe  = stdio_pipe[0];
@@ -83,15 +121,35 @@ proc_result bpt::run_proc(const proc_options& opts) {
 
     neo_defer { ::close(read_pipe); };
 
-    auto child = spawn_child(opts, write_pipe, read_pipe);
+    int aux_pipe[2] = {-1, -1};
+    if (opts.aux_output_fd) {
+        // The child will clear the close-on-exec flag on its own copy
+        rc = open_cloexec_pipe(aux_pipe);
+        check_rc(rc == 0, "Create auxiliary output pipe for subprocess");
+    }
+    neo_defer {
+        if (aux_pipe[0] != -1) {
+            ::close(aux_pipe[0]);
+        }
+    };
+
+    auto child = spawn_child(opts, write_pipe, read_pipe, aux_pipe[1]);
 
     ::close(write_pipe);
+    if (aux_pipe[1] != -1) {
+        ::close(aux_pipe[1]);
+    }
 
-    pollfd stdio_fd;
-    stdio_fd.fd     = read_pipe;
-    stdio_fd.events = POLLIN;
+    // Poll on stdio, and the auxiliary pipe if we have one. A negative fd is ignored by poll().
+    pollfd poll_fds[2];
+    poll_fds[0].fd     = read_pipe;
+    poll_fds[0].events = POLLIN;
+    poll_fds[1].fd     = aux_pipe[0];
+    poll_fds[1].events = POLLIN;
 
     proc_result res;
+    // The strings that receive the output of each polled pipe
+    std::string* const poll_outputs[2] = {&res.output, &res.aux_output};
 
     using namespace std::chrono_literals;
 
@@ -102,12 +160,15 @@ proc_result bpt::run_proc(const proc_options& opts) {
     if (opts.timeout) {
         timeout = *opts.timeout;
     }
-    while (true) {
-        rc = ::poll(&stdio_fd, 1, static_cast<int>(timeout.count()));
-        if (rc && errno == EINTR) {
+    std::string buffer;
+    buffer.resize(1024);
+    while (poll_fds[0].fd != -1 || poll_fds[1].fd != -1) {
+        rc = ::poll(poll_fds, 2, static_cast<int>(timeout.count()));
+        if (rc == -1 && errno == EINTR) {
             errno = 0;
             continue;
         }
+        check_rc(rc >= 0, "Failed in poll()");
         if (rc == 0) {
             // Timeout!
             ::kill(child, SIGINT);
@@ -116,14 +177,20 @@ proc_result bpt::run_proc(const proc_options& opts) {
             bpt_log(debug, "Subprocess [{}] timed out", quote_command(opts.command));
             continue;
         }
-        std::string buffer;
-        buffer.resize(1024);
-        auto nread = ::read(stdio_fd.fd, buffer.data(), buffer.size());
-        if (nread == 0) {
-            break;
+        for (auto i = 0; i < 2; ++i) {
+            auto& pfd = poll_fds[i];
+            if (pfd.fd == -1 || pfd.revents == 0) {
+                continue;
+            }
+            auto nread = ::read(pfd.fd, buffer.data(), buffer.size());
+            if (nread == 0) {
+                // EOF. Stop polling this one.
+                pfd.fd = -1;
+                continue;
+            }
+            check_rc(nread > 0, "Failed in read()");
+            poll_outputs[i]->append(buffer.begin(), buffer.begin() + nread);
         }
-        check_rc(nread > 0, "Failed in read()");
-        res.output.append(buffer.begin(), buffer.begin() + nread);
     }
 
     int status = 0;
@@ -0,0 +1,41 @@
+#include "./proc.hpp"
+
+#include <catch2/catch.hpp>
+
+#if !_WIN32
+
+TEST_CASE("Collect the auxiliary output of a subprocess") {
+    auto res = bpt::run_proc(bpt::proc_options{
+        .command       = {"/bin/sh", "-c", "echo to-stdout; echo to-aux >&3; echo to-stderr >&2"},
+        .aux_output_fd = 3,
+    });
+    CHECK(res.okay());
+    // The auxiliary output is kept apart from stdout and stderr, which share a pipe
+    CHECK(res.aux_output == "to-aux\n");
+    CHECK(res.output.find("to-stdout\n") != std::string::npos);
+    CHECK(res.output.find("to-stderr\n") != std::string::npos);
+    CHECK(res.output.find("to-aux") == std::string::npos);
+}
+
+TEST_CASE("Collect auxiliary output larger than a pipe buffer") {
+    // Both pipes must be drained as they fill, or the child would block on a full pipe
+    auto res = bpt::run_proc(bpt::proc_options{
+        .command = {"/bin/sh",
+                    "-c",
+                    "i=0; while [ $i -lt 20000 ]; do echo aux-line >&3; echo out-line; "
+                    "i=$((i+1)); done"},
+        .aux_output_fd = 3,
+    });
+    CHECK(res.okay());
+    CHECK(res.aux_output.size() == 20000 * std::string_view("aux-line\n").size());
+    CHECK(res.output.size() == 20000 * std::string_view("out-line\n").size());
+}
+
+TEST_CASE("No auxiliary output is collected unless requested") {
+    auto res = bpt::run_proc({"/bin/sh", "-c", "echo hello"});
+    CHECK(res.okay());
+    CHECK(res.output == "hello\n");
+    CHECK(res.aux_output.empty());
+}
+
+#endif
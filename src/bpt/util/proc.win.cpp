@@ -43,6 +43,10 @@ proc_result bpt::run_proc(const proc_options& opts) {
     auto cmd_str  = quote_command(opts.command);
     auto cmd_wide = widen(cmd_str);
     bpt_log(debug, "Spawning subprocess: {}", cmd_str);
+    neo_assert(expects,
+               !opts.aux_output_fd.has_value(),
+               "Auxiliary output pipes are not supported on Windows",
+               cmd_str);
 
     ::SECURITY_ATTRIBUTES security = {};
     security.bInheritHandle        = TRUE;
@@ -0,0 +1,127 @@
+"""
+Benchmarks of bpt's own build overhead, using synthetic projects and a stub toolchain that does no
+real work. Run with ``--bench``, and use ``--bench-results`` to choose where the JSON results are
+written.
+"""
+
+from __future__ import annotations
+
+import json
+import multiprocessing
+import platform
+import shutil
+import subprocess
+import sys
+import time
+from pathlib import Path
+from typing import Iterator
+
+import pytest
+from _pytest.config import Config as PyTestConfig
+
+from bpt_ci import paths
+from bpt_ci.testing import Project
+from bpt_ci.testing.synth import (SyntheticProject, SyntheticProjectSpec, generate_project, time_scenario, touch,
+                                  write_stub_toolchain)
+from bpt_ci.util import JSONishDict
+
+pytestmark = pytest.mark.skipif(sys.platform == 'win32', reason='The stub toolchain requires a POSIX shell')
+
+BenchResults = JSONishDict
+
+
+@pytest.fixture(scope='module')
+def bench_results(pytestconfig: PyTestConfig) -> Iterator[BenchResults]:
+    """
+    Collects the results of each benchmark, and writes them as JSON once all of them have run
+    """
+    results: BenchResults = {}
+    yield results
+    if not results:
+        return
+    dest = Path(pytestconfig.getoption('--bench-results') or paths.BUILD_DIR / 'bench-results.json')
+    dest.parent.mkdir(exist_ok=True, parents=True)
+    data = {
+        'timestamp': time.time(),
+        'platform': platform.platform(),
+        'cpu_count': multiprocessing.cpu_count(),
+        'benchmarks': results,
+    }
+    dest.write_text(json.dumps(data, indent=2), encoding='utf-8')
+    print(f'Benchmark results written to {dest}')
+
+
+def _build(proj: Project, tc: Path) -> None:
+    proj.build(toolchain=tc, fixup_toolchain=False, with_tests=False, log_level='info')
+
+
+def _last_run_compile_count(proj: Project) -> int:
+    res = subprocess.run([proj.bpt.path, 'build-stats', f'--out={proj.build_root}', '--json'],
+                         check=True,
+                         stdout=subprocess.PIPE)
+    runs = json.loads(res.stdout)['runs']
+    return runs[-1]['steps'].get('compile', {}).get('count', 0)
+
+
+def _generate(proj: Project, spec: SyntheticProjectSpec) -> tuple[SyntheticProject, Path]:
+    synth = generate_project(proj.root, spec)
+    tc = write_stub_toolchain(proj.root / '_stub-toolchain')
+    return synth, tc
+
+
+def test_stub_toolchain_build(tmp_project: Project) -> None:
+    """
+    Check that the stub toolchain reports dependencies well enough for incremental builds to work,
+    so that the benchmarks measure what they claim to
+    """
+    spec = SyntheticProjectSpec(n_libs=3, n_sources=4, header_fanout=2, dep_depth=3)
+    synth, tc = _generate(tmp_project, spec)
+    _build(tmp_project, tc)
+
+    touch(synth.any_source)
+    _build(tmp_project, tc)
+    assert _last_run_compile_count(tmp_project) == 1
+
+    # Two sources in each of the three libraries include the header, directly or through the chain
+    touch(synth.most_used_header)
+    _build(tmp_project, tc)
+    assert _last_run_compile_count(tmp_project) >= 2 * 3
+
+
+@pytest.mark.bench
+@pytest.mark.parametrize('name, spec', [
+    ('small', SyntheticProjectSpec(n_libs=4, n_sources=10, header_fanout=3, dep_depth=2)),
+    ('default', SyntheticProjectSpec()),
+    ('deep', SyntheticProjectSpec(n_libs=16, n_sources=20, header_fanout=8, dep_depth=16)),
+    ('wide', SyntheticProjectSpec(n_libs=32, n_sources=50, header_fanout=5, dep_depth=1)),
+])
+def test_build_overhead(tmp_project: Project, bench_results: BenchResults, name: str,
+                        spec: SyntheticProjectSpec) -> None:
+    """
+    Time clean, no-op, and incremental builds of a synthetic project
+    """
+    synth, tc = _generate(tmp_project, spec)
+    repeat = 5
+
+    def clean() -> None:
+        shutil.rmtree(tmp_project.build_root, ignore_errors=True)
+
+    def build() -> None:
+        _build(tmp_project, tc)
+
+    def nothing() -> None:
+        pass
+
+    scenarios = [
+        time_scenario('clean', prepare=clean, run=build, repeat=repeat),
+        time_scenario('no-op', prepare=nothing, run=build, repeat=repeat),
+        time_scenario('touch-header', prepare=lambda: touch(synth.most_used_header), run=build, repeat=repeat),
+        time_scenario('touch-source', prepare=lambda: touch(synth.any_source), run=build, repeat=repeat),
+    ]
+    bench_results[name] = {
+        'spec': spec.to_json(),
+        'scenarios': {
+            s.name: s.to_json()
+            for s in scenarios
+        },
+    }
@@ -18,18 +18,24 @@ def pytest_addoption(parser: Any) -> None:
                      help='Run the exhaustive and intensive bpt-deps tests')
     parser.addoption('--bpt-exe', help='Path to the bpt executable under test', type=Path)
     parser.addoption('--git-exe', help='Path to the git executable', type=Path)
+    parser.addoption('--bench', action='store_true', default=False, help='Run the build performance benchmarks')
+    parser.addoption('--bench-results',
+                     help='Path to a JSON file in which benchmark results will be written',
+                     type=Path)
 
 
 def pytest_configure(config: Any) -> None:
     config.addinivalue_line('markers', 'deps_test: Deps tests are slow. Enable with --test-deps')
+    config.addinivalue_line('markers', 'bench: Benchmarks are slow and noisy. Enable with --bench')
 
 
 def pytest_collection_modifyitems(config: PyTestConfig, items: Any) -> None:
-    if config.getoption('--test-deps'):
-        return
+    run_deps = config.getoption('--test-deps')
+    run_bench = config.getoption('--bench')
     for item in items:
-        if 'deps_test' not in item.keywords:
-            continue
-        item.add_marker(
-            pytest.mark.skip(
-                reason='Exhaustive deps tests are slow and perform many Git clones. Use --test-deps to run them.'))
+        if 'deps_test' in item.keywords and not run_deps:
+            item.add_marker(
+                pytest.mark.skip(
+                    reason='Exhaustive deps tests are slow and perform many Git clones. Use --test-deps to run them.'))
+        if 'bench' in item.keywords and not run_bench:
+            item.add_marker(pytest.mark.skip(reason='Benchmarks are slow. Use --bench to run them.'))
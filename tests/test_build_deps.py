@@ -1,4 +1,5 @@
 import json
+from pathlib import Path
 
 import pytest
 
@@ -244,3 +245,69 @@ def test_cmake_transitive(bd_project: Project, tmp_crs_repo: CRSRepo, dir_render
     proc.check_run(['cmake', '-S', bd_project.root, '-B', bd_project.build_root])
     proc.check_run(['cmake', '--build', bd_project.build_root])
     proc.check_run(['ctest'], cwd=bd_project.build_root)
+
+
+def test_sync_when_cache_is_lacking(bd_project: Project, tmp_crs_repo: CRSRepo, dir_renderer: DirRenderer) -> None:
+    """The cached package listings are used until they cannot satisfy the dependencies"""
+
+    def render_foo(version: str) -> Path:
+        return dir_renderer.get_or_render(
+            f'lazy-foo-{version}', {
+                'pkg.json': json.dumps(make_simple_crs('foo', version)),
+                'src': {
+                    'foo.hpp': '#pragma once\nint foo_fun();\n',
+                    'foo.cpp': '#include "./foo.hpp"\nint foo_fun() { return 0; }\n',
+                },
+            })
+
+    tmp_crs_repo.import_(render_foo('1.2.3'))
+    bd_project.bpt.build_deps(['--no-default-repo', 'foo@1.2.3'], repos=[tmp_crs_repo.path])
+    tmp_crs_repo.import_(render_foo('1.4.0'))
+    # The cache knows of 'foo', but no version of it that will do, so the repository is synced again
+    bd_project.bpt.build_deps(['--no-default-repo', 'foo@1.4.0'], repos=[tmp_crs_repo.path])
+    assert bd_project.root.joinpath('_deps/foo@1.4.0~1').is_dir()
+
+
+def test_resolve_again_after_sync_during_solve(bd_project: Project, tmp_crs_repo: CRSRepo,
+                                               dir_renderer: DirRenderer) -> None:
+    """A sync that runs partway through a solve must not leave the solve with stale listings"""
+    foo_src = {
+        'foo.hpp': '#pragma once\nint foo_fun();\n',
+        'foo.cpp': '#include "./foo.hpp"\nint foo_fun() { return 0; }\n',
+    }
+    tmp_crs_repo.import_(
+        dir_renderer.get_or_render('mid-solve-foo-1.2.3', {
+            'pkg.json': json.dumps(make_simple_crs('foo', '1.2.3')),
+            'src': foo_src,
+        }))
+    bd_project.bpt.build_deps(['--no-default-repo', 'foo@1.2.3'], repos=[tmp_crs_repo.path])
+
+    bar = make_simple_crs('bar', '2.0.0')
+    bar['libraries'][0]['dependencies'] = [{
+        'name': 'foo',
+        'versions': [{
+            'low': '1.4.0',
+            'high': '2.0.0'
+        }],
+        'using': ['foo'],
+    }]
+    tmp_crs_repo.import_([
+        dir_renderer.get_or_render('mid-solve-foo-1.4.0', {
+            'pkg.json': json.dumps(make_simple_crs('foo', '1.4.0')),
+            'src': foo_src,
+        }),
+        dir_renderer.get_or_render(
+            'mid-solve-bar-2.0.0', {
+                'pkg.json': json.dumps(bar),
+                'src': {
+                    'bar.hpp': '#pragma once\nint bar_fun();\n',
+                    'bar.cpp': '#include "./bar.hpp"\n#include <foo.hpp>\nint bar_fun() { return foo_fun(); }\n',
+                },
+            }),
+    ])
+    # The cached listing of 'foo' is read first, and only has 1.2.3. Looking up 'bar' then finds
+    # nothing in the cache and syncs, after which bar@2.0.0 requires a 'foo' that the first
+    # listing did not have.
+    bd_project.bpt.build_deps(['--no-default-repo', 'foo^1.2.3', 'bar@2.0.0'], repos=[tmp_crs_repo.path])
+    assert bd_project.root.joinpath('_deps/foo@1.4.0~1').is_dir()
+    assert bd_project.root.joinpath('_deps/bar@2.0.0~1').is_dir()
@@ -0,0 +1,69 @@
+import json
+import sqlite3
+import subprocess
+
+from bpt_ci.testing import Project
+
+
+def test_build_stats_json(tmp_project: Project) -> None:
+    """
+    Check that the timings of a build are recorded and reported by 'bpt build-stats'
+    """
+    tmp_project.write('src/foo.cpp', 'int foo() { return 42; }')
+    tmp_project.write('src/foo.test.cpp', 'int foo(); int main() { return foo() - 42; }')
+    tmp_project.build()
+
+    res = subprocess.run([tmp_project.bpt.path, 'build-stats', f'--out={tmp_project.build_root}', '--json'],
+                         check=True,
+                         stdout=subprocess.PIPE)
+    report = json.loads(res.stdout)
+    assert len(report['compile']) == 2
+    assert [e['runs'] for e in report['test']] == [1]
+    assert report['link'], 'The test executable link was not recorded'
+    assert len(report['runs']) == 1
+    assert report['runs'][0]['steps']['compile']['count'] == 2
+
+
+def test_build_stats_headers(tmp_project: Project) -> None:
+    """
+    Check that a header shared by several compilations is reported with all of its dependents
+    """
+    tmp_project.write('src/common.hpp', '#pragma once\ninline int common() { return 1; }')
+    tmp_project.write('src/a.cpp', '#include "./common.hpp"\nint a() { return common(); }')
+    tmp_project.write('src/b.cpp', '#include "./common.hpp"\nint b() { return common(); }')
+    tmp_project.build()
+
+    res = subprocess.run(
+        [tmp_project.bpt.path, 'build-stats', f'--out={tmp_project.build_root}', '--json', '--headers'],
+        check=True,
+        stdout=subprocess.PIPE)
+    report = json.loads(res.stdout)
+    common = [h for h in report['headers'] if h['header'].endswith('common.hpp')]
+    assert len(common) == 1
+    # Both sources depend on it, as does the header's own isolation check
+    assert common[0]['dependents'] == 3
+    assert all(c['on_disk_input_bytes'] > 0 for c in report['compile_inputs'])
+
+
+def test_build_stats_other_version(tmp_project: Project) -> None:
+    """
+    Check that a build database of another bpt version is reported rather than upgraded
+    """
+    tmp_project.write('src/foo.cpp', 'int foo() { return 42; }')
+    tmp_project.build()
+
+    db_path = tmp_project.build_root / '.bpt.db'
+    with sqlite3.connect(db_path) as db:
+        db.execute("UPDATE bpt_meta_1 SET version='alpha-0'")
+    db.close()
+
+    res = subprocess.run([tmp_project.bpt.path, 'build-stats', f'--out={tmp_project.build_root}', '--json'],
+                         stdout=subprocess.PIPE,
+                         stderr=subprocess.PIPE)
+    assert res.returncode == 1
+    assert res.stdout == b'', 'Log output was written to stdout'
+    assert b'different version of bpt' in res.stderr
+    with sqlite3.connect(db_path) as db:
+        assert db.execute('SELECT version FROM bpt_meta_1').fetchone() == ('alpha-0', )
+        assert db.execute('SELECT count(*) FROM bpt_step_timings').fetchone()[0] > 0
+    db.close()
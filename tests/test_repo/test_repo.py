@@ -4,13 +4,14 @@ import tarfile
 import pytest
 import json
 import sqlite3
+import subprocess
 
 from bpt_ci.bpt import BPTWrapper
 from bpt_ci.paths import PROJECT_ROOT
-from bpt_ci.testing.http import HTTPServerFactory
+from bpt_ci.testing.http import HTTPServerFactory, ResumableHTTPServerFactory
 from bpt_ci.testing import Project
 from bpt_ci.testing.error import expect_error_marker
-from bpt_ci.testing.repo import CRSRepo, CRSRepoFactory, make_simple_crs
+from bpt_ci.testing.repo import CRSRepo, CRSRepoFactory, RepoCloner, make_simple_crs
 
 
 def test_repo_init(tmp_crs_repo: CRSRepo) -> None:
@@ -185,6 +186,53 @@ def test_pkg_prefetch_http_url(bpt: BPTWrapper, simple_repo: CRSRepo, http_serve
     assert tmp_path.joinpath('pkgs/test-pkg@1.2.43~1/pkg.json').is_file()
 
 
+def test_pkg_prefetch_many_http_url(bpt: BPTWrapper, simple_repo: CRSRepo, http_server_factory: HTTPServerFactory,
+                                    tmp_path: Path) -> None:
+    srv = http_server_factory(simple_repo.path)
+    bpt.crs_cache_dir = tmp_path
+    # The duplicate must only be fetched once, even though the fetches are concurrent
+    bpt.run([
+        'pkg', 'prefetch', '--no-default-repo', f'--use-repo={srv.base_url}', '--jobs=4', 'test-pkg@1.2.43',
+        'test-pkg@1.3.0', 'test-pkg@1.2.43'
+    ])
+    assert tmp_path.joinpath('pkgs/test-pkg@1.2.43~1/pkg.json').is_file()
+    assert list(tmp_path.glob('pkgs/test-pkg@1.3.0~*/pkg.json'))
+
+
+def test_pkg_prefetch_truncated_archive(bpt: BPTWrapper, simple_repo: CRSRepo, clone_repo: RepoCloner,
+                                        http_server_factory: HTTPServerFactory, tmp_path: Path) -> None:
+    repo = clone_repo(simple_repo)
+    tgz = repo.path / 'pkg/test-pkg/1.2.43~1/pkg.tgz'
+    content = tgz.read_bytes()
+    tgz.write_bytes(content[:len(content) // 2])
+    srv = http_server_factory(repo.path)
+    bpt.crs_cache_dir = tmp_path
+    with pytest.raises(subprocess.CalledProcessError):
+        bpt.pkg_prefetch(repos=[srv.base_url], pkgs=['test-pkg@1.2.43'])
+    # Nothing of the partially expanded package may be left where it would be mistaken for a good one
+    assert not tmp_path.joinpath('pkgs/test-pkg@1.2.43~1').exists()
+
+
+def test_pkg_prefetch_resume(bpt: BPTWrapper, simple_repo: CRSRepo,
+                             resumable_http_server_factory: ResumableHTTPServerFactory, tmp_path: Path) -> None:
+    tgz_path = 'pkg/test-pkg/1.2.43~1/pkg.tgz'
+    half = simple_repo.path.joinpath(tgz_path).stat().st_size // 2
+    srv, opts = resumable_http_server_factory(simple_repo.path)
+    bpt.crs_cache_dir = tmp_path
+    opts.cut_after[tgz_path] = half
+    with pytest.raises(subprocess.CalledProcessError):
+        bpt.pkg_prefetch(repos=[srv.base_url], pkgs=['test-pkg@1.2.43'])
+    # The part that was received is kept for the next attempt
+    partial_dir = tmp_path / 'pkgs/.bpt-partial'
+    assert [p.stat().st_size for p in partial_dir.glob('*.part')] == [half]
+
+    opts.cut_after.clear()
+    bpt.pkg_prefetch(repos=[srv.base_url], pkgs=['test-pkg@1.2.43'])
+    assert tmp_path.joinpath('pkgs/test-pkg@1.2.43~1/pkg.json').is_file()
+    assert f'bytes={half}-' in opts.ranges
+    assert not list(partial_dir.glob('*.part'))
+
+
 def test_pkg_prefetch_file_url(bpt: BPTWrapper, tmp_path: Path, simple_repo: CRSRepo) -> None:
     bpt.crs_cache_dir = tmp_path
     bpt.pkg_prefetch(repos=[str(simple_repo.path)], pkgs=['test-pkg@1.2.43'])
@@ -206,6 +254,110 @@ def test_pkg_prefetch_invalid_tgz(bpt: BPTWrapper, tmp_path: Path, http_server_f
         bpt.pkg_prefetch(repos=[srv.base_url])
 
 
+def test_pkg_prefetch_from_change_log(bpt: BPTWrapper, crs_repo_factory: CRSRepoFactory,
+                                      http_server_factory: HTTPServerFactory, tmp_path: Path) -> None:
+    repo = crs_repo_factory('change-log')
+    repo.import_(PROJECT_ROOT / 'data/simple.crs')
+    srv = http_server_factory(repo.path)
+    bpt.crs_cache_dir = tmp_path
+    bpt.pkg_prefetch(repos=[srv.base_url], pkgs=['test-pkg@1.2.43'])
+    repo.import_(PROJECT_ROOT / 'data/simple2.crs')
+    # Break the database download, so that the sync must use the change log to see the new package
+    repo.path.joinpath('repo.db.gz').write_text('lolhi')
+    bpt.pkg_prefetch(repos=[srv.base_url], pkgs=['test-pkg@1.3.0'])
+    assert list(tmp_path.glob('pkgs/test-pkg@1.3.0~*/pkg.json'))
+
+
+def test_pkg_prefetch_after_compacted_change_log(bpt: BPTWrapper, crs_repo_factory: CRSRepoFactory,
+                                                 http_server_factory: HTTPServerFactory, tmp_path: Path) -> None:
+    repo = crs_repo_factory('compacted-change-log')
+    repo.import_(PROJECT_ROOT / 'data/simple.crs')
+    srv = http_server_factory(repo.path)
+    bpt.crs_cache_dir = tmp_path
+    bpt.pkg_prefetch(repos=[srv.base_url], pkgs=['test-pkg@1.2.43'])
+    repo.import_(PROJECT_ROOT / 'data/simple2.crs')
+    bpt.run(['repo', 'compact-log', repo.path, '--keep=0'])
+    # The change we need is no longer in the log, so the sync must fall back to the database download
+    repo.path.joinpath('repo.db.gz').write_text('lolhi')
+    with expect_error_marker('repo-sync-invalid-db-gz'):
+        bpt.pkg_prefetch(repos=[srv.base_url], pkgs=['test-pkg@1.3.0'])
+
+
+def test_pkg_prefetch_many_repos(bpt: BPTWrapper, crs_repo_factory: CRSRepoFactory,
+                                 http_server_factory: HTTPServerFactory, tmp_path: Path) -> None:
+    repo_a = crs_repo_factory('repo-a')
+    repo_a.import_(PROJECT_ROOT / 'data/simple.crs')
+    repo_b = crs_repo_factory('repo-b')
+    repo_b.import_(PROJECT_ROOT / 'data/simple2.crs')
+    srv_a = http_server_factory(repo_a.path)
+    srv_b = http_server_factory(repo_b.path)
+    bpt.crs_cache_dir = tmp_path
+    # Both repositories are synced at the same time, and the packages of each are available
+    bpt.pkg_prefetch(repos=[srv_a.base_url, srv_b.base_url], pkgs=['test-pkg@1.2.43', 'test-pkg@1.3.0'])
+    assert tmp_path.joinpath('pkgs/test-pkg@1.2.43~1/pkg.json').is_file()
+    assert list(tmp_path.glob('pkgs/test-pkg@1.3.0~*/pkg.json'))
+
+
+def test_pkg_prefetch_many_repos_one_missing(bpt: BPTWrapper, simple_repo: CRSRepo, tmp_path: Path,
+                                             http_server_factory: HTTPServerFactory) -> None:
+    empty_dir = tmp_path / 'empty'
+    empty_dir.mkdir()
+    good = http_server_factory(simple_repo.path)
+    missing = http_server_factory(empty_dir)
+    bpt.crs_cache_dir = tmp_path
+    # The failure of one concurrent sync is reported just as it would be on its own
+    with expect_error_marker('repo-sync-http-404'):
+        bpt.pkg_prefetch(repos=[good.base_url, missing.base_url], pkgs=['test-pkg@1.2.43'])
+
+
+def test_build_without_deps_does_not_sync(tmp_project: Project, http_server_factory: HTTPServerFactory,
+                                          tmp_path: Path) -> None:
+    empty_dir = tmp_path / 'empty'
+    empty_dir.mkdir()
+    srv = http_server_factory(empty_dir)
+    tmp_project.bpt.crs_cache_dir = tmp_path / '_crs'
+    tmp_project.write('src/f.cpp', r'void f() {}')
+    # The repository is not valid, but it is never needed
+    tmp_project.build(repos=[srv.base_url])
+
+
+def test_pkg_check_cache(bpt: BPTWrapper, tmp_crs_repo: CRSRepo, tmp_path: Path) -> None:
+    tmp_crs_repo.import_(PROJECT_ROOT / 'data/simple.crs')
+    bpt.crs_cache_dir = tmp_path
+    bpt.pkg_prefetch(repos=[tmp_crs_repo.path], pkgs=['test-pkg@1.2.43'])
+    # The second sync only needs to validate the new package
+    tmp_crs_repo.import_(PROJECT_ROOT / 'data/simple2.crs')
+    res = subprocess.run([
+        bpt.path, '--log-level=debug', *bpt.crs_cache_dir_arg, 'pkg', 'prefetch', '--no-default-repo',
+        f'--use-repo={tmp_crs_repo.path}', 'test-pkg@1.3.0'
+    ],
+                         check=True,
+                         stdout=subprocess.PIPE,
+                         text=True)
+    assert 'Validated 1 new or changed packages' in res.stdout
+    bpt.run(['pkg', 'check-cache'])
+
+
+def test_pkg_prefetch_sparse_http(bpt: BPTWrapper, crs_repo_factory: CRSRepoFactory,
+                                  http_server_factory: HTTPServerFactory, tmp_path: Path) -> None:
+    repo = crs_repo_factory('sparse-index')
+    repo.import_([PROJECT_ROOT / 'data/simple.crs', PROJECT_ROOT / 'data/simple2.crs'])
+    # Only the sparse index is used, so the database is never downloaded
+    repo.path.joinpath('repo.db.gz').write_text('lolhi')
+    srv = http_server_factory(repo.path)
+    bpt.crs_cache_dir = tmp_path
+    bpt.pkg_prefetch(repos=[f'sparse+{srv.base_url}'], pkgs=['test-pkg@1.3.0'])
+    assert list(tmp_path.glob('pkgs/test-pkg@1.3.0~*/pkg.json'))
+    # Again, with the index entry already cached
+    bpt.pkg_prefetch(repos=[f'sparse+{srv.base_url}'], pkgs=['test-pkg@1.2.43'])
+    assert tmp_path.joinpath('pkgs/test-pkg@1.2.43~1/pkg.json').is_file()
+
+
+def test_pkg_solve_sparse_file(bpt: BPTWrapper, simple_repo: CRSRepo, tmp_path: Path) -> None:
+    bpt.crs_cache_dir = tmp_path
+    bpt.pkg_solve(repos=[f'sparse+{simple_repo.path.as_uri()}'], pkgs=['test-pkg@1.2.43'])
+
+
 def test_repo_validate_empty(tmp_crs_repo: CRSRepo) -> None:
     tmp_crs_repo.validate()
 
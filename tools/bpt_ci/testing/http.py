@@ -1,10 +1,12 @@
+import base64
+import hashlib
 import socket
 from concurrent.futures import ThreadPoolExecutor
 from contextlib import ExitStack, closing, contextmanager
 from functools import partial
 from http.server import HTTPServer, SimpleHTTPRequestHandler
 from pathlib import Path
-from typing import Any, Callable, Iterator, NamedTuple, cast
+from typing import Any, Callable, Dict, Iterator, List, NamedTuple, Optional, Tuple, Type, cast
 
 import pytest
 from pytest import FixtureRequest
@@ -33,6 +35,60 @@ class DirectoryServingHTTPRequestHandler(SimpleHTTPRequestHandler):
         return str(self.dir / relpath)
 
 
+class ResumableServingOptions:
+    """
+    Controls the behavior of a server spawned by ``resumable_http_server_factory``, and records the
+    requests that it receives.
+    """
+
+    def __init__(self) -> None:
+        self.cut_after: Dict[str, int] = {}
+        'Drop the connection after sending this many bytes of each of these files (relative paths)'
+        self.ranges: List[Optional[str]] = []
+        'The value of the "Range" header of each request for a file, in the order received'
+
+
+class ResumableHTTPRequestHandler(DirectoryServingHTTPRequestHandler):
+    """
+    Serves files with an ``ETag`` and a ``Repr-Digest``, and honors ``Range: bytes=<start>-``
+    requests that come with a matching ``If-Range``.
+    """
+
+    def __init__(self, *args: Any, **kwargs: Any) -> None:
+        self.opts: ResumableServingOptions = kwargs.pop('opts')
+        super().__init__(*args, **kwargs)
+
+    def do_GET(self) -> None:
+        fpath = Path(self.translate_path(self.path))
+        if not fpath.is_file():
+            super().do_GET()
+            return
+        content = fpath.read_bytes()
+        sha = hashlib.sha256(content)
+        etag = f'"{sha.hexdigest()[:16]}"'
+        rng = self.headers.get('Range')
+        self.opts.ranges.append(rng)
+        start = 0
+        if rng and rng.startswith('bytes=') and rng.endswith('-') and self.headers.get('If-Range') == etag:
+            start = int(rng[len('bytes='):-1])
+            if start >= len(content):
+                self.send_error(416)
+                return
+        self.send_response(206 if start else 200)
+        if start:
+            self.send_header('Content-Range', f'bytes {start}-{len(content) - 1}/{len(content)}')
+        self.send_header('Content-Length', str(len(content) - start))
+        self.send_header('ETag', etag)
+        self.send_header('Repr-Digest', f'sha-256=:{base64.b64encode(sha.digest()).decode()}:')
+        self.end_headers()
+        body = content[start:]
+        cut_after = self.opts.cut_after.get(fpath.relative_to(self.dir).as_posix())
+        if cut_after is not None:
+            body = body[:max(cut_after - start, 0)]
+            self.close_connection = True
+        self.wfile.write(body)
+
+
 class ServerInfo(NamedTuple):
     """
     Information about an HTTP server fixture
@@ -42,12 +98,15 @@ class ServerInfo(NamedTuple):
 
 
 @contextmanager
-def run_http_server(dirpath: Path, port: int) -> Iterator[ServerInfo]:
+def run_http_server(dirpath: Path,
+                    port: int,
+                    handler_class: Type[DirectoryServingHTTPRequestHandler] = DirectoryServingHTTPRequestHandler,
+                    **handler_args: Any) -> Iterator[ServerInfo]:
     """
     Context manager that spawns an HTTP server that serves thegiven directory on
     the given TCP port.
     """
-    handler = partial(DirectoryServingHTTPRequestHandler, dir=dirpath)
+    handler = partial(handler_class, dir=dirpath, **handler_args)
     addr = ('127.0.0.1', port)
     pool = ThreadPoolExecutor()
     with HTTPServer(addr, handler) as httpd:
@@ -75,3 +134,24 @@ def http_server_factory(request: FixtureRequest) -> HTTPServerFactory:
         return server
 
     return _make
+
+
+ResumableHTTPServerFactory = Callable[[Path], Tuple[ServerInfo, ResumableServingOptions]]
+
+
+@pytest.fixture(scope='session')
+def resumable_http_server_factory(request: FixtureRequest) -> ResumableHTTPServerFactory:
+    """
+    Spawn an HTTP server that serves the content of a directory, and supports resuming downloads.
+    The returned options can be used to interrupt downloads.
+    """
+
+    def _make(p: Path) -> Tuple[ServerInfo, ResumableServingOptions]:
+        opts = ResumableServingOptions()
+        st = ExitStack()
+        server = st.enter_context(
+            run_http_server(p, _unused_tcp_port(), handler_class=ResumableHTTPRequestHandler, opts=opts))
+        request.addfinalizer(st.pop_all)
+        return server, opts
+
+    return _make
@@ -0,0 +1,230 @@
+"""
+Generation of synthetic projects and a do-nothing toolchain, used to measure the
+overhead of bpt itself without the cost of real compilation.
+"""
+
+from __future__ import annotations
+
+import json
+import os
+import stat
+import statistics
+import time
+from pathlib import Path
+from typing import Callable, Iterable, NamedTuple, Sequence
+
+from ..util import JSONishDict, Pathish
+
+STUB_COMPILER_SH = r'''#!/bin/sh
+# Stands in for the compiler, archiver, and linker. Writes the expected outputs without doing any
+# real work. Makefile-style deps are taken from the "<input>.deps" file next to each input.
+out=''
+depfile=''
+target=''
+src=''
+exe=false
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --exe) exe=true ;;
+        -MF) depfile="$2"; shift ;;
+        -MQ) target="$2"; shift ;;
+        -c) src="$2"; shift ;;
+        -o*) out="${1#-o}" ;;
+    esac
+    shift
+done
+if [ -n "$out" ]; then
+    if $exe; then
+        printf '#!/bin/sh\nexit 0\n' > "$out" && chmod +x "$out"
+    else
+        # Unique content, so that the output is never mistaken for an unchanged one
+        echo "$$" > "$out"
+    fi
+fi
+if [ -n "$depfile" ]; then
+    {
+        printf '%s: %s' "$target" "$src"
+        if [ -f "$src.deps" ]; then cat "$src.deps"; fi
+        printf '\n'
+    } > "$depfile"
+fi
+'''
+
+
+def write_stub_toolchain(dirpath: Pathish) -> Path:
+    """
+    Write a stub compiler script and a toolchain file that uses it into ``dirpath``.
+    Returns the path to the toolchain file.
+
+    .. note:: The stub is a POSIX shell script, and is not available on Windows.
+    """
+    dirpath = Path(dirpath)
+    dirpath.mkdir(exist_ok=True, parents=True)
+    stub = dirpath / 'stub-cc.sh'
+    stub.write_text(STUB_COMPILER_SH, encoding='utf-8')
+    stub.chmod(stub.stat().st_mode | stat.S_IXUSR | stat.S_IXGRP | stat.S_IXOTH)
+    tc = dirpath / 'stub.tc.jsonc'
+    data = {
+        'compiler_id': 'gnu',
+        'cxx_version': 'c++20',
+        'advanced': {
+            'c_compile_file': [str(stub), '[flags]', '-c', '[in]', '-o[out]'],
+            'cxx_compile_file': [str(stub), '[flags]', '-c', '[in]', '-o[out]'],
+            'create_archive': [str(stub), '-o[out]', '[in]'],
+            'link_executable': [str(stub), '--exe', '-o[out]', '[in]'],
+        },
+    }
+    tc.write_text(json.dumps(data, indent=2), encoding='utf-8')
+    return tc
+
+
+class SyntheticProjectSpec(NamedTuple):
+    """
+    The shape of a generated project
+    """
+    n_libs: int = 8
+    'The number of libraries in the project'
+    n_sources: int = 20
+    'The number of source files (and headers) in each library'
+    header_fanout: int = 5
+    'The number of headers from its own library that each source file includes'
+    dep_depth: int = 4
+    """
+    The length of the chains of libraries that use each other. Each library uses
+    the one before it, except for the first in every chain.
+    """
+
+    def to_json(self) -> JSONishDict:
+        return dict(self._asdict())
+
+
+class SyntheticProject(NamedTuple):
+    """
+    A project generated by :func:`generate_project`
+    """
+    root: Path
+    spec: SyntheticProjectSpec
+    lib_names: Sequence[str]
+
+    def header(self, lib: int, idx: int) -> Path:
+        """The path to a header within a library"""
+        name = self.lib_names[lib]
+        return self.root / f'libs/{name}/src/{name}/hdr_{idx}.hpp'
+
+    def source(self, lib: int, idx: int) -> Path:
+        """The path to a source file within a library"""
+        name = self.lib_names[lib]
+        return self.root / f'libs/{name}/src/{name}/src_{idx}.cpp'
+
+    @property
+    def most_used_header(self) -> Path:
+        """A header at the bottom of a library chain, which has the most dependents"""
+        return self.header(0, 0)
+
+    @property
+    def any_source(self) -> Path:
+        """A source file that no other file depends on"""
+        return self.source(self.spec.n_libs - 1, 0)
+
+
+def generate_project(root: Pathish, spec: SyntheticProjectSpec) -> SyntheticProject:
+    """
+    Generate a project according to ``spec`` into the ``root`` directory.
+
+    Header ``i`` of each library includes header ``i`` of the library that it uses,
+    so touching a header at the bottom of a chain invalidates every library above it.
+    The files that each file (transitively) includes are also written beside it with a
+    ``.deps`` suffix, which is how the stub compiler reports them back to bpt.
+    """
+    root = Path(root)
+    depth = max(spec.dep_depth, 1)
+    n_srcs = max(spec.n_sources, 1)
+    names = [f'lib{i}' for i in range(spec.n_libs)]
+
+    def uses(lib: int) -> int | None:
+        return lib - 1 if lib % depth else None
+
+    # The headers included (directly or indirectly) by each header, memoized
+    header_closure: dict[tuple[int, int], list[Path]] = {}
+    proj = SyntheticProject(root, spec, names)
+
+    def closure_of(lib: int, idx: int) -> list[Path]:
+        key = (lib, idx)
+        if key not in header_closure:
+            used = uses(lib)
+            header_closure[key] = [] if used is None else [proj.header(used, idx), *closure_of(used, idx)]
+        return header_closure[key]
+
+    def write(path: Path, content: str, deps: Iterable[Path]) -> None:
+        path.parent.mkdir(exist_ok=True, parents=True)
+        path.write_text(content, encoding='utf-8')
+        path.with_name(path.name + '.deps').write_text(''.join(f' {d}' for d in deps), encoding='utf-8')
+
+    libs = []
+    for lib, name in enumerate(names):
+        used = uses(lib)
+        for idx in range(n_srcs):
+            hdr_lines = ['#pragma once']
+            if used is not None:
+                hdr_lines.append(f'#include <{names[used]}/hdr_{idx}.hpp>')
+            hdr_lines.append(f'int {name}_fn_{idx}();')
+            write(proj.header(lib, idx), '\n'.join(hdr_lines) + '\n', closure_of(lib, idx))
+
+            included = sorted({(idx + n) % n_srcs for n in range(min(spec.header_fanout, n_srcs))})
+            src_lines = [f'#include <{name}/hdr_{i}.hpp>' for i in included]
+            src_lines.append(f'int {name}_fn_{idx}() {{ return {idx}; }}')
+            src_deps: list[Path] = []
+            for i in included:
+                src_deps.append(proj.header(lib, i))
+                src_deps.extend(closure_of(lib, i))
+            write(proj.source(lib, idx), '\n'.join(src_lines) + '\n', dict.fromkeys(src_deps))
+        libs.append({
+            'name': name,
+            'path': f'libs/{name}',
+            'using': [] if used is None else [names[used]],
+        })
+
+    pkg = {'name': 'synthetic', 'version': '0.0.0', 'libs': libs}
+    root.joinpath('pkg.yaml').write_text(json.dumps(pkg, indent=2), encoding='utf-8')
+    return proj
+
+
+def touch(path: Path) -> None:
+    """
+    Modify the given file so that bpt must consider it changed, even on filesystems
+    with a coarse modification time.
+    """
+    with path.open('a', encoding='utf-8') as f:
+        f.write('\n')
+    st = path.stat()
+    bumped = max(st.st_mtime_ns, time.time_ns()) + 1_000_000_000
+    os.utime(path, ns=(bumped, bumped))
+
+
+class ScenarioResult(NamedTuple):
+    """
+    The timings of several runs of a single benchmark scenario
+    """
+    name: str
+    durations: Sequence[float]
+
+    def to_json(self) -> JSONishDict:
+        return {
+            'runs_s': list(self.durations),
+            'min_s': min(self.durations),
+            'median_s': statistics.median(self.durations),
+            'max_s': max(self.durations),
+        }
+
+
+def time_scenario(name: str, *, prepare: Callable[[], None], run: Callable[[], None], repeat: int) -> ScenarioResult:
+    """
+    Time ``run`` ``repeat`` times. ``prepare`` is called before each run, and is not timed.
+    """
+    durations: list[float] = []
+    for _ in range(max(repeat, 1)):
+        prepare()
+        start = time.perf_counter()
+        run()
+        durations.append(time.perf_counter() - start)
+    return ScenarioResult(name, durations)